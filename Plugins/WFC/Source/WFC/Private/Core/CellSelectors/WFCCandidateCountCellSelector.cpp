@@ -0,0 +1,104 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+
+#include "Core/CellSelectors/WFCCandidateCountCellSelector.h"
+
+#include "Core/WFCGenerator.h"
+
+
+void UWFCCandidateCountCellSelector::Initialize(UWFCGenerator* InGenerator)
+{
+	Super::Initialize(InGenerator);
+
+	Reset();
+}
+
+void UWFCCandidateCountCellSelector::Reset()
+{
+	Super::Reset();
+	check(Generator != nullptr);
+
+	const int32 NumCells = Generator->GetNumCells();
+
+	// keep bucket allocations around, they will likely be needed again
+	Buckets.SetNum(Generator->GetNumTiles() + 1);
+	for (TArray<FWFCCellIndex>& Bucket : Buckets)
+	{
+		Bucket.Reset();
+	}
+
+	CellBuckets.Init(INDEX_NONE, NumCells);
+	CellBucketPositions.Init(INDEX_NONE, NumCells);
+	MinBucket = Buckets.Num();
+
+	for (const FWFCCellIndex CellIndex : Generator->GetOpenCells())
+	{
+		AddToBucket(CellIndex, Generator->GetCell(CellIndex).TileCandidates.Num());
+	}
+}
+
+void UWFCCandidateCountCellSelector::NotifyCellChanged(FWFCCellIndex CellIndex, bool bHasSelection)
+{
+	const FWFCCell& Cell = Generator->GetCell(CellIndex);
+	if (Cell.HasSelectionOrNoCandidates())
+	{
+		// nothing to collapse
+		RemoveFromBucket(CellIndex);
+		return;
+	}
+
+	const int32 CandidateCount = Cell.TileCandidates.Num();
+	if (CellBuckets[CellIndex] != CandidateCount)
+	{
+		RemoveFromBucket(CellIndex);
+		AddToBucket(CellIndex, CandidateCount);
+	}
+}
+
+FWFCCellIndex UWFCCandidateCountCellSelector::SelectNextCell()
+{
+	check(Generator != nullptr);
+
+	// buckets below MinBucket are always empty, so search up from there
+	while (Buckets.IsValidIndex(MinBucket) && Buckets[MinBucket].IsEmpty())
+	{
+		++MinBucket;
+	}
+
+	if (!Buckets.IsValidIndex(MinBucket))
+	{
+		return INDEX_NONE;
+	}
+
+	const TArray<FWFCCellIndex>& Bucket = Buckets[MinBucket];
+	return Bucket[Generator->GetRandomStream().RandHelper(Bucket.Num())];
+}
+
+void UWFCCandidateCountCellSelector::AddToBucket(FWFCCellIndex CellIndex, int32 CandidateCount)
+{
+	CellBuckets[CellIndex] = CandidateCount;
+	CellBucketPositions[CellIndex] = Buckets[CandidateCount].Add(CellIndex);
+	MinBucket = FMath::Min(MinBucket, CandidateCount);
+}
+
+void UWFCCandidateCountCellSelector::RemoveFromBucket(FWFCCellIndex CellIndex)
+{
+	const int32 CandidateCount = CellBuckets[CellIndex];
+	if (CandidateCount == INDEX_NONE)
+	{
+		return;
+	}
+
+	// swap the last cell of the bucket into the removed position
+	TArray<FWFCCellIndex>& Bucket = Buckets[CandidateCount];
+	const int32 Position = CellBucketPositions[CellIndex];
+	const FWFCCellIndex LastCellIndex = Bucket.Pop(EAllowShrinking::No);
+	if (Position < Bucket.Num())
+	{
+		Bucket[Position] = LastCellIndex;
+		CellBucketPositions[LastCellIndex] = Position;
+	}
+
+	CellBuckets[CellIndex] = INDEX_NONE;
+	CellBucketPositions[CellIndex] = INDEX_NONE;
+}
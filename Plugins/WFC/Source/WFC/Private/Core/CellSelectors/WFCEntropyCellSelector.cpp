@@ -14,7 +14,7 @@ UWFCEntropyCellSelector::UWFCEntropyCellSelector()
 
 float UWFCEntropyCellSelector::GetCellEntropy(int32 CellIndex) const
 {
-	if (!Generator)
+	if (!Generator || !CellKeys.IsValidIndex(CellIndex))
 	{
 		return 0;
 	}
@@ -23,56 +23,261 @@ float UWFCEntropyCellSelector::GetCellEntropy(int32 CellIndex) const
 	{
 		return 0.f;
 	}
-	return CalculateShannonEntropy(Cell);
+	return static_cast<float>(CellKeys[CellIndex] - CellNoise[CellIndex]);
 }
 
-FWFCCellIndex UWFCEntropyCellSelector::SelectNextCell()
+void UWFCEntropyCellSelector::Initialize(UWFCGenerator* InGenerator)
 {
+	Super::Initialize(InGenerator);
 	check(Generator != nullptr);
 
-	float MinEntropy = MAX_FLT;
-	FWFCCellIndex BestCellIndex = INDEX_NONE;
+	// cache weight terms for each tile, tiles with no weight don't contribute to entropy
+	const UWFCModel* Model = Generator->GetModel();
+	const int32 NumTiles = Generator->GetNumTiles();
+	TileWeights.SetNumUninitialized(NumTiles);
+	TileWeightLogWeights.SetNumUninitialized(NumTiles);
+	for (FWFCTileId TileId = 0; TileId < NumTiles; ++TileId)
+	{
+		const double Weight = Model->GetTileWeightUnchecked(TileId);
+		TileWeights[TileId] = Weight;
+		TileWeightLogWeights[TileId] = Weight > 0.0 ? Weight * FMath::Loge(Weight) : 0.0;
+	}
+
+	Reset();
+}
 
-	// select the cell with the lowest entropy, adding in a bit of randomness
-	for (FWFCCellIndex CellIndex = 0; CellIndex < Generator->GetNumCells(); ++CellIndex)
+void UWFCEntropyCellSelector::Reset()
+{
+	Super::Reset();
+	check(Generator != nullptr);
+
+	const int32 NumCells = Generator->GetNumCells();
+	CellSumOfWeights.SetNumUninitialized(NumCells);
+	CellSumOfWeightLogWeights.SetNumUninitialized(NumCells);
+	CellNumWeightedCandidates.SetNumUninitialized(NumCells);
+	CellNoise.SetNumUninitialized(NumCells);
+	CellKeys.SetNumUninitialized(NumCells);
+	HeapIndices.Init(INDEX_NONE, NumCells);
+	Heap.Reset(NumCells);
+
+	FRandomStream& RandomStream = Generator->GetRandomStream();
+
+	for (FWFCCellIndex CellIndex = 0; CellIndex < NumCells; ++CellIndex)
 	{
 		const FWFCCell& Cell = Generator->GetCell(CellIndex);
 
-		if (Cell.HasSelectionOrNoCandidates())
+		double SumOfWeights = 0.0;
+		double SumOfWeightLogWeights = 0.0;
+		int32 NumWeightedCandidates = 0;
+		for (const FWFCTileId TileId : Cell.TileCandidates)
+		{
+			if (TileWeights[TileId] > 0.0)
+			{
+				SumOfWeights += TileWeights[TileId];
+				SumOfWeightLogWeights += TileWeightLogWeights[TileId];
+				++NumWeightedCandidates;
+			}
+		}
+
+		CellSumOfWeights[CellIndex] = SumOfWeights;
+		CellSumOfWeightLogWeights[CellIndex] = SumOfWeightLogWeights;
+		CellNumWeightedCandidates[CellIndex] = NumWeightedCandidates;
+		CellNoise[CellIndex] = RandomStream.FRand() * RandomDeviation;
+		CellKeys[CellIndex] = 0.0;
+
+		if (!Cell.HasSelectionOrNoCandidates())
 		{
-			// nothing to collapse
-			continue;
+			CellKeys[CellIndex] = CalculateShannonEntropy(CellIndex) + CellNoise[CellIndex];
+			HeapSet(Heap.Add(CellIndex), CellIndex);
 		}
+	}
+
+	// build the heap bottom-up
+	for (int32 HeapIndex = Heap.Num() / 2 - 1; HeapIndex >= 0; --HeapIndex)
+	{
+		HeapSiftDown(HeapIndex);
+	}
+}
+
+void UWFCEntropyCellSelector::NotifyCellBan(FWFCCellIndex CellIndex, FWFCTileId BannedTileId)
+{
+	NotifyCellBans(CellIndex, MakeArrayView(&BannedTileId, 1));
+}
 
-		const float Entropy = CalculateShannonEntropy(Cell) + FMath::FRand() * RandomDeviation;
-		if (Entropy < MinEntropy)
+void UWFCEntropyCellSelector::NotifyCellBans(FWFCCellIndex CellIndex, TArrayView<const FWFCTileId> BannedTileIds)
+{
+	// sum the weights of the whole batch, so the cell's sums are only updated once
+	int32 NumWeightedBans = 0;
+	double SumOfWeights = 0.0;
+	double SumOfWeightLogWeights = 0.0;
+	for (const FWFCTileId BannedTileId : BannedTileIds)
+	{
+		const double Weight = TileWeights[BannedTileId];
+		if (Weight > 0.0)
 		{
-			MinEntropy = Entropy;
-			BestCellIndex = CellIndex;
+			++NumWeightedBans;
+			SumOfWeights += Weight;
+			SumOfWeightLogWeights += TileWeightLogWeights[BannedTileId];
 		}
 	}
 
-	return BestCellIndex;
+	if (NumWeightedBans == 0)
+	{
+		return;
+	}
+
+	CellNumWeightedCandidates[CellIndex] -= NumWeightedBans;
+	if (CellNumWeightedCandidates[CellIndex] == 0)
+	{
+		// avoid leaving behind rounding errors when the last weighted candidate is removed
+		CellSumOfWeights[CellIndex] = 0.0;
+		CellSumOfWeightLogWeights[CellIndex] = 0.0;
+	}
+	else
+	{
+		CellSumOfWeights[CellIndex] -= SumOfWeights;
+		CellSumOfWeightLogWeights[CellIndex] -= SumOfWeightLogWeights;
+	}
+}
+
+void UWFCEntropyCellSelector::NotifyCellCandidateRestored(FWFCCellIndex CellIndex, FWFCTileId TileId)
+{
+	const double Weight = TileWeights[TileId];
+	if (Weight <= 0.0)
+	{
+		return;
+	}
+
+	if (CellNumWeightedCandidates[CellIndex]++ == 0)
+	{
+		CellSumOfWeights[CellIndex] = Weight;
+		CellSumOfWeightLogWeights[CellIndex] = TileWeightLogWeights[TileId];
+	}
+	else
+	{
+		CellSumOfWeights[CellIndex] += Weight;
+		CellSumOfWeightLogWeights[CellIndex] += TileWeightLogWeights[TileId];
+	}
+}
+
+void UWFCEntropyCellSelector::NotifyCellChanged(FWFCCellIndex CellIndex, bool bHasSelection)
+{
+	UpdateCell(CellIndex);
 }
 
-float UWFCEntropyCellSelector::CalculateShannonEntropy(const FWFCCell& Cell) const
+FWFCCellIndex UWFCEntropyCellSelector::SelectNextCell()
 {
 	check(Generator != nullptr);
 
-	float SumOfWeights = 0.f;
-	float SumOfLogWeights = 0.f;
+	// the cell with the lowest entropy, plus its bit of randomness, is always at the top
+	return Heap.IsEmpty() ? INDEX_NONE : Heap[0];
+}
+
+double UWFCEntropyCellSelector::CalculateShannonEntropy(FWFCCellIndex CellIndex) const
+{
+	const double SumOfWeights = CellSumOfWeights[CellIndex];
+	if (CellNumWeightedCandidates[CellIndex] == 0 || SumOfWeights <= 0.0)
+	{
+		// no weights, all candidates are treated equally
+		const int32 NumCandidates = Generator->GetCell(CellIndex).TileCandidates.Num();
+		return FMath::Loge(static_cast<double>(FMath::Max(NumCandidates, 1)));
+	}
+
+	return FMath::Loge(SumOfWeights) - (CellSumOfWeightLogWeights[CellIndex] / SumOfWeights);
+}
+
+void UWFCEntropyCellSelector::UpdateCell(FWFCCellIndex CellIndex)
+{
+	if (Generator->GetCell(CellIndex).HasSelectionOrNoCandidates())
+	{
+		// nothing to collapse
+		HeapRemove(CellIndex);
+		return;
+	}
+
+	const double PrevKey = CellKeys[CellIndex];
+	CellKeys[CellIndex] = CalculateShannonEntropy(CellIndex) + CellNoise[CellIndex];
+
+	const int32 HeapIndex = HeapIndices[CellIndex];
+	if (HeapIndex == INDEX_NONE)
+	{
+		HeapSet(Heap.Add(CellIndex), CellIndex);
+		HeapSiftUp(Heap.Num() - 1);
+	}
+	else if (CellKeys[CellIndex] < PrevKey)
+	{
+		HeapSiftUp(HeapIndex);
+	}
+	else
+	{
+		HeapSiftDown(HeapIndex);
+	}
+}
+
+void UWFCEntropyCellSelector::HeapRemove(FWFCCellIndex CellIndex)
+{
+	const int32 HeapIndex = HeapIndices[CellIndex];
+	if (HeapIndex == INDEX_NONE)
+	{
+		return;
+	}
 
-	for (const FWFCTileId& TileId : Cell.TileCandidates)
+	HeapIndices[CellIndex] = INDEX_NONE;
+
+	// move the last cell into the removed slot and restore heap order around it
+	const FWFCCellIndex LastCellIndex = Heap.Pop(EAllowShrinking::No);
+	if (HeapIndex < Heap.Num())
 	{
-		const float Weight = Generator->GetModel()->GetTileWeightUnchecked(TileId);
-		if (Weight <= 0.f)
+		HeapSet(HeapIndex, LastCellIndex);
+		HeapSiftUp(HeapIndex);
+		HeapSiftDown(HeapIndices[LastCellIndex]);
+	}
+}
+
+void UWFCEntropyCellSelector::HeapSiftUp(int32 HeapIndex)
+{
+	const FWFCCellIndex CellIndex = Heap[HeapIndex];
+	const double Key = CellKeys[CellIndex];
+	while (HeapIndex > 0)
+	{
+		const int32 ParentHeapIndex = (HeapIndex - 1) / 2;
+		const FWFCCellIndex ParentCellIndex = Heap[ParentHeapIndex];
+		if (CellKeys[ParentCellIndex] <= Key)
 		{
-			continue;
+			break;
 		}
-
-		SumOfWeights += Weight;
-		SumOfLogWeights += Weight * FMath::Loge(Weight);
+		HeapSet(HeapIndex, ParentCellIndex);
+		HeapIndex = ParentHeapIndex;
 	}
+	HeapSet(HeapIndex, CellIndex);
+}
 
-	return FMath::Loge(SumOfWeights) - (SumOfLogWeights / SumOfWeights);
+void UWFCEntropyCellSelector::HeapSiftDown(int32 HeapIndex)
+{
+	const FWFCCellIndex CellIndex = Heap[HeapIndex];
+	const double Key = CellKeys[CellIndex];
+	const int32 HeapNum = Heap.Num();
+	while (true)
+	{
+		int32 ChildHeapIndex = HeapIndex * 2 + 1;
+		if (ChildHeapIndex >= HeapNum)
+		{
+			break;
+		}
+
+		// pick the smaller of the two children
+		if (ChildHeapIndex + 1 < HeapNum && CellKeys[Heap[ChildHeapIndex + 1]] < CellKeys[Heap[ChildHeapIndex]])
+		{
+			++ChildHeapIndex;
+		}
+
+		const FWFCCellIndex ChildCellIndex = Heap[ChildHeapIndex];
+		if (Key <= CellKeys[ChildCellIndex])
+		{
+			break;
+		}
+		HeapSet(HeapIndex, ChildCellIndex);
+		HeapIndex = ChildHeapIndex;
+	}
+	HeapSet(HeapIndex, CellIndex);
 }
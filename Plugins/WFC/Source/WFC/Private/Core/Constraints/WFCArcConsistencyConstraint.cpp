@@ -3,7 +3,12 @@
 
 #include "Core/Constraints/WFCArcConsistencyConstraint.h"
 
+#include "WFCCustomVersion.h"
 #include "WFCModule.h"
+#include "Algo/BinarySearch.h"
+#include "Algo/Count.h"
+#include "Algo/IsSorted.h"
+#include "Core/WFCCompiledModel.h"
 #include "Core/WFCGenerator.h"
 #include "Core/WFCGrid.h"
 #include "Core/WFCModel.h"
@@ -16,19 +21,314 @@ DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Arc Consistency - Checks"), STAT_WFCArcCons
 DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Arc Consistency - Bans"), STAT_WFCArcConstraintNumBans, STATGROUP_WFC);
 
 
+FWFCArcAdjacency::FWFCArcAdjacency()
+	: NumTiles(0),
+	  NumDirections(0)
+{
+}
+
+FWFCArcAdjacency::FWFCArcAdjacency(const TArray<TArray<TArray<FWFCTileId>>>& AllowedTiles, int32 InNumDirections)
+	: NumTiles(AllowedTiles.Num()),
+	  NumDirections(InNumDirections)
+{
+	int32 NumEntries = 0;
+	for (const TArray<TArray<FWFCTileId>>& TileAllowedTiles : AllowedTiles)
+	{
+		for (const TArray<FWFCTileId>& DirectionAllowedTiles : TileAllowedTiles)
+		{
+			NumEntries += DirectionAllowedTiles.Num();
+		}
+	}
+
+	Offsets.Reserve(NumTiles * NumDirections + 1);
+	TileIds.Reserve(NumEntries);
+	for (const TArray<TArray<FWFCTileId>>& TileAllowedTiles : AllowedTiles)
+	{
+		check(TileAllowedTiles.Num() == NumDirections);
+		for (const TArray<FWFCTileId>& DirectionAllowedTiles : TileAllowedTiles)
+		{
+			Offsets.Add(TileIds.Num());
+			TileIds.Append(DirectionAllowedTiles);
+		}
+	}
+	Offsets.Add(TileIds.Num());
+}
+
+int32 FWFCArcAdjacency::GetMaxNumAllowedTiles() const
+{
+	int32 MaxNum = 0;
+	for (int32 Index = 0; Index < Offsets.Num() - 1; ++Index)
+	{
+		MaxNum = FMath::Max(MaxNum, Offsets[Index + 1] - Offsets[Index]);
+	}
+	return MaxNum;
+}
+
+void FWFCArcAdjacency::Serialize(FArchive& Ar)
+{
+	Ar << NumTiles;
+	Ar << NumDirections;
+	Offsets.BulkSerialize(Ar);
+	TileIds.BulkSerialize(Ar);
+}
+
+
+/** How a row of support counts for one cell and direction is stored in an arc constraint snapshot. */
+enum class EWFCSupportCountRowEncoding : uint8
+{
+	/** The counts are the same as the default counts for the direction. */
+	Default,
+	/** Every count is zero, which is the case for directions without a neighbor. */
+	Zero,
+	/** The counts are stored as the difference from the default counts. */
+	Delta,
+	/** The counts were never written, and still have their initial values. */
+	Unwritten,
+};
+
+
+/** The target size in bytes of each page of written support count rows. */
+static constexpr int32 WFCSupportCountPageSize = 64 * 1024;
+
+
+UWFCArcConstraintSnapshot::UWFCArcConstraintSnapshot()
+	: NumDirections(0),
+	  SupportCountSize(0)
+{
+}
+
+TSharedPtr<const FWFCArcAdjacency> UWFCArcConstraintSnapshot::GetAdjacency() const
+{
+	if (Adjacency.IsValid())
+	{
+		return Adjacency;
+	}
+	// the compiled model may have loaded after this snapshot, so its adjacency is retrieved when needed
+	return CompiledModel ? CompiledModel->Adjacency : nullptr;
+}
+
 void UWFCArcConstraintSnapshot::Serialize(FArchive& Ar)
 {
 	Super::Serialize(Ar);
 
+	Ar.UsingCustomVersion(FWFCCustomVersion::GUID);
+
+	if (Ar.IsLoading() && Ar.CustomVer(FWFCCustomVersion::GUID) < FWFCCustomVersion::CompactSnapshots)
+	{
+		SerializeLegacy(Ar);
+		return;
+	}
+
+	// the adjacency doesn't need to be saved if it belongs to a compiled model
+	bool bHasAdjacency = !CompiledModel && (Adjacency.IsValid() || !AllowedTiles.IsEmpty());
+	Ar << bHasAdjacency;
+	if (bHasAdjacency)
+	{
+		if (Ar.IsLoading())
+		{
+			const TSharedRef<FWFCArcAdjacency> LoadedAdjacency = MakeShared<FWFCArcAdjacency>();
+			LoadedAdjacency->Serialize(Ar);
+			Adjacency = LoadedAdjacency;
+			AllowedTiles.Empty();
+		}
+		else if (Adjacency.IsValid())
+		{
+			// saving doesn't modify the adjacency
+			const_cast<FWFCArcAdjacency*>(Adjacency.Get())->Serialize(Ar);
+		}
+		else
+		{
+			FWFCArcAdjacency CompiledAdjacency(AllowedTiles, NumDirections);
+			CompiledAdjacency.Serialize(Ar);
+		}
+	}
+
+	Ar << NumDirections;
+	Ar << SupportCountSize;
+	DefaultSupportCounts.BulkSerialize(Ar);
+	switch (SupportCountSize)
+	{
+	case sizeof(uint8):
+		SerializeSupportCountDeltas<uint8>(Ar);
+		break;
+	case sizeof(uint16):
+		SerializeSupportCountDeltas<uint16>(Ar);
+		break;
+	case sizeof(uint32):
+		SerializeSupportCountDeltas<uint32>(Ar);
+		break;
+	default:
+		// no valid support counts
+		SupportCountRowIndices.Empty();
+		SupportCounts.Empty();
+		break;
+	}
+	Ar << BansToPropagate;
+}
+
+template <typename CounterType>
+void UWFCArcConstraintSnapshot::SerializeSupportCountDeltas(FArchive& Ar)
+{
+	// each row of NumTiles counts belongs to one [CellIndex][Direction], and starts with that direction's defaults
+	const int32 NumTiles = NumDirections > 0 ? DefaultSupportCounts.Num() / (NumDirections * sizeof(CounterType)) : 0;
+	const int64 RowSize = static_cast<int64>(NumTiles) * sizeof(CounterType);
+	int64 NumRows = SupportCountRowIndices.Num();
+	Ar << NumRows;
+
+	const CounterType* Defaults = reinterpret_cast<const CounterType*>(DefaultSupportCounts.GetData());
+	TArray64<uint8> RowEncodings;
+	TArray64<CounterType> Deltas;
+
+	if (!Ar.IsLoading())
+	{
+		// each support is only removed once, so counts never drop below zero
+		const CounterType* Counts = reinterpret_cast<const CounterType*>(SupportCounts.GetData());
+		RowEncodings.SetNumUninitialized(NumRows);
+		for (int64 Row = 0; Row < NumRows; ++Row)
+		{
+			const int32 WrittenRowIndex = SupportCountRowIndices[Row];
+			if (WrittenRowIndex == INDEX_NONE)
+			{
+				RowEncodings[Row] = static_cast<uint8>(EWFCSupportCountRowEncoding::Unwritten);
+				continue;
+			}
+
+			const CounterType* RowCounts = Counts + static_cast<int64>(WrittenRowIndex) * NumTiles;
+			const CounterType* RowDefaults = Defaults + (Row % NumDirections) * NumTiles;
+			if (FMemory::Memcmp(RowCounts, RowDefaults, RowSize) == 0)
+			{
+				RowEncodings[Row] = static_cast<uint8>(EWFCSupportCountRowEncoding::Default);
+				continue;
+			}
+
+			bool bIsZero = true;
+			for (int32 TileId = 0; TileId < NumTiles && bIsZero; ++TileId)
+			{
+				bIsZero = RowCounts[TileId] == 0;
+			}
+			if (bIsZero)
+			{
+				RowEncodings[Row] = static_cast<uint8>(EWFCSupportCountRowEncoding::Zero);
+				continue;
+			}
+
+			RowEncodings[Row] = static_cast<uint8>(EWFCSupportCountRowEncoding::Delta);
+			CounterType* RowDeltas = Deltas.GetData() + Deltas.AddUninitialized(NumTiles);
+			for (int32 TileId = 0; TileId < NumTiles; ++TileId)
+			{
+				RowDeltas[TileId] = static_cast<CounterType>(RowDefaults[TileId] - RowCounts[TileId]);
+			}
+		}
+	}
+
+	RowEncodings.BulkSerialize(Ar);
+	Deltas.BulkSerialize(Ar);
+
+	if (Ar.IsLoading())
+	{
+		const int64 NumDeltaRows = Algo::Count(RowEncodings, static_cast<uint8>(EWFCSupportCountRowEncoding::Delta));
+		const int64 NumUnwrittenRows = Algo::Count(RowEncodings, static_cast<uint8>(EWFCSupportCountRowEncoding::Unwritten));
+		if (RowEncodings.Num() != NumRows || NumRows > MAX_int32 || Deltas.Num() != NumDeltaRows * NumTiles)
+		{
+			Ar.SetError();
+			SupportCountSize = 0;
+			SupportCountRowIndices.Empty();
+			SupportCounts.Empty();
+			return;
+		}
+
+		SupportCountRowIndices.SetNumUninitialized(static_cast<int32>(NumRows));
+		SupportCounts.SetNumUninitialized((NumRows - NumUnwrittenRows) * RowSize);
+		CounterType* RowCounts = reinterpret_cast<CounterType*>(SupportCounts.GetData());
+		const CounterType* RowDeltas = Deltas.GetData();
+		int32 NumWrittenRows = 0;
+		for (int64 Row = 0; Row < NumRows; ++Row)
+		{
+			const EWFCSupportCountRowEncoding Encoding = static_cast<EWFCSupportCountRowEncoding>(RowEncodings[Row]);
+			if (Encoding == EWFCSupportCountRowEncoding::Unwritten)
+			{
+				SupportCountRowIndices[Row] = INDEX_NONE;
+				continue;
+			}
+
+			SupportCountRowIndices[Row] = NumWrittenRows++;
+			const CounterType* RowDefaults = Defaults + (Row % NumDirections) * NumTiles;
+			switch (Encoding)
+			{
+			case EWFCSupportCountRowEncoding::Default:
+				FMemory::Memcpy(RowCounts, RowDefaults, RowSize);
+				break;
+			case EWFCSupportCountRowEncoding::Zero:
+				FMemory::Memzero(RowCounts, RowSize);
+				break;
+			default:
+				for (int32 TileId = 0; TileId < NumTiles; ++TileId)
+				{
+					RowCounts[TileId] = static_cast<CounterType>(RowDefaults[TileId] - RowDeltas[TileId]);
+				}
+				RowDeltas += NumTiles;
+				break;
+			}
+			RowCounts += NumTiles;
+		}
+	}
+}
+
+void UWFCArcConstraintSnapshot::SerializeLegacy(FArchive& Ar)
+{
 	Ar << AllowedTiles;
-	Ar << SupportCounts;
-	Ar << DefaultSupportCounts;
+	NumDirections = AllowedTiles.IsEmpty() ? 0 : AllowedTiles[0].Num();
+
+	// allowed tiles weren't always kept sorted, which propagation and the compiled adjacency rely on
+	for (TArray<TArray<FWFCTileId>>& TileAllowedTiles : AllowedTiles)
+	{
+		for (TArray<FWFCTileId>& DirectionAllowedTiles : TileAllowedTiles)
+		{
+			DirectionAllowedTiles.Sort();
+		}
+	}
+
+	if (Ar.CustomVer(FWFCCustomVersion::GUID) < FWFCCustomVersion::FlatArcSupportCounts)
+	{
+		// support counts used to be stored per [CellIndex][TileId][Direction], they can't be used anymore
+		TArray<TArray<TArray<int32>>> OldSupportCounts;
+		TArray<TArray<TArray<int32>>> OldDefaultSupportCounts;
+		Ar << OldSupportCounts;
+		Ar << OldDefaultSupportCounts;
+		SupportCountSize = 0;
+		SupportCounts.Empty();
+		DefaultSupportCounts.Empty();
+	}
+	else
+	{
+		Ar << SupportCountSize;
+		Ar << SupportCounts;
+		Ar << DefaultSupportCounts;
+
+		// every row used to be stored
+		const int64 RowSize = NumDirections > 0 ? DefaultSupportCounts.Num() / NumDirections : 0;
+		const int64 NumRows = RowSize > 0 ? SupportCounts.Num() / RowSize : 0;
+		SupportCountRowIndices.SetNumUninitialized(static_cast<int32>(NumRows));
+		for (int32 Row = 0; Row < NumRows; ++Row)
+		{
+			SupportCountRowIndices[Row] = Row;
+		}
+	}
 	Ar << BansToPropagate;
 }
 
 UWFCArcConsistencyConstraint::UWFCArcConsistencyConstraint()
 	: bIgnoreContradictionCells(false),
+	  PropagationMode(EWFCArcPropagationMode::SupportCounts),
+	  ResidueMemoryBudgetMB(64),
 	  bIsInitialized(false),
+	  NumTiles(0),
+	  NumDirections(0),
+	  SupportCountSize(0),
+	  NumSupportCountRows(0),
+	  SupportCountRowSize(0),
+	  SupportCountRowsPerPage(1),
+	  ResidueHashShift(0),
 	  bDidApplyInitialConsistency(false)
 {
 }
@@ -43,6 +343,11 @@ void UWFCArcConsistencyConstraint::Initialize(UWFCGenerator* InGenerator)
 	SET_DWORD_STAT(STAT_WFCArcConstraintNumChecks, 0);
 	SET_DWORD_STAT(STAT_WFCArcConstraintNumBans, 0);
 
+	ApplyConfigOverrides(InGenerator);
+
+	NumTiles = Model->GetNumTiles();
+	NumDirections = Grid->GetNumDirections();
+
 	if (bIsInitialized)
 	{
 		return;
@@ -51,28 +356,22 @@ void UWFCArcConsistencyConstraint::Initialize(UWFCGenerator* InGenerator)
 	bDidApplyInitialConsistency = false;
 	BansToPropagate.Reset();
 	VisitedDuringPropagation.Reset();
+	Adjacency.Reset();
 
 	// initialize allowed tiles to empty list for each combination of [tile][direction].
-	AllowedTiles.AddZeroed(Model->GetNumTiles());
-	for (int32 TileId = 0; TileId < Model->GetNumTiles(); ++TileId)
-	{
-		AllowedTiles[TileId].AddZeroed(Grid->GetNumDirections());
-	}
-
-	// initialize support counts array (but don't fill it out or ban tiles yet)
-	SupportCounts.Empty(Grid->GetNumCells());
-	SupportCounts.AddZeroed(Grid->GetNumCells());
-	for (int32 CellIndex = 0; CellIndex < Grid->GetNumCells(); ++CellIndex)
+	AllowedTiles.AddZeroed(NumTiles);
+	for (int32 TileId = 0; TileId < NumTiles; ++TileId)
 	{
-		SupportCounts[CellIndex].AddZeroed(Model->GetNumTiles());
-		for (int32 TileId = 0; TileId < Model->GetNumTiles(); ++TileId)
-		{
-			SupportCounts[CellIndex][TileId].AddZeroed(Grid->GetNumDirections());
-		}
+		AllowedTiles[TileId].AddZeroed(NumDirections);
 	}
 
-	// store for quick resetting
-	DefaultSupportCounts = SupportCounts;
+	// support counts are allocated when first applying consistency, since the counter size
+	// depends on the allowed tiles that will be added after this
+	EmptySupportCounts();
+	AllowedTileMasks.Empty();
+	CellsToPropagate.Reset();
+	QueuedCells.Init(false, Grid->GetNumCells());
+	Residues.Empty();
 
 	bIsInitialized = true;
 }
@@ -87,22 +386,46 @@ void UWFCArcConsistencyConstraint::Reset()
 
 	bDidApplyInitialConsistency = false;
 	BansToPropagate.Reset();
+	CellsToPropagate.Reset();
+	QueuedCells.Init(false, Grid->GetNumCells());
 	VisitedDuringPropagation.Reset();
-	SupportCounts = DefaultSupportCounts;
+	ResetBacktracking();
+	// support counts are marked as unwritten by ApplyInitialConsistency, no need to reset them here
 }
 
 void UWFCArcConsistencyConstraint::AddAllowedTileForDirection(FWFCTileId TileId, FWFCGridDirection Direction, FWFCTileId AllowedTileId)
 {
 	INC_DWORD_STAT(STAT_WFCArcConsistencyAdds);
-	if (!AllowedTiles[TileId][Direction].Contains(AllowedTileId))
+	checkf(SupportCountSize == 0, TEXT("Allowed tiles cannot be added after support counts have been allocated"));
+
+	// keep the list sorted, so that propagation walks forward through a neighbor's support counts
+	TArray<FWFCTileId>& DirectionAllowedTiles = AllowedTiles[TileId][Direction];
+	const int32 InsertIndex = Algo::LowerBound(DirectionAllowedTiles, AllowedTileId);
+	if (!DirectionAllowedTiles.IsValidIndex(InsertIndex) || DirectionAllowedTiles[InsertIndex] != AllowedTileId)
 	{
-		AllowedTiles[TileId][Direction].Add(AllowedTileId);
+		DirectionAllowedTiles.Insert(AllowedTileId, InsertIndex);
 		INC_DWORD_STAT(STAT_WFCArcConsistencyEntries);
 	}
 }
 
-const TArray<FWFCTileId>& UWFCArcConsistencyConstraint::GetAllowedTileIds(FWFCTileId TileId, FWFCGridDirection Direction) const
+void UWFCArcConsistencyConstraint::SetAllowedTilesForDirection(FWFCTileId TileId, FWFCGridDirection Direction,
+                                                               TArrayView<const FWFCTileId> AllowedTileIds)
 {
+	checkf(SupportCountSize == 0, TEXT("Allowed tiles cannot be added after support counts have been allocated"));
+	checkSlow(Algo::IsSorted(AllowedTileIds));
+
+	TArray<FWFCTileId>& DirectionAllowedTiles = AllowedTiles[TileId][Direction];
+	DEC_DWORD_STAT_BY(STAT_WFCArcConsistencyEntries, DirectionAllowedTiles.Num());
+	DirectionAllowedTiles = AllowedTileIds;
+	INC_DWORD_STAT_BY(STAT_WFCArcConsistencyEntries, DirectionAllowedTiles.Num());
+}
+
+TArrayView<const FWFCTileId> UWFCArcConsistencyConstraint::GetAllowedTileIds(FWFCTileId TileId, FWFCGridDirection Direction) const
+{
+	if (Adjacency.IsValid())
+	{
+		return Adjacency->GetAllowedTiles(TileId, Direction);
+	}
 	return AllowedTiles[TileId][Direction];
 }
 
@@ -110,7 +433,27 @@ UWFCConstraintSnapshot* UWFCArcConsistencyConstraint::CreateSnapshot(UObject* Ou
 {
 	UWFCArcConstraintSnapshot* Snapshot = NewObject<UWFCArcConstraintSnapshot>(Outer);
 	Snapshot->AllowedTiles = AllowedTiles;
-	Snapshot->SupportCounts = SupportCounts;
+	Snapshot->Adjacency = Adjacency;
+	const UWFCCompiledModel* CompiledModel = Generator->GetCompiledModel();
+	if (CompiledModel && Adjacency.IsValid() && CompiledModel->Adjacency == Adjacency)
+	{
+		Snapshot->CompiledModel = CompiledModel;
+	}
+	Snapshot->NumDirections = NumDirections;
+	Snapshot->SupportCountSize = SupportCountSize;
+	if (SupportCountSize > 0)
+	{
+		// only written rows are stored, in the same order so that their indices stay the same
+		Snapshot->SupportCountRowIndices = SupportCountRowIndices;
+		Snapshot->SupportCounts.SetNumUninitialized(static_cast<int64>(NumSupportCountRows) * SupportCountRowSize);
+		for (int32 PageIndex = 0; PageIndex * SupportCountRowsPerPage < NumSupportCountRows; ++PageIndex)
+		{
+			const int32 FirstRow = PageIndex * SupportCountRowsPerPage;
+			const int32 NumPageRows = FMath::Min(SupportCountRowsPerPage, NumSupportCountRows - FirstRow);
+			FMemory::Memcpy(Snapshot->SupportCounts.GetData() + static_cast<int64>(FirstRow) * SupportCountRowSize,
+			                SupportCountPages[PageIndex].GetData(), static_cast<int64>(NumPageRows) * SupportCountRowSize);
+		}
+	}
 	Snapshot->DefaultSupportCounts = DefaultSupportCounts;
 	Snapshot->BansToPropagate = BansToPropagate;
 	return Snapshot;
@@ -123,24 +466,108 @@ void UWFCArcConsistencyConstraint::ApplySnapshot(const UWFCConstraintSnapshot* S
 	{
 		return;
 	}
-	AllowedTiles = ArcSnapshot->AllowedTiles;
-	SupportCounts = ArcSnapshot->SupportCounts;
+
+	// snapshots can be applied before Initialize, so the overrides are retrieved from the generator that owns this
+	ApplyConfigOverrides(GetTypedOuter<UWFCGenerator>());
+
+	// the compiled adjacency is immutable, so it is shared with the snapshot instead of copied,
+	// which also lets every generator started from the same snapshot use one table.
+	TSharedPtr<const FWFCArcAdjacency> SnapshotAdjacency = ArcSnapshot->GetAdjacency();
+	const bool bIsSameAdjacency = SnapshotAdjacency.IsValid() && SnapshotAdjacency == Adjacency;
+	if (SnapshotAdjacency.IsValid())
+	{
+		Adjacency = MoveTemp(SnapshotAdjacency);
+		AllowedTiles.Empty();
+	}
+	else
+	{
+		Adjacency.Reset();
+		AllowedTiles = ArcSnapshot->AllowedTiles;
+	}
+	bIsInitialized = true;
+	ResetBacktracking();
+
+	if (PropagationMode != EWFCArcPropagationMode::SupportCounts)
+	{
+		// other modes only depend on the cell candidates, so consistency is applied again on the next update,
+		// which checks every cell when using bitsets. residues are only hints, so they are kept.
+		if (!bIsSameAdjacency)
+		{
+			AllowedTileMasks.Empty();
+		}
+		EmptySupportCounts();
+		if (PropagationMode == EWFCArcPropagationMode::Residues)
+		{
+			BansToPropagate = ArcSnapshot->BansToPropagate;
+		}
+		else
+		{
+			BansToPropagate.Reset();
+		}
+		CellsToPropagate.Reset();
+		bDidApplyInitialConsistency = false;
+		return;
+	}
+
+	if (ArcSnapshot->SupportCountSize == 0)
+	{
+		// support counts are missing, outdated, or were never kept by the mode the snapshot was taken in.
+		// they are rebuilt from the applied cell candidates on the next update.
+		UE_LOG(LogWFC, Verbose, TEXT("%s snapshot has no support counts, they will be rebuilt from the cell candidates"),
+		       *GetClass()->GetName());
+		EmptySupportCounts();
+		BansToPropagate.Reset();
+		bDidApplyInitialConsistency = false;
+		return;
+	}
+
+	if (!Adjacency.IsValid())
+	{
+		CompileAdjacency();
+	}
+
+	SupportCountSize = ArcSnapshot->SupportCountSize;
 	DefaultSupportCounts = ArcSnapshot->DefaultSupportCounts;
 	BansToPropagate = ArcSnapshot->BansToPropagate;
 
-	bIsInitialized = true;
+	// the snapshot's written rows are added in order, so its row indices stay valid.
+	// the row size can't use NumTiles, since snapshots can be applied before Initialize.
+	ResetSupportCountRows(ArcSnapshot->NumDirections > 0 ? DefaultSupportCounts.Num() / ArcSnapshot->NumDirections : 0);
+	SupportCountRowIndices = ArcSnapshot->SupportCountRowIndices;
+	const int64 NumWrittenRows = SupportCountRowSize > 0 ? ArcSnapshot->SupportCounts.Num() / SupportCountRowSize : 0;
+	for (int64 Row = 0; Row < NumWrittenRows; ++Row)
+	{
+		FMemory::Memcpy(GetWrittenSupportCountRow(AddSupportCountRow()),
+		                ArcSnapshot->SupportCounts.GetData() + Row * SupportCountRowSize, SupportCountRowSize);
+	}
+
 	bDidApplyInitialConsistency = true;
 }
 
 void UWFCArcConsistencyConstraint::NotifyCellBan(FWFCCellIndex CellIndex, FWFCTileId BannedTileId)
 {
-	// update support counts
-	for (FWFCGridDirection Direction = 0; Direction < Grid->GetNumDirections(); ++Direction)
+	NotifyCellBans(CellIndex, MakeArrayView(&BannedTileId, 1));
+}
+
+void UWFCArcConsistencyConstraint::NotifyCellBans(FWFCCellIndex CellIndex, TArrayView<const FWFCTileId> BannedTileIds)
+{
+	if (PropagationMode == EWFCArcPropagationMode::Bitsets)
 	{
-		SupportCounts[CellIndex][BannedTileId][Direction] -= 1;
+		// every cell is checked when first applying consistency, so only changes after that need to be queued
+		if (bDidApplyInitialConsistency)
+		{
+			QueueCellToPropagate(CellIndex);
+		}
+		return;
 	}
 
-	BansToPropagate.Push(FWFCCellIndexAndTileId(CellIndex, BannedTileId));
+	// a banned tile's counts in its own cell are never read again, so only the neighbors' rows
+	// are decremented once the ban is propagated.
+	BansToPropagate.Reserve(BansToPropagate.Num() + BannedTileIds.Num());
+	for (const FWFCTileId BannedTileId : BannedTileIds)
+	{
+		BansToPropagate.Push(FWFCCellIndexAndTileId(CellIndex, BannedTileId));
+	}
 }
 
 bool UWFCArcConsistencyConstraint::Next()
@@ -164,107 +591,819 @@ bool UWFCArcConsistencyConstraint::Next()
 	return bDidMakeChanges;
 }
 
-void UWFCArcConsistencyConstraint::ApplyInitialConsistency()
+void UWFCArcConsistencyConstraint::SaveBacktrackPoint()
+{
+	FWFCArcBacktrackPoint& BacktrackPoint = BacktrackPoints.Emplace_GetRef(PropagatedTrail.Num(), BansToPropagate);
+	BacktrackPoint.CellsToPropagate = CellsToPropagate;
+}
+
+void UWFCArcConsistencyConstraint::RestoreBacktrackPoint()
 {
-	// initialize support counts for each [CellIndex][TileId][Direction]
-	for (int32 CellIndex = 0; CellIndex < Grid->GetNumCells(); ++CellIndex)
+	if (BacktrackPoints.IsEmpty())
 	{
-		FWFCCell& Cell = Generator->GetCell(CellIndex);
+		return;
+	}
 
-		for (int32 TileId = 0; TileId < Model->GetNumTiles(); ++TileId)
-		{
-			for (FWFCGridDirection Direction = 0; Direction < Grid->GetNumDirections(); ++Direction)
-			{
-				const int32 NeighborCellIndex = Grid->GetCellIndexInDirection(CellIndex, Direction);
-				if (!Grid->IsValidCellIndex(NeighborCellIndex))
-				{
-					continue;
-				}
+	const FWFCArcBacktrackPoint BacktrackPoint = BacktrackPoints.Pop(EAllowShrinking::No);
 
-				// support count is the number of compatible tile ids that exist in a
-				// direction from one cell to another, for a specific tile id.
-				const int32 SupportCount = AllowedTiles[TileId][Direction].Num();
-				SupportCounts[CellIndex][TileId][Direction] = SupportCount;
-				if (SupportCount == 0 && Cell.TileCandidates.Contains(TileId))
-				{
-					if (Generator->Ban(CellIndex, TileId) && !bIgnoreContradictionCells)
-					{
-						return;
-					}
-					break;
-				}
-			}
-		}
+	switch (SupportCountSize)
+	{
+	case sizeof(uint8):
+		RestoreSupportCounts<uint8>(BacktrackPoint);
+		break;
+	case sizeof(uint16):
+		RestoreSupportCounts<uint16>(BacktrackPoint);
+		break;
+	default:
+		RestoreSupportCounts<uint32>(BacktrackPoint);
+		break;
 	}
-}
 
-bool UWFCArcConsistencyConstraint::PropagateChanges()
-{
-#if !UE_BUILD_SHIPPING
-	VisitedDuringPropagation.Reset();
-#endif
+	PropagatedTrail.SetNum(BacktrackPoint.PropagatedTrailNum, EAllowShrinking::No);
+	BansToPropagate = BacktrackPoint.BansToPropagate;
 
-	bool bDidAnyWork = false;
-	while (!BansToPropagate.IsEmpty())
+	// the generator restores the candidates, so the queued cells are the only state of bitset propagation
+	for (const FWFCCellIndex CellIndex : CellsToPropagate)
 	{
-		bDidAnyWork = true;
-		const FWFCCellIndexAndTileId BanToPropagate = BansToPropagate.Pop();
+		QueuedCells[CellIndex] = false;
+	}
+	CellsToPropagate = BacktrackPoint.CellsToPropagate;
+	for (const FWFCCellIndex CellIndex : CellsToPropagate)
+	{
+		QueuedCells[CellIndex] = true;
+	}
+}
 
-		// update cells in each direction around the affected cell
-		for (FWFCGridDirection Direction = 0; Direction < Grid->GetNumDirections(); ++Direction)
-		{
-			const FWFCCellIndex NeighborCellIndex = Grid->GetCellIndexInDirection(BanToPropagate.CellIndex, Direction);
-			if (!Grid->IsValidCellIndex(NeighborCellIndex))
-			{
-				continue;
-			}
+void UWFCArcConsistencyConstraint::ResetBacktracking()
+{
+	PropagatedTrail.Reset();
+	BacktrackPoints.Reset();
+}
 
-#if !UE_BUILD_SHIPPING
-			VisitedDuringPropagation.AddUnique(FWFCCellIndexAndDirection(BanToPropagate.CellIndex, Direction));
-#endif
+void UWFCArcConsistencyConstraint::ApplyConfigOverrides(const UWFCGenerator* InGenerator)
+{
+	if (!InGenerator)
+	{
+		return;
+	}
 
-			const FWFCGridDirection InvDirection = Grid->GetOppositeDirection(Direction);
+	if (InGenerator->Config.bOverrideArcPropagationMode)
+	{
+		PropagationMode = InGenerator->Config.ArcPropagationMode;
+	}
+	if (InGenerator->Config.bOverrideArcResidueMemoryBudget)
+	{
+		ResidueMemoryBudgetMB = InGenerator->Config.ArcResidueMemoryBudgetMB;
+	}
+}
 
-			// use the outgoing direction from the banned tile to determine which tile id's were supported,
-			// then decrease the support count for each one.
-			const TArray<FWFCTileId>& SupportedTiles = AllowedTiles[BanToPropagate.TileId][Direction];
-			for (const FWFCTileId& SupportedTileId : SupportedTiles)
+int32 UWFCArcConsistencyConstraint::CalculateSupportCountSize() const
+{
+	// find the largest number of supports that any tile can start with
+	int32 MaxSupportCount = 0;
+	if (Adjacency.IsValid())
+	{
+		MaxSupportCount = Adjacency->GetMaxNumAllowedTiles();
+	}
+	else
+	{
+		for (const TArray<TArray<FWFCTileId>>& TileAllowedTiles : AllowedTiles)
+		{
+			for (const TArray<FWFCTileId>& DirectionAllowedTiles : TileAllowedTiles)
 			{
-				// Decrement the support count for the supported tile. 
-				// e.g. if tile 1 can have tile 2, 3, or 4 next to it in Direction, it starts with 3 supports.
-				// when tile 3 is banned from the neighbor cell, it loses a support, if all are lost then
-				// tile 1 is no longer a valid candidate.
-				const int32 SupportCount = --SupportCounts[NeighborCellIndex][SupportedTileId][InvDirection];
-				if (SupportCount == 0)
-				{
-					// no more supports left, ban this tile id for the neighbor
-					if (Generator->Ban(NeighborCellIndex, SupportedTileId) && !bIgnoreContradictionCells)
-					{
-						// contradiction
-						return true;
-					}
-				}
+				MaxSupportCount = FMath::Max(MaxSupportCount, DirectionAllowedTiles.Num());
 			}
 		}
+	}
 
-		if (Generator->StepGranularity >= EWFCGeneratorStepGranularity::ConstraintDetailed)
-		{
-			// break after each ban propagation
-			break;
-		}
+	if (MaxSupportCount <= MAX_uint8)
+	{
+		return sizeof(uint8);
 	}
-	return bDidAnyWork;
+	if (MaxSupportCount <= MAX_uint16)
+	{
+		return sizeof(uint16);
+	}
+	return sizeof(uint32);
 }
 
-void UWFCArcConsistencyConstraint::LogDebugInfo() const
+void UWFCArcConsistencyConstraint::CompileAdjacency()
 {
-	Super::LogDebugInfo();
+	Adjacency = MakeShared<const FWFCArcAdjacency>(AllowedTiles, NumDirections);
+	AllowedTiles.Empty();
+}
 
-	UE_LOG(LogWFC, Verbose, TEXT("%s AllowedTiles allocated size: %.3fKB"),
+void UWFCArcConsistencyConstraint::CompileModel(UWFCCompiledModel* CompiledModel) const
+{
+	if (CompiledModel->Adjacency.IsValid())
+	{
+		// only the first arc consistency constraint is compiled
+		return;
+	}
+
+	CompiledModel->AdjacencyConstraintClass = GetClass();
+	CompiledModel->AdjacencyConstraintHash = CalculateCompiledRulesHash();
+	CompiledModel->Adjacency = Adjacency.IsValid() ? Adjacency : MakeShared<const FWFCArcAdjacency>(AllowedTiles, NumDirections);
+}
+
+bool UWFCArcConsistencyConstraint::InitializeFromCompiledModel()
+{
+	const UWFCCompiledModel* CompiledModel = Generator->GetCompiledModel();
+	if (!CompiledModel || !CompiledModel->Adjacency.IsValid() ||
+		!CompiledModel->IsValidForConstraint(this, CompiledModel->AdjacencyConstraintClass, CompiledModel->AdjacencyConstraintHash))
+	{
+		return false;
+	}
+
+	Adjacency = CompiledModel->Adjacency;
+	AllowedTiles.Empty();
+	return true;
+}
+
+void UWFCArcConsistencyConstraint::AllocateSupportCounts()
+{
+	if (!Adjacency.IsValid())
+	{
+		CompileAdjacency();
+	}
+
+	SupportCountSize = CalculateSupportCountSize();
+
+	// rows are only stored once they are first written, so this only needs an index for each cell and direction
+	ResetSupportCountRows(NumTiles * SupportCountSize);
+	SupportCountRowIndices.Init(INDEX_NONE, Grid->GetNumCells() * NumDirections);
+	DefaultSupportCounts.SetNumUninitialized(NumDirections * NumTiles * SupportCountSize);
+
+	switch (SupportCountSize)
+	{
+	case sizeof(uint8):
+		FillDefaultSupportCounts<uint8>();
+		break;
+	case sizeof(uint16):
+		FillDefaultSupportCounts<uint16>();
+		break;
+	default:
+		FillDefaultSupportCounts<uint32>();
+		break;
+	}
+
+	UE_LOG(LogWFC, Verbose, TEXT("%s allocated %.3fKB of support counts (%d bytes each)"),
+	       *GetClass()->GetName(), GetSupportCountsAllocatedSize() / 1024.f, SupportCountSize);
+}
+
+int32 UWFCArcConsistencyConstraint::AddSupportCountRow()
+{
+	const int32 WrittenRowIndex = NumSupportCountRows++;
+	const int32 PageIndex = WrittenRowIndex / SupportCountRowsPerPage;
+	if (PageIndex == SupportCountPages.Num())
+	{
+		// rows are written before being read, so pages don't need to be zeroed.
+		// moving the pages array doesn't move the data of each page, so existing rows keep their address.
+		SupportCountPages.AddDefaulted_GetRef().SetNumUninitialized(SupportCountRowsPerPage * SupportCountRowSize);
+	}
+	return WrittenRowIndex;
+}
+
+void UWFCArcConsistencyConstraint::ResetSupportCountRows(int32 RowSize)
+{
+	if (RowSize != SupportCountRowSize)
+	{
+		SupportCountPages.Empty();
+		SupportCountRowSize = RowSize;
+		SupportCountRowsPerPage = FMath::Max(WFCSupportCountPageSize / FMath::Max(RowSize, 1), 1);
+	}
+	NumSupportCountRows = 0;
+}
+
+void UWFCArcConsistencyConstraint::EmptySupportCounts()
+{
+	SupportCountSize = 0;
+	SupportCountRowIndices.Empty();
+	SupportCountPages.Empty();
+	NumSupportCountRows = 0;
+	DefaultSupportCounts.Empty();
+}
+
+SIZE_T UWFCArcConsistencyConstraint::GetSupportCountsAllocatedSize() const
+{
+	SIZE_T Size = SupportCountRowIndices.GetAllocatedSize() + SupportCountPages.GetAllocatedSize() + DefaultSupportCounts.GetAllocatedSize();
+	for (const TArray<uint8>& Page : SupportCountPages)
+	{
+		Size += Page.GetAllocatedSize();
+	}
+	return Size;
+}
+
+template <typename CounterType>
+void UWFCArcConsistencyConstraint::FillDefaultSupportCounts()
+{
+	CounterType* Defaults = reinterpret_cast<CounterType*>(DefaultSupportCounts.GetData());
+	const FWFCArcAdjacency& AllowedTilesTable = *Adjacency;
+	for (FWFCGridDirection Direction = 0; Direction < NumDirections; ++Direction)
+	{
+		for (FWFCTileId TileId = 0; TileId < NumTiles; ++TileId)
+		{
+			// support count is the number of compatible tile ids that exist in a
+			// direction from one cell to another, for a specific tile id.
+			Defaults[Direction * NumTiles + TileId] = static_cast<CounterType>(AllowedTilesTable.GetAllowedTiles(TileId, Direction).Num());
+		}
+	}
+}
+
+void UWFCArcConsistencyConstraint::WriteInitialSupportCountRow(uint8* Row, FWFCCellIndex CellIndex, FWFCGridDirection Direction) const
+{
+	// directions without a neighbor are never decremented by propagation, so they are just zeroed
+	const int64 RowSize = static_cast<int64>(NumTiles) * SupportCountSize;
+	if (Grid->GetNeighborIndex(CellIndex, Direction) != INDEX_NONE)
+	{
+		FMemory::Memcpy(Row, DefaultSupportCounts.GetData() + Direction * RowSize, RowSize);
+	}
+	else
+	{
+		FMemory::Memzero(Row, RowSize);
+	}
+}
+
+template <typename CounterType>
+void UWFCArcConsistencyConstraint::RestoreSupportCounts(const FWFCArcBacktrackPoint& BacktrackPoint)
+{
+	// increments are the exact inverse of the decrements, and the order doesn't matter since they only
+	// add to the counts. every row in the trail was written when it was decremented, so none are added here.
+	const FWFCArcAdjacency& AllowedTilesTable = *Adjacency;
+	for (int32 Idx = PropagatedTrail.Num() - 1; Idx >= BacktrackPoint.PropagatedTrailNum; --Idx)
+	{
+		const FWFCCellIndexAndTileId& PropagatedBan = PropagatedTrail[Idx];
+		for (FWFCGridDirection Direction = 0; Direction < NumDirections; ++Direction)
+		{
+			const FWFCCellIndex NeighborCellIndex = Grid->GetNeighborIndex(PropagatedBan.CellIndex, Direction);
+			if (NeighborCellIndex == INDEX_NONE)
+			{
+				continue;
+			}
+
+			CounterType* NeighborCounts = GetMutableSupportCountRow<CounterType>(NeighborCellIndex, Grid->GetCachedOppositeDirection(Direction));
+			for (const FWFCTileId& SupportedTileId : AllowedTilesTable.GetAllowedTiles(PropagatedBan.TileId, Direction))
+			{
+				++NeighborCounts[SupportedTileId];
+			}
+		}
+	}
+}
+
+void UWFCArcConsistencyConstraint::ApplyInitialConsistency()
+{
+	if (PropagationMode == EWFCArcPropagationMode::Bitsets)
+	{
+		if (AllowedTileMasks.IsEmpty())
+		{
+			AllocateAllowedTileMasks();
+		}
+
+		// check every cell once, which also bans tiles with no supports and propagates any bans from before now
+		const int32 NumCells = Grid->GetNumCells();
+		BansToPropagate.Reset();
+		CellsToPropagate.SetNumUninitialized(NumCells);
+		for (int32 CellIndex = 0; CellIndex < NumCells; ++CellIndex)
+		{
+			// cells are popped from the end, so queue them in reverse to check them in order
+			CellsToPropagate[CellIndex] = NumCells - 1 - CellIndex;
+		}
+		QueuedCells.Init(true, NumCells);
+		bDidApplyInitialConsistency = true;
+		return;
+	}
+
+	if (PropagationMode == EWFCArcPropagationMode::Residues)
+	{
+		if (Residues.IsEmpty())
+		{
+			AllocateResidues();
+		}
+		else if (!Adjacency.IsValid())
+		{
+			CompileAdjacency();
+		}
+
+		// residues start pointing at the first allowed tile, which is only a hint, so the only work left is to
+		// ban tiles with no supports, and propagate any bans from before now.
+		bDidApplyInitialConsistency = true;
+		BanUnsupportedTiles();
+		return;
+	}
+
+	if (SupportCountSize == 0)
+	{
+		AllocateSupportCounts();
+	}
+
+	// every row of support counts starts with its initial values, which are only written once a row is first changed,
+	// so resetting only clears the row indices, and keeps any pages of rows for reuse.
+	ResetSupportCountRows(SupportCountRowSize);
+	for (int32& WrittenRowIndex : SupportCountRowIndices)
+	{
+		WrittenRowIndex = INDEX_NONE;
+	}
+
+	// mark counts as initialized so that the bans below update them
+	bDidApplyInitialConsistency = true;
+
+	// cells may have lost candidates before now, either from earlier constraints or from an applied snapshot,
+	// so subtract every missing candidate from the default counts by propagating it like any other ban.
+	BansToPropagate.Reset();
+	const int32 NumCells = Grid->GetNumCells();
+	const int32 NumWords = FWFCTileBitset::GetNumWordsForBits(NumTiles);
+	TArray<FWFCTileId> MissingTileIds;
+	for (int32 CellIndex = 0; CellIndex < NumCells; ++CellIndex)
+	{
+		const FWFCTileBitset& Candidates = Generator->GetCell(CellIndex).TileCandidates;
+		if (Candidates.Num() == NumTiles)
+		{
+			continue;
+		}
+
+		const uint64* Words = Candidates.GetWords();
+		for (int32 WordIndex = 0; WordIndex < NumWords; ++WordIndex)
+		{
+			const int32 NumWordBits = FMath::Min(NumTiles - WordIndex * FWFCTileBitset::BitsPerWord, FWFCTileBitset::BitsPerWord);
+			uint64 MissingWord = ~Words[WordIndex] & (NumWordBits == FWFCTileBitset::BitsPerWord ? ~0ull : (1ull << NumWordBits) - 1);
+			while (MissingWord)
+			{
+				MissingTileIds.Add(WordIndex * FWFCTileBitset::BitsPerWord + FMath::CountTrailingZeros64(MissingWord));
+				MissingWord &= MissingWord - 1;
+			}
+		}
+		NotifyCellBans(CellIndex, MissingTileIds);
+		MissingTileIds.Reset();
+	}
+
+	BanUnsupportedTiles();
+}
+
+void UWFCArcConsistencyConstraint::BanUnsupportedTiles()
+{
+	// gather tiles that have no supports at all in each direction
+	TArray<TArray<FWFCTileId>> UnsupportedTiles;
+	UnsupportedTiles.SetNum(NumDirections);
+	bool bHasUnsupportedTiles = false;
+	for (FWFCTileId TileId = 0; TileId < NumTiles; ++TileId)
+	{
+		for (FWFCGridDirection Direction = 0; Direction < NumDirections; ++Direction)
+		{
+			if (Adjacency->GetAllowedTiles(TileId, Direction).IsEmpty())
+			{
+				UnsupportedTiles[Direction].Add(TileId);
+				bHasUnsupportedTiles = true;
+			}
+		}
+	}
+
+	if (!bHasUnsupportedTiles)
+	{
+		return;
+	}
+
+	// ban unsupported tiles from any cell that has a neighbor in that direction
+	const int32 NumCells = Grid->GetNumCells();
+	for (int32 CellIndex = 0; CellIndex < NumCells; ++CellIndex)
+	{
+		for (FWFCGridDirection Direction = 0; Direction < NumDirections; ++Direction)
+		{
+			if (UnsupportedTiles[Direction].IsEmpty())
+			{
+				continue;
+			}
+
+			if (Grid->GetNeighborIndex(CellIndex, Direction) == INDEX_NONE)
+			{
+				continue;
+			}
+
+			for (const FWFCTileId TileId : UnsupportedTiles[Direction])
+			{
+				if (Generator->GetCell(CellIndex).TileCandidates.Contains(TileId))
+				{
+					if (Generator->Ban(CellIndex, TileId) && !bIgnoreContradictionCells)
+					{
+						return;
+					}
+				}
+			}
+		}
+	}
+}
+
+bool UWFCArcConsistencyConstraint::PropagateChanges()
+{
+	if (PropagationMode == EWFCArcPropagationMode::Bitsets)
+	{
+		return PropagateChangesWithBitsets();
+	}
+	if (PropagationMode == EWFCArcPropagationMode::Residues)
+	{
+		return PropagateChangesWithResidues();
+	}
+
+	switch (SupportCountSize)
+	{
+	case sizeof(uint8):
+		return PropagateChangesWithCounters<uint8>();
+	case sizeof(uint16):
+		return PropagateChangesWithCounters<uint16>();
+	default:
+		return PropagateChangesWithCounters<uint32>();
+	}
+}
+
+template <typename CounterType>
+bool UWFCArcConsistencyConstraint::PropagateChangesWithCounters()
+{
+#if !UE_BUILD_SHIPPING
+	VisitedDuringPropagation.Reset();
+#endif
+
+	const FWFCArcAdjacency& AllowedTilesTable = *Adjacency;
+
+	bool bDidAnyWork = false;
+	while (!BansToPropagate.IsEmpty())
+	{
+		bDidAnyWork = true;
+		const FWFCCellIndexAndTileId BanToPropagate = BansToPropagate.Pop();
+
+		// after a contradiction, the remaining supports of this ban are still decremented but nothing else is banned,
+		// so that the ban is either fully propagated or not at all, and can be undone exactly when backtracking.
+		bool bIsContradiction = false;
+
+		// like the other modes, a cell with no candidates left doesn't ban anything when contradiction cells are ignored,
+		// but its supports are still removed so the counts stay exact.
+		const bool bIsIgnoredCell = bIgnoreContradictionCells && Generator->GetCell(BanToPropagate.CellIndex).HasNoCandidates();
+
+		// update cells in each direction around the affected cell
+		for (FWFCGridDirection Direction = 0; Direction < NumDirections; ++Direction)
+		{
+			const FWFCCellIndex NeighborCellIndex = Grid->GetNeighborIndex(BanToPropagate.CellIndex, Direction);
+			if (NeighborCellIndex == INDEX_NONE)
+			{
+				continue;
+			}
+
+#if !UE_BUILD_SHIPPING
+			VisitedDuringPropagation.AddUnique(FWFCCellIndexAndDirection(BanToPropagate.CellIndex, Direction));
+#endif
+
+			const FWFCGridDirection InvDirection = Grid->GetCachedOppositeDirection(Direction);
+
+			// the neighbor's counts for the incoming direction are contiguous by tile id, and supported tiles
+			// are sorted, so this only ever walks forward through them.
+			CounterType* NeighborCounts = GetMutableSupportCountRow<CounterType>(NeighborCellIndex, InvDirection);
+
+			// use the outgoing direction from the banned tile to determine which tile id's were supported,
+			// then decrease the support count for each one.
+			const TArrayView<const FWFCTileId> SupportedTiles = AllowedTilesTable.GetAllowedTiles(BanToPropagate.TileId, Direction);
+			for (const FWFCTileId& SupportedTileId : SupportedTiles)
+			{
+				// Decrement the support count for the supported tile.
+				// e.g. if tile 1 can have tile 2, 3, or 4 next to it in Direction, it starts with 3 supports.
+				// when tile 3 is banned from the neighbor cell, it loses a support, if all are lost then
+				// tile 1 is no longer a valid candidate.
+				if (--NeighborCounts[SupportedTileId] == 0 && !bIsContradiction && !bIsIgnoredCell)
+				{
+					// no more supports left, ban this tile id for the neighbor
+					if (Generator->Ban(NeighborCellIndex, SupportedTileId) && !bIgnoreContradictionCells)
+					{
+						// contradiction
+						bIsContradiction = true;
+					}
+				}
+			}
+		}
+
+		if (!BacktrackPoints.IsEmpty())
+		{
+			PropagatedTrail.Add(BanToPropagate);
+		}
+
+		if (bIsContradiction)
+		{
+			return true;
+		}
+
+		if (Generator->StepGranularity >= EWFCGeneratorStepGranularity::ConstraintDetailed)
+		{
+			// break after each ban propagation
+			break;
+		}
+	}
+	return bDidAnyWork;
+}
+
+void UWFCArcConsistencyConstraint::AllocateAllowedTileMasks()
+{
+	if (!Adjacency.IsValid())
+	{
+		CompileAdjacency();
+	}
+
+	const int32 NumWords = FWFCTileBitset::GetNumWordsForBits(NumTiles);
+	AllowedTileMasks.SetNumZeroed((NumTiles + 1) * NumDirections * NumWords);
+	for (FWFCTileId TileId = 0; TileId < NumTiles; ++TileId)
+	{
+		for (FWFCGridDirection Direction = 0; Direction < NumDirections; ++Direction)
+		{
+			uint64* Mask = AllowedTileMasks.GetData() + (TileId * NumDirections + Direction) * NumWords;
+			uint64* AllTilesMask = AllowedTileMasks.GetData() + (NumTiles * NumDirections + Direction) * NumWords;
+			for (const FWFCTileId AllowedTileId : Adjacency->GetAllowedTiles(TileId, Direction))
+			{
+				const int32 WordIndex = AllowedTileId / FWFCTileBitset::BitsPerWord;
+				Mask[WordIndex] |= FWFCTileBitset::GetBitMask(AllowedTileId);
+				AllTilesMask[WordIndex] |= FWFCTileBitset::GetBitMask(AllowedTileId);
+			}
+		}
+	}
+
+	UE_LOG(LogWFC, Verbose, TEXT("%s allocated %.3fKB of allowed tile masks"),
+	       *GetClass()->GetName(), AllowedTileMasks.GetAllocatedSize() / 1024.f);
+}
+
+void UWFCArcConsistencyConstraint::QueueCellToPropagate(FWFCCellIndex CellIndex)
+{
+	FBitReference IsQueued = QueuedCells[CellIndex];
+	if (!IsQueued)
+	{
+		IsQueued = true;
+		CellsToPropagate.Add(CellIndex);
+	}
+}
+
+bool UWFCArcConsistencyConstraint::PropagateChangesWithBitsets()
+{
+#if !UE_BUILD_SHIPPING
+	VisitedDuringPropagation.Reset();
+#endif
+
+	const int32 NumWords = FWFCTileBitset::GetNumWordsForBits(NumTiles);
+	TArray<uint64, TInlineAllocator<8>> SupportedWords;
+	SupportedWords.SetNumUninitialized(NumWords);
+	TArray<FWFCTileId> TileIdsToBan;
+
+	bool bDidAnyWork = false;
+	while (!CellsToPropagate.IsEmpty())
+	{
+		bDidAnyWork = true;
+		const FWFCCellIndex CellIndex = CellsToPropagate.Pop(EAllowShrinking::No);
+		QueuedCells[CellIndex] = false;
+
+		const FWFCTileBitset& Candidates = Generator->GetCell(CellIndex).TileCandidates;
+		if (Candidates.IsEmpty())
+		{
+			// contradiction cells are either ignored, or propagation has already stopped at the contradiction
+			continue;
+		}
+
+		for (FWFCGridDirection Direction = 0; Direction < NumDirections; ++Direction)
+		{
+			const FWFCCellIndex NeighborCellIndex = Grid->GetNeighborIndex(CellIndex, Direction);
+			if (NeighborCellIndex == INDEX_NONE)
+			{
+				continue;
+			}
+
+#if !UE_BUILD_SHIPPING
+			VisitedDuringPropagation.AddUnique(FWFCCellIndexAndDirection(CellIndex, Direction));
+#endif
+			INC_DWORD_STAT(STAT_WFCArcConstraintNumChecks);
+
+			// combine the allowed tiles of every remaining candidate, cells that haven't changed yet
+			// use the precombined mask of all tiles instead.
+			const uint64* Supported = GetAllowedTileMask(INDEX_NONE, Direction);
+			if (Candidates.Num() < NumTiles)
+			{
+				FMemory::Memzero(SupportedWords.GetData(), NumWords * sizeof(uint64));
+				for (const FWFCTileId TileId : Candidates)
+				{
+					const uint64* Mask = GetAllowedTileMask(TileId, Direction);
+					for (int32 WordIndex = 0; WordIndex < NumWords; ++WordIndex)
+					{
+						SupportedWords[WordIndex] |= Mask[WordIndex];
+					}
+				}
+				Supported = SupportedWords.GetData();
+			}
+
+			// ban every candidate of the neighbor that is no longer supported
+			const uint64* NeighborWords = Generator->GetCell(NeighborCellIndex).TileCandidates.GetWords();
+			for (int32 WordIndex = 0; WordIndex < NumWords; ++WordIndex)
+			{
+				uint64 UnsupportedWord = NeighborWords[WordIndex] & ~Supported[WordIndex];
+				while (UnsupportedWord)
+				{
+					TileIdsToBan.Add(WordIndex * FWFCTileBitset::BitsPerWord + FMath::CountTrailingZeros64(UnsupportedWord));
+					UnsupportedWord &= UnsupportedWord - 1;
+				}
+			}
+
+			if (!TileIdsToBan.IsEmpty())
+			{
+				INC_DWORD_STAT_BY(STAT_WFCArcConstraintNumBans, TileIdsToBan.Num());
+				if (Generator->BanMultiple(NeighborCellIndex, MoveTemp(TileIdsToBan)) && !bIgnoreContradictionCells)
+				{
+					// contradiction
+					return true;
+				}
+				TileIdsToBan.Reset();
+			}
+		}
+
+		if (Generator->StepGranularity >= EWFCGeneratorStepGranularity::ConstraintDetailed)
+		{
+			// break after each cell propagation
+			break;
+		}
+	}
+	return bDidAnyWork;
+}
+
+int64 UWFCArcConsistencyConstraint::CalculateResiduesSize(int32& OutHashShift) const
+{
+	const int64 NumResidues = static_cast<int64>(Grid->GetNumCells()) * NumDirections * NumTiles;
+	const int64 MaxResidues = FMath::Max<int64>(static_cast<int64>(ResidueMemoryBudgetMB) * 1024 * 1024 / sizeof(uint16), 2);
+	if (NumResidues <= MaxResidues)
+	{
+		OutHashShift = 0;
+		return NumResidues;
+	}
+
+	// use the largest power of two within the budget, so that indices can be hashed with a multiply and shift
+	const uint32 TableBits = FMath::FloorLog2_64(static_cast<uint64>(MaxResidues));
+	OutHashShift = 64 - TableBits;
+	return 1ll << TableBits;
+}
+
+void UWFCArcConsistencyConstraint::AllocateResidues()
+{
+	if (!Adjacency.IsValid())
+	{
+		CompileAdjacency();
+	}
+
+	const int64 NumResidues = CalculateResiduesSize(ResidueHashShift);
+	Residues.SetNumZeroed(NumResidues);
+
+	if (ResidueHashShift != 0)
+	{
+		UE_LOG(LogWFC, Verbose, TEXT("%s allocated %.3fKB of residues, shared by %lld cell tiles to stay within %dMB"),
+		       *GetClass()->GetName(), Residues.GetAllocatedSize() / 1024.f,
+		       static_cast<int64>(Grid->GetNumCells()) * NumDirections * NumTiles, ResidueMemoryBudgetMB);
+	}
+	else
+	{
+		UE_LOG(LogWFC, Verbose, TEXT("%s allocated %.3fKB of residues"), *GetClass()->GetName(), Residues.GetAllocatedSize() / 1024.f);
+	}
+}
+
+bool UWFCArcConsistencyConstraint::HasResidualSupport(FWFCCellIndex CellIndex, FWFCGridDirection Direction, FWFCTileId TileId,
+                                                      const FWFCTileBitset& NeighborCandidates)
+{
+	const TArrayView<const FWFCTileId> AllowedTileIds = Adjacency->GetAllowedTiles(TileId, Direction);
+
+	// the last support found is usually still there, residues may also be shared with other cells,
+	// or point past the end, so they are always checked before being used.
+	uint16& Residue = Residues[GetResidueIndex(CellIndex, Direction, TileId)];
+	if (Residue < AllowedTileIds.Num() && NeighborCandidates.Contains(AllowedTileIds[Residue]))
+	{
+		return true;
+	}
+
+	for (int32 Index = 0; Index < AllowedTileIds.Num(); ++Index)
+	{
+		if (NeighborCandidates.Contains(AllowedTileIds[Index]))
+		{
+			Residue = static_cast<uint16>(FMath::Min<int32>(Index, MAX_uint16));
+			return true;
+		}
+	}
+	return false;
+}
+
+bool UWFCArcConsistencyConstraint::PropagateChangesWithResidues()
+{
+#if !UE_BUILD_SHIPPING
+	VisitedDuringPropagation.Reset();
+#endif
+
+	const FWFCArcAdjacency& AllowedTilesTable = *Adjacency;
+	TArray<FWFCTileId> TileIdsToBan;
+
+	bool bDidAnyWork = false;
+	while (!BansToPropagate.IsEmpty())
+	{
+		bDidAnyWork = true;
+		const FWFCCellIndexAndTileId BanToPropagate = BansToPropagate.Pop();
+
+		const FWFCTileBitset& Candidates = Generator->GetCell(BanToPropagate.CellIndex).TileCandidates;
+		if (Candidates.IsEmpty() && bIgnoreContradictionCells)
+		{
+			continue;
+		}
+
+		for (FWFCGridDirection Direction = 0; Direction < NumDirections; ++Direction)
+		{
+			const FWFCCellIndex NeighborCellIndex = Grid->GetNeighborIndex(BanToPropagate.CellIndex, Direction);
+			if (NeighborCellIndex == INDEX_NONE)
+			{
+				continue;
+			}
+
+#if !UE_BUILD_SHIPPING
+			VisitedDuringPropagation.AddUnique(FWFCCellIndexAndDirection(BanToPropagate.CellIndex, Direction));
+#endif
+
+			const FWFCGridDirection InvDirection = Grid->GetCachedOppositeDirection(Direction);
+			const FWFCTileBitset& NeighborCandidates = Generator->GetCell(NeighborCellIndex).TileCandidates;
+
+			// only the neighbor's tiles that the banned tile supported can have lost their last support
+			for (const FWFCTileId SupportedTileId : AllowedTilesTable.GetAllowedTiles(BanToPropagate.TileId, Direction))
+			{
+				if (!NeighborCandidates.Contains(SupportedTileId))
+				{
+					continue;
+				}
+
+				INC_DWORD_STAT(STAT_WFCArcConstraintNumChecks);
+				if (!HasResidualSupport(NeighborCellIndex, InvDirection, SupportedTileId, Candidates))
+				{
+					TileIdsToBan.Add(SupportedTileId);
+				}
+			}
+
+			if (!TileIdsToBan.IsEmpty())
+			{
+				INC_DWORD_STAT_BY(STAT_WFCArcConstraintNumBans, TileIdsToBan.Num());
+				if (Generator->BanMultiple(NeighborCellIndex, MoveTemp(TileIdsToBan)) && !bIgnoreContradictionCells)
+				{
+					// contradiction
+					return true;
+				}
+				TileIdsToBan.Reset();
+			}
+		}
+
+		if (Generator->StepGranularity >= EWFCGeneratorStepGranularity::ConstraintDetailed)
+		{
+			// break after each ban propagation
+			break;
+		}
+	}
+	return bDidAnyWork;
+}
+
+SIZE_T UWFCArcConsistencyConstraint::GetPropagationAllocatedSize() const
+{
+	return GetSupportCountsAllocatedSize() + Residues.GetAllocatedSize() + AllowedTileMasks.GetAllocatedSize() + QueuedCells.GetAllocatedSize() +
+		CellsToPropagate.GetAllocatedSize();
+}
+
+void UWFCArcConsistencyConstraint::LogDebugInfo() const
+{
+	Super::LogDebugInfo();
+
+	UE_LOG(LogWFC, Verbose, TEXT("%s AllowedTiles allocated size: %.3fKB"),
 	       *GetClass()->GetName(), AllowedTiles.GetAllocatedSize() / 1024.f);
-	UE_LOG(LogWFC, Verbose, TEXT("%s SupportCounts allocated size: %.3fKB"),
-	       *GetClass()->GetName(), SupportCounts.GetAllocatedSize() / 1024.f);
+	UE_LOG(LogWFC, Verbose, TEXT("%s Adjacency allocated size: %.3fKB (shared by %d)"),
+	       *GetClass()->GetName(), Adjacency.IsValid() ? Adjacency->GetAllocatedSize() / 1024.f : 0.f,
+	       Adjacency.IsValid() ? Adjacency.GetSharedReferenceCount() : 0);
+	UE_LOG(LogWFC, Verbose, TEXT("%s SupportCounts allocated size: %.3fKB (%d pages)"),
+	       *GetClass()->GetName(), GetSupportCountsAllocatedSize() / 1024.f, SupportCountPages.Num());
+	UE_LOG(LogWFC, Verbose, TEXT("%s DefaultSupportCounts allocated size: %.3fKB"),
+	       *GetClass()->GetName(), DefaultSupportCounts.GetAllocatedSize() / 1024.f);
+	UE_LOG(LogWFC, Verbose, TEXT("%s SupportCounts written rows: %d of %d"),
+	       *GetClass()->GetName(), NumSupportCountRows, SupportCountRowIndices.Num());
+	UE_LOG(LogWFC, Verbose, TEXT("%s AllowedTileMasks allocated size: %.3fKB"),
+	       *GetClass()->GetName(), AllowedTileMasks.GetAllocatedSize() / 1024.f);
+	UE_LOG(LogWFC, Verbose, TEXT("%s Residues allocated size: %.3fKB"),
+	       *GetClass()->GetName(), Residues.GetAllocatedSize() / 1024.f);
+	UE_LOG(LogWFC, Verbose, TEXT("%s total propagation allocated size: %.3fKB"),
+	       *GetClass()->GetName(), GetPropagationAllocatedSize() / 1024.f);
 
+	if (Residues.IsEmpty() && PropagationMode == EWFCArcPropagationMode::Residues && Grid && Model)
+	{
+		// residues aren't allocated until the first update, so report how much they will need
+		int32 HashShift = 0;
+		const int64 NumResidues = CalculateResiduesSize(HashShift);
+		UE_LOG(LogWFC, Verbose, TEXT("%s Residues required size: %.3fKB (%lld residues%s)"),
+		       *GetClass()->GetName(), NumResidues * sizeof(uint16) / 1024.f, NumResidues,
+		       HashShift != 0 ? TEXT(", shared by cells to fit the memory budget") : TEXT(""));
+	}
+
+	if (SupportCountSize == 0 && PropagationMode == EWFCArcPropagationMode::SupportCounts && Grid && Model)
+	{
+		// support counts aren't allocated until the first update, so report how much they will need,
+		// which is the row indices up front, and at most every row if they are all written
+		const int32 CounterSize = CalculateSupportCountSize();
+		const int64 NumRows = static_cast<int64>(Grid->GetNumCells()) * NumDirections;
+		const int64 NumCounters = NumRows * NumTiles;
+		UE_LOG(LogWFC, Verbose, TEXT("%s SupportCounts required size: %.3fKB, up to %.3fKB if every row is written (%lld counters, %d bytes each)"),
+		       *GetClass()->GetName(), NumRows * sizeof(int32) / 1024.f, NumCounters * CounterSize / 1024.f, NumCounters, CounterSize);
+	}
 
 	if (!Model)
 	{
@@ -276,7 +1415,6 @@ void UWFCArcConsistencyConstraint::LogDebugInfo() const
 		const FString TileStr = Model->GetTileDebugString(TileId);
 		UE_LOG(LogWFC, VeryVerbose, TEXT("%s allowed tiles:"), *TileStr);
 
-		const auto& AllowedDirections = AllowedTiles[TileId];
 		for (FWFCGridDirection Direction = 0; Direction < Grid->GetNumDirections(); ++Direction)
 		{
 			// log the opposite direction, since allowed tiles are stored as an 'incoming' direction
@@ -285,7 +1423,7 @@ void UWFCArcConsistencyConstraint::LogDebugInfo() const
 			const FString DirectionStr = Grid->GetDirectionName(InvDirection);
 
 			TArray<FString> TileStrs;
-			const auto& ThisAllowedTiles = AllowedDirections[Direction];
+			const TArrayView<const FWFCTileId> ThisAllowedTiles = GetAllowedTileIds(TileId, Direction);
 			for (const int32& AllowedTileId : ThisAllowedTiles)
 			{
 				TileStrs.Add(FString::FromInt(AllowedTileId));
@@ -4,6 +4,7 @@
 #include "Core/Constraints/WFCBoundaryConstraint.h"
 
 #include "WFCModule.h"
+#include "Core/WFCCompiledModel.h"
 #include "Core/WFCGenerator.h"
 #include "Core/WFCGrid.h"
 #include "Core/WFCModel.h"
@@ -32,6 +33,14 @@ void UWFCBoundaryConstraint::Initialize(UWFCGenerator* InGenerator)
 	}
 
 	bDidApplyInitialConstraint = false;
+	BoundaryMaskTilesToBan.Reset();
+	TileProhibitedDirections.Init(0, Model->GetNumTiles());
+
+	if (InitializeFromCompiledModel())
+	{
+		bIsInitialized = true;
+		return;
+	}
 
 	const int32 NumDirections = Grid->GetNumDirections();
 
@@ -62,10 +71,37 @@ void UWFCBoundaryConstraint::Reset()
 	SET_DWORD_STAT(STAT_WFCBoundaryConstraintNumBans, 0);
 }
 
+bool UWFCBoundaryConstraint::InitializeFromCompiledModel()
+{
+	const UWFCCompiledModel* CompiledModel = Generator->GetCompiledModel();
+	if (!CompiledModel || CompiledModel->BoundaryProhibitedDirections.Num() != Model->GetNumTiles() ||
+		!CompiledModel->IsValidForConstraint(this, CompiledModel->BoundaryConstraintClass, CompiledModel->BoundaryConstraintHash))
+	{
+		return false;
+	}
+
+	TileProhibitedDirections = CompiledModel->BoundaryProhibitedDirections;
+	for (const uint32 DirectionMask : TileProhibitedDirections)
+	{
+		INC_DWORD_STAT_BY(STAT_WFCBoundaryConstraintMappings, FMath::CountBits(DirectionMask));
+	}
+	return true;
+}
+
 void UWFCBoundaryConstraint::AddProhibitedAdjacentBoundaryMapping(FWFCTileId TileId, FWFCGridDirection Direction)
 {
-	INC_DWORD_STAT(STAT_WFCBoundaryConstraintMappings);
-	TileBoundaryProhibitionMap.FindOrAdd(TileId).AddUnique(Direction);
+	if (!TileProhibitedDirections.IsValidIndex(TileId))
+	{
+		TileProhibitedDirections.SetNumZeroed(TileId + 1);
+	}
+
+	const uint32 DirectionBit = 1u << Direction;
+	if (!(TileProhibitedDirections[TileId] & DirectionBit))
+	{
+		INC_DWORD_STAT(STAT_WFCBoundaryConstraintMappings);
+		TileProhibitedDirections[TileId] |= DirectionBit;
+		BoundaryMaskTilesToBan.Reset();
+	}
 }
 
 bool UWFCBoundaryConstraint::CanTileBeNextToBoundary(const FWFCModelAssetTile& Tile, FWFCGridDirection Direction) const
@@ -96,17 +132,25 @@ bool UWFCBoundaryConstraint::CanTileBeNextToBoundary(const FWFCModelAssetTile& T
 	return true;
 }
 
-bool UWFCBoundaryConstraint::IsTileBoundaryDirectionProhibited(FWFCTileId TileId, const TArray<FWFCGridDirection>& BoundaryDirections) const
+const TArray<FWFCTileId>& UWFCBoundaryConstraint::GetTilesToBanForBoundaryMask(uint32 BoundaryMask)
 {
-	const TArray<FWFCGridDirection>* ProhibitedDirectionsPtr = TileBoundaryProhibitionMap.Find(TileId);
-	if (ProhibitedDirectionsPtr)
+	if (const TArray<FWFCTileId>* TileIdsToBan = BoundaryMaskTilesToBan.Find(BoundaryMask))
+	{
+		return *TileIdsToBan;
+	}
+
+	TArray<FWFCTileId>& TileIdsToBan = BoundaryMaskTilesToBan.Add(BoundaryMask);
+	for (FWFCTileId TileId = 0; TileId < TileProhibitedDirections.Num(); ++TileId)
 	{
-		return ProhibitedDirectionsPtr->ContainsByPredicate([BoundaryDirections](const FWFCGridDirection& Direction)
+		// check each tile for any prohibited boundary directions
+		INC_DWORD_STAT(STAT_WFCBoundaryConstraintNumChecks);
+
+		if (IsTileBoundaryDirectionProhibited(TileId, BoundaryMask))
 		{
-			return BoundaryDirections.Contains(Direction);
-		});
+			TileIdsToBan.Add(TileId);
+		}
 	}
-	return false;
+	return TileIdsToBan;
 }
 
 bool UWFCBoundaryConstraint::Next()
@@ -124,75 +168,33 @@ bool UWFCBoundaryConstraint::Next()
 
 	bool bDidMakeChanges = false;
 
-	// iterate all cells and ban tiles that can't be next to boundaries
-
-	const int32 NumDirections = Grid->GetNumDirections();
-
-	// if tiles to ban is already filled out, don't recalculate it, since it
-	// will be the same each time this constraint is first run.
-	if (TilesToBan.IsEmpty())
+	// ban tiles that can't be next to boundaries from every boundary cell, interior cells are never affected
+	const TArray<FWFCCellIndex>& BoundaryCells = Grid->GetBoundaryCells();
+	const TArray<uint32>& BoundaryCellMasks = Grid->GetBoundaryCellMasks();
+	for (int32 Idx = 0; Idx < BoundaryCells.Num(); ++Idx)
 	{
-		for (FWFCCellIndex CellIndex = 0; CellIndex < Generator->GetNumCells(); ++CellIndex)
+		const FWFCCellIndex CellIndex = BoundaryCells[Idx];
+		if (Generator->GetCell(CellIndex).HasSelection())
 		{
-			const FWFCCell& CellToCheck = Generator->GetCell(CellIndex);
-			if (CellToCheck.HasSelection())
-			{
-				// don't change cells that are already selected
-				continue;
-			}
-
-			// find all boundary directions
-			TArray<FWFCGridDirection> BoundaryDirections;
-			for (FWFCGridDirection Direction = 0; Direction < NumDirections; ++Direction)
-			{
-				const FWFCCellIndex AdjacentCellIndex = Grid->GetCellIndexInDirection(CellIndex, Direction);
-				if (!Grid->IsValidCellIndex(AdjacentCellIndex))
-				{
-					BoundaryDirections.AddUnique(Direction);
-				}
-			}
-
-			if (BoundaryDirections.IsEmpty())
-			{
-				// cell is not next to a boundary
-				continue;
-			}
-
-			TArray<FWFCTileId> TileIdsToBan;
-			for (const FWFCTileId& TileId : CellToCheck.TileCandidates)
-			{
-				// check each tile for any prohibited boundary directions
-				INC_DWORD_STAT(STAT_WFCBoundaryConstraintNumChecks);
-
-				if (IsTileBoundaryDirectionProhibited(TileId, BoundaryDirections))
-				{
-					TileIdsToBan.Add(TileId);
-				}
-			}
+			// don't change cells that are already selected
+			continue;
+		}
 
-			if (TileIdsToBan.Num() > 0)
-			{
-				TilesToBan.Add(CellIndex, TileIdsToBan);
-			}
+		const TArray<FWFCTileId>& TileIdsToBan = GetTilesToBanForBoundaryMask(BoundaryCellMasks[Idx]);
+		if (TileIdsToBan.IsEmpty())
+		{
+			continue;
 		}
-	}
 
-	// apply bans
-	if (!TilesToBan.IsEmpty())
-	{
-		for (const auto& Elem : TilesToBan)
+		INC_DWORD_STAT_BY(STAT_WFCBoundaryConstraintNumBans, TileIdsToBan.Num());
+		if (Generator->BanMultiple(CellIndex, TileIdsToBan))
 		{
-			INC_DWORD_STAT_BY(STAT_WFCBoundaryConstraintNumBans, Elem.Value.Num());
-			if (Generator->BanMultiple(Elem.Key, Elem.Value))
-			{
-				// contradiction
-				return true;
-			}
+			// contradiction
+			return true;
 		}
 		bDidMakeChanges = true;
 	}
 
-
 	bDidApplyInitialConstraint = true;
 
 	INC_FLOAT_STAT_BY(STAT_WFCBoundaryConstraintTime, (FPlatformTime::Seconds() - StartTime) * 1000);
@@ -211,3 +213,17 @@ void UWFCBoundaryConstraint::ApplySnapshot(const UWFCConstraintSnapshot* Snapsho
 	const UWFCBoundaryConstraintSnapshot* BoundarySnapshot = Cast<UWFCBoundaryConstraintSnapshot>(Snapshot);
 	bDidApplyInitialConstraint = BoundarySnapshot->bDidApplyInitialConstraint;
 }
+
+void UWFCBoundaryConstraint::CompileModel(UWFCCompiledModel* CompiledModel) const
+{
+	if (CompiledModel->BoundaryConstraintClass)
+	{
+		// only the first boundary constraint is compiled
+		return;
+	}
+
+	CompiledModel->BoundaryConstraintClass = GetClass();
+	CompiledModel->BoundaryConstraintHash = CalculateCompiledRulesHash();
+	CompiledModel->BoundaryProhibitedDirections = TileProhibitedDirections;
+	CompiledModel->BoundaryProhibitedDirections.SetNumZeroed(Model->GetNumTiles());
+}
@@ -16,10 +16,21 @@ DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Count Constraint - Bans"), STAT_WFCCountCon
 // UWFCCountConstraint
 // -------------------
 
+UWFCCountConstraint::UWFCCountConstraint()
+	: bTrackGroupCells(true),
+	  bIsOccupancyValid(false)
+{
+}
+
 void UWFCCountConstraint::Initialize(UWFCGenerator* InGenerator)
 {
 	Super::Initialize(InGenerator);
 
+	// groups are added by subclasses once the model is available
+	TileGroupMaxCounts.Reset();
+	TileIdsToGroups.Init(INDEX_NONE, Model->GetNumTiles());
+	bIsOccupancyValid = false;
+
 	SET_DWORD_STAT(STAT_WFCCountConstraintMappings, 0);
 	SET_FLOAT_STAT(STAT_WFCCountConstraintTime, 0);
 	SET_DWORD_STAT(STAT_WFCCountConstraintNumBans, 0);
@@ -32,7 +43,10 @@ void UWFCCountConstraint::Reset()
 	TileGroupCurrentCounts.Reset(TileGroupMaxCounts.Num());
 	TileGroupCurrentCounts.SetNum(TileGroupMaxCounts.Num());
 	TileGroupsToBan.Reset();
-	BannedGroups.Reset();
+	BannedGroups.Init(false, TileGroupMaxCounts.Num());
+	ForcedGroups.Init(false, TileGroupMaxCounts.Num());
+	bIsOccupancyValid = false;
+	BacktrackPoints.Reset();
 
 	SET_FLOAT_STAT(STAT_WFCCountConstraintTime, 0);
 	SET_DWORD_STAT(STAT_WFCCountConstraintNumBans, 0);
@@ -47,18 +61,43 @@ void UWFCCountConstraint::AddTileGroupMaxCountMapping(const TArray<FWFCTileId>&
 		return;
 	}
 
-	// add tile group and max count
-	const int32 GroupId = TileGroupMaxCounts.Add(FWFCCountConstraintTileGroup(TileIds, MaxCount));
+	AddTileGroupCountMapping(TileIds, 0, MaxCount);
+}
+
+void UWFCCountConstraint::AddTileGroupCountMapping(const TArray<FWFCTileId>& TileIds, int32 MinCount, int32 MaxCount)
+{
+	if (MinCount <= 0 && MaxCount <= 0)
+	{
+		UE_LOG(LogWFC, Warning, TEXT("MinCount or MaxCount must be > 0 for a count constraint: %s"),
+		       *GetNameSafe(GetOuter()));
+		return;
+	}
+
+	if (MaxCount > 0 && MinCount > MaxCount)
+	{
+		UE_LOG(LogWFC, Warning, TEXT("MinCount %d is greater than MaxCount %d for a count constraint: %s"),
+		       MinCount, MaxCount, *GetNameSafe(GetOuter()));
+		return;
+	}
+
+	// add tile group and counts
+	const int32 GroupId = TileGroupMaxCounts.Add(FWFCCountConstraintTileGroup(TileIds, MinCount, MaxCount, Model->GetNumTiles()));
 	TileGroupCurrentCounts.SetNum(TileGroupMaxCounts.Num());
+	BannedGroups.SetNum(TileGroupMaxCounts.Num(), false);
+	ForcedGroups.SetNum(TileGroupMaxCounts.Num(), false);
+	bIsOccupancyValid = false;
 
 	// cache tile id -> group id mappings
 	for (const FWFCTileId& TileId : TileIds)
 	{
-		TileIdsToGroups.Add(TileId, GroupId);
+		if (TileIdsToGroups.IsValidIndex(TileId))
+		{
+			TileIdsToGroups[TileId] = GroupId;
+		}
 	}
 
-	UE_LOG(LogWFC, VeryVerbose, TEXT("UWFCCountConstraint: Setting Max Count of %d for %d tile(s)"),
-	       MaxCount, TileIds.Num());
+	UE_LOG(LogWFC, VeryVerbose, TEXT("UWFCCountConstraint: Setting Min Count of %d and Max Count of %d for %d tile(s)"),
+	       MinCount, MaxCount, TileIds.Num());
 
 	SET_DWORD_STAT(STAT_WFCCountConstraintMappings, TileGroupMaxCounts.Num());
 }
@@ -69,19 +108,178 @@ void UWFCCountConstraint::NotifyCellChanged(FWFCCellIndex CellIndex, bool bHasSe
 	{
 		const FWFCCell& Cell = Generator->GetCell(CellIndex);
 		const FWFCTileId TileId = Cell.GetSelectedTileId();
-		const int32 TileGroupIndex = TileIdsToGroups.Contains(TileId) ? TileIdsToGroups[TileId] : INDEX_NONE;
-		if (TileGroupIndex != INDEX_NONE && !BannedGroups.Contains(TileGroupIndex))
+		const int32 TileGroupIndex = TileIdsToGroups.IsValidIndex(TileId) ? TileIdsToGroups[TileId] : INDEX_NONE;
+		if (TileGroupIndex != INDEX_NONE && !IsGroupBanned(TileGroupIndex))
 		{
 			const FWFCCountConstraintTileGroup& TileGroup = TileGroupMaxCounts[TileGroupIndex];
 			TileGroupCurrentCounts[TileGroupIndex] += 1;
-			if (TileGroupCurrentCounts[TileGroupIndex] >= TileGroup.MaxCount)
+
+			// only queue the group once, when it first reaches the max count
+			if (TileGroup.MaxCount > 0 && TileGroupCurrentCounts[TileGroupIndex] == TileGroup.MaxCount)
 			{
 				UE_LOG(LogWFC, VeryVerbose, TEXT("Tile %d selection reached Max Count of %d for group %d, banning next update."),
 				       TileId, TileGroup.MaxCount, TileGroupIndex);
-				TileGroupsToBan.AddUnique(TileGroupIndex);
+				TileGroupsToBan.Add(TileGroupIndex);
+			}
+		}
+
+		// the generator finishes without another update once every cell is selected, so check min counts now
+		if (Generator->GetNumSelectedCells() == Generator->GetNumCells())
+		{
+			for (int32 TileGroupIndex = 0; TileGroupIndex < TileGroupMaxCounts.Num(); ++TileGroupIndex)
+			{
+				if (TileGroupCurrentCounts[TileGroupIndex] < TileGroupMaxCounts[TileGroupIndex].MinCount)
+				{
+					UE_LOG(LogWFC, Verbose, TEXT("Every cell is selected, but group %d only reached %d of its min count of %d"),
+					       TileGroupIndex, TileGroupCurrentCounts[TileGroupIndex], TileGroupMaxCounts[TileGroupIndex].MinCount);
+					Generator->NotifyContradiction();
+					break;
+				}
+			}
+		}
+	}
+}
+
+void UWFCCountConstraint::NotifyCellBan(FWFCCellIndex CellIndex, FWFCTileId BannedTileId)
+{
+	// propagation bans one tile at a time, which must update the occupancy the same way as a batch
+	NotifyCellBans(CellIndex, MakeArrayView(&BannedTileId, 1));
+}
+
+void UWFCCountConstraint::NotifyCellBans(FWFCCellIndex CellIndex, TArrayView<const FWFCTileId> BannedTileIds)
+{
+	if (!bIsOccupancyValid)
+	{
+		return;
+	}
+
+	// find the groups that lost a candidate, usually none or one
+	TArray<int32, TInlineAllocator<4>> AffectedGroups;
+	for (const FWFCTileId TileId : BannedTileIds)
+	{
+		const int32 TileGroupIndex = TileIdsToGroups.IsValidIndex(TileId) ? TileIdsToGroups[TileId] : INDEX_NONE;
+		if (TileGroupIndex != INDEX_NONE)
+		{
+			AffectedGroups.AddUnique(TileGroupIndex);
+		}
+	}
+
+	// the banned tiles were candidates, so the cell had the group until now
+	const FWFCCell& Cell = Generator->GetCell(CellIndex);
+	for (const int32 TileGroupIndex : AffectedGroups)
+	{
+		if (!Cell.HasAnyMatchingCandidate(TileGroupMaxCounts[TileGroupIndex].TileSet))
+		{
+			--TileGroupCandidateCellCounts[TileGroupIndex];
+		}
+	}
+}
+
+void UWFCCountConstraint::UpdateOccupancy()
+{
+	const int32 NumGroups = TileGroupMaxCounts.Num();
+	TileGroupCandidateCellCounts.Init(0, NumGroups);
+	TileGroupCells.SetNum(bTrackGroupCells ? NumGroups : 0);
+	for (TArray<FWFCCellIndex>& GroupCells : TileGroupCells)
+	{
+		GroupCells.Reset();
+	}
+
+	for (FWFCCellIndex CellIndex = 0; CellIndex < Generator->GetNumCells(); ++CellIndex)
+	{
+		const FWFCCell& Cell = Generator->GetCell(CellIndex);
+		for (int32 TileGroupIndex = 0; TileGroupIndex < NumGroups; ++TileGroupIndex)
+		{
+			if (Cell.HasAnyMatchingCandidate(TileGroupMaxCounts[TileGroupIndex].TileSet))
+			{
+				++TileGroupCandidateCellCounts[TileGroupIndex];
+				if (bTrackGroupCells)
+				{
+					TileGroupCells[TileGroupIndex].Add(CellIndex);
+				}
 			}
 		}
 	}
+
+	bIsOccupancyValid = true;
+}
+
+template <typename FuncType>
+bool UWFCCountConstraint::ForEachGroupCell(int32 TileGroupIndex, FuncType Func) const
+{
+	// cells never gain candidates, so the cells gathered by UpdateOccupancy are a superset of the current ones
+	if (bTrackGroupCells)
+	{
+		for (const FWFCCellIndex CellIndex : TileGroupCells[TileGroupIndex])
+		{
+			if (Func(CellIndex))
+			{
+				return true;
+			}
+		}
+	}
+	else
+	{
+		for (FWFCCellIndex CellIndex = 0; CellIndex < Generator->GetNumCells(); ++CellIndex)
+		{
+			if (Func(CellIndex))
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool UWFCCountConstraint::BanTileGroup(int32 TileGroupIndex)
+{
+	const FWFCCountConstraintTileGroup& TileGroup = TileGroupMaxCounts[TileGroupIndex];
+	BannedGroups[TileGroupIndex] = true;
+
+	UE_LOG(LogWFC, Verbose, TEXT("Banning %d tile ids(s) after reaching max count"), TileGroup.TileIds.Num());
+
+	// remove from all unselected cells that still have them
+	return ForEachGroupCell(TileGroupIndex, [this, &TileGroup](FWFCCellIndex CellIndex)
+	{
+		const FWFCCell& Cell = Generator->GetCell(CellIndex);
+		if (Cell.HasSelection() || !Cell.HasAnyMatchingCandidate(TileGroup.TileSet))
+		{
+			return false;
+		}
+
+		INC_DWORD_STAT_BY(STAT_WFCCountConstraintNumBans, TileGroup.TileIds.Num());
+		return Generator->BanMultiple(CellIndex, TileGroup.TileIds);
+	});
+}
+
+bool UWFCCountConstraint::ForceTileGroup(int32 TileGroupIndex)
+{
+	const FWFCCountConstraintTileGroup& TileGroup = TileGroupMaxCounts[TileGroupIndex];
+	ForcedGroups[TileGroupIndex] = true;
+
+	UE_LOG(LogWFC, Verbose, TEXT("Forcing the last %d cell(s) to use group %d to reach min count of %d"),
+	       TileGroup.MinCount - TileGroupCurrentCounts[TileGroupIndex], TileGroupIndex, TileGroup.MinCount);
+
+	// ban everything else from the unselected cells that can still have the group
+	return ForEachGroupCell(TileGroupIndex, [this, &TileGroup](FWFCCellIndex CellIndex)
+	{
+		const FWFCCell& Cell = Generator->GetCell(CellIndex);
+		if (Cell.HasSelection() || !Cell.HasAnyMatchingCandidate(TileGroup.TileSet))
+		{
+			return false;
+		}
+
+		FWFCTileBitset OtherTiles = Cell.TileCandidates;
+		OtherTiles.Subtract(TileGroup.TileSet);
+		if (OtherTiles.IsEmpty())
+		{
+			return false;
+		}
+
+		const TArray<FWFCTileId> OtherTileIds = OtherTiles.ToArray();
+		INC_DWORD_STAT_BY(STAT_WFCCountConstraintNumBans, OtherTileIds.Num());
+		return Generator->BanMultiple(CellIndex, OtherTileIds);
+	});
 }
 
 bool UWFCCountConstraint::Next()
@@ -90,67 +288,166 @@ bool UWFCCountConstraint::Next()
 	SET_FLOAT_STAT(STAT_WFCCountConstraintTime, 0);
 	SET_DWORD_STAT(STAT_WFCCountConstraintNumBans, 0);
 
+	if (TileGroupMaxCounts.IsEmpty())
+	{
+		return false;
+	}
+
+	if (!bIsOccupancyValid)
+	{
+		UpdateOccupancy();
+	}
+
 	bool bDidMakeChanges = false;
 
-	if (TileGroupsToBan.Num() > 0)
+	// banning may select cells and queue more groups, which are handled next update
+	const TArray<int32> GroupsToBan = MoveTemp(TileGroupsToBan);
+	TileGroupsToBan.Reset();
+	for (const int32 TileGroupIndex : GroupsToBan)
 	{
-		// accumulate all tile ids from all groups to ban
-		TArray<FWFCTileId> TileIdsToBan;
-		for (const int32 TileGroupIndex : TileGroupsToBan)
+		bDidMakeChanges = true;
+		if (BanTileGroup(TileGroupIndex))
 		{
-			TileIdsToBan.Append(TileGroupMaxCounts[TileGroupIndex].TileIds);
-			BannedGroups.AddUnique(TileGroupIndex);
+			// contradiction
+			return true;
 		}
+	}
 
-		UE_LOG(LogWFC, Verbose, TEXT("Banning %d tile ids(s) after reaching max count"), TileIdsToBan.Num());
+	for (int32 TileGroupIndex = 0; TileGroupIndex < TileGroupMaxCounts.Num(); ++TileGroupIndex)
+	{
+		const FWFCCountConstraintTileGroup& TileGroup = TileGroupMaxCounts[TileGroupIndex];
+		if (ForcedGroups[TileGroupIndex] || TileGroupCurrentCounts[TileGroupIndex] >= TileGroup.MinCount)
+		{
+			continue;
+		}
 
-		// remove from all unselected cells
-		for (FWFCCellIndex CellIndex = 0; CellIndex < Generator->GetNumCells(); ++CellIndex)
+		const int32 NumCandidateCells = TileGroupCandidateCellCounts[TileGroupIndex];
+		if (NumCandidateCells < TileGroup.MinCount)
 		{
-			FWFCCell& Cell = Generator->GetCell(CellIndex);
-			if (!Cell.HasSelection())
-			{
-				INC_DWORD_STAT_BY(STAT_WFCCountConstraintNumBans, TileIdsToBan.Num());
-				if (Generator->BanMultiple(CellIndex, TileIdsToBan))
-				{
-					// contradiction
-					return true;
-				}
+			// the min count can't be reached anymore, which only happens if several cells lost the group at once
+			UE_LOG(LogWFC, Verbose, TEXT("Group %d can no longer reach min count of %d, only %d cell(s) can hold it"),
+			       TileGroupIndex, TileGroup.MinCount, NumCandidateCells);
+			Generator->NotifyContradiction();
+			return true;
+		}
 
-				bDidMakeChanges = true;
-			}
+		// every cell with the group either selected it already or is needed to reach the min count
+		if (NumCandidateCells > TileGroup.MinCount)
+		{
+			continue;
 		}
 
-		TileGroupsToBan.Reset();
+		bDidMakeChanges = true;
+		if (ForceTileGroup(TileGroupIndex))
+		{
+			// contradiction
+			return true;
+		}
 	}
 
 	INC_FLOAT_STAT_BY(STAT_WFCCountConstraintTime, (FPlatformTime::Seconds() - StartTime) * 1000);
 	return bDidMakeChanges;
 }
 
+void UWFCCountConstraint::SaveBacktrackPoint()
+{
+	FWFCCountConstraintBacktrackPoint& BacktrackPoint = BacktrackPoints.AddDefaulted_GetRef();
+	BacktrackPoint.TileGroupCurrentCounts = TileGroupCurrentCounts;
+	BacktrackPoint.TileGroupsToBan = TileGroupsToBan;
+	BacktrackPoint.BannedGroups = BannedGroups;
+	BacktrackPoint.TileGroupCandidateCellCounts = TileGroupCandidateCellCounts;
+	BacktrackPoint.ForcedGroups = ForcedGroups;
+	BacktrackPoint.bIsOccupancyValid = bIsOccupancyValid;
+}
+
+void UWFCCountConstraint::RestoreBacktrackPoint()
+{
+	if (BacktrackPoints.IsEmpty())
+	{
+		return;
+	}
+
+	FWFCCountConstraintBacktrackPoint BacktrackPoint = BacktrackPoints.Pop(EAllowShrinking::No);
+	TileGroupCurrentCounts = MoveTemp(BacktrackPoint.TileGroupCurrentCounts);
+	TileGroupsToBan = MoveTemp(BacktrackPoint.TileGroupsToBan);
+	BannedGroups = MoveTemp(BacktrackPoint.BannedGroups);
+	TileGroupCandidateCellCounts = MoveTemp(BacktrackPoint.TileGroupCandidateCellCounts);
+	ForcedGroups = MoveTemp(BacktrackPoint.ForcedGroups);
+	bIsOccupancyValid = BacktrackPoint.bIsOccupancyValid;
+}
+
+UWFCConstraintSnapshot* UWFCCountConstraint::CreateSnapshot(UObject* Outer) const
+{
+	UWFCCountConstraintSnapshot* Snapshot = NewObject<UWFCCountConstraintSnapshot>(Outer);
+	Snapshot->TileGroupCurrentCounts = TileGroupCurrentCounts;
+	Snapshot->TileGroupsToBan = TileGroupsToBan;
+	for (TConstSetBitIterator<> It(BannedGroups); It; ++It)
+	{
+		Snapshot->BannedGroups.Add(It.GetIndex());
+	}
+	return Snapshot;
+}
+
+void UWFCCountConstraint::ApplySnapshot(const UWFCConstraintSnapshot* Snapshot)
+{
+	const UWFCCountConstraintSnapshot* CountSnapshot = Cast<UWFCCountConstraintSnapshot>(Snapshot);
+	if (!CountSnapshot)
+	{
+		return;
+	}
+
+	TileGroupCurrentCounts = CountSnapshot->TileGroupCurrentCounts;
+	TileGroupsToBan = CountSnapshot->TileGroupsToBan;
+
+	// groups may not be added yet, they extend these when they are
+	BannedGroups.Init(false, TileGroupCurrentCounts.Num());
+	for (const int32 TileGroupIndex : CountSnapshot->BannedGroups)
+	{
+		if (BannedGroups.IsValidIndex(TileGroupIndex))
+		{
+			BannedGroups[TileGroupIndex] = true;
+		}
+	}
+
+	// forced groups and occupancy are recalculated from the cells during the next update
+	ForcedGroups.Init(false, TileGroupCurrentCounts.Num());
+	bIsOccupancyValid = false;
+	BacktrackPoints.Reset();
+}
+
 
 // UWFCTagCountConstraint
 // ----------------------
 
-int32 UWFCTagCountConstraint::GetTileMaxCount(const UWFCTileAsset* TileAsset) const
+const FWFCTileTagMaxCount* UWFCTagCountConstraint::GetTileCountRule(const UWFCTileAsset* TileAsset) const
 {
 	if (!TileAsset)
 	{
-		return 0;
+		return nullptr;
 	}
-	const FWFCTileTagMaxCount* MaxCountRule = MaxCounts.FindByPredicate([TileAsset](const FWFCTileTagMaxCount& MaxCountRule)
+	const FWFCTileTagMaxCount* CountRule = MaxCounts.FindByPredicate([TileAsset](const FWFCTileTagMaxCount& MaxCountRule)
 	{
 		return TileAsset->OwnedTags.HasTag(MaxCountRule.Tag);
 	});
 
-	if (MaxCountRule)
+	if (CountRule)
 	{
-		UE_LOG(LogWFC, VeryVerbose, TEXT("Tile '%s' matches tag '%s', using Max Count: '%d'"),
-		       *TileAsset->GetName(), *MaxCountRule->Tag.ToString(), MaxCountRule->MaxCount);
-
-		return MaxCountRule->MaxCount;
+		UE_LOG(LogWFC, VeryVerbose, TEXT("Tile '%s' matches tag '%s', using Min Count: '%d', Max Count: '%d'"),
+		       *TileAsset->GetName(), *CountRule->Tag.ToString(), CountRule->MinCount, CountRule->MaxCount);
 	}
-	return 0;
+	return CountRule;
+}
+
+int32 UWFCTagCountConstraint::GetTileMaxCount(const UWFCTileAsset* TileAsset) const
+{
+	const FWFCTileTagMaxCount* CountRule = GetTileCountRule(TileAsset);
+	return CountRule ? CountRule->MaxCount : 0;
+}
+
+int32 UWFCTagCountConstraint::GetTileMinCount(const UWFCTileAsset* TileAsset) const
+{
+	const FWFCTileTagMaxCount* CountRule = GetTileCountRule(TileAsset);
+	return CountRule ? CountRule->MinCount : 0;
 }
 
 void UWFCTagCountConstraint::Initialize(UWFCGenerator* InGenerator)
@@ -169,8 +466,9 @@ void UWFCTagCountConstraint::Initialize(UWFCGenerator* InGenerator)
 
 	for (const UWFCTileAsset* TileAsset : TileAssets)
 	{
+		const int32 TileMinCount = GetTileMinCount(TileAsset);
 		const int32 TileMaxCount = GetTileMaxCount(TileAsset);
-		if (TileMaxCount > 0)
+		if (TileMinCount > 0 || TileMaxCount > 0)
 		{
 			const TArray<FWFCTileId> IdArray = AssetModel->GetTileIdsForAsset(TileAsset);
 
@@ -185,10 +483,10 @@ void UWFCTagCountConstraint::Initialize(UWFCGenerator* InGenerator)
 
 			if (OriginTileIds.Num() > 0)
 			{
-				AddTileGroupMaxCountMapping(OriginTileIds, TileMaxCount);
+				AddTileGroupCountMapping(OriginTileIds, TileMinCount, TileMaxCount);
 			}
 		}
 	}
 
-	UE_LOG(LogWFC, Verbose, TEXT("UWFCTileAssetCountConstraintConfig configured %d max count mappings"), TileGroupMaxCounts.Num());
+	UE_LOG(LogWFC, Verbose, TEXT("UWFCTileAssetCountConstraintConfig configured %d count mappings"), TileGroupMaxCounts.Num());
 }
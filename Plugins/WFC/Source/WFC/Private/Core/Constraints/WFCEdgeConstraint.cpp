@@ -37,7 +37,10 @@ void UWFCEdgeConstraint::Initialize(UWFCGenerator* InGenerator)
 
 	if (!bIsInitializedFromTiles)
 	{
-		InitializeFromTiles();
+		if (!InitializeFromCompiledModel())
+		{
+			InitializeFromTiles();
+		}
 		bIsInitializedFromTiles = true;
 	}
 
@@ -85,193 +88,116 @@ bool UWFCEdgeConstraint::AreTilesCompatible(const FWFCModelAssetTile& TileA, con
 
 void UWFCEdgeConstraint::InitializeFromTiles()
 {
-	const int32 NumDirections = Grid->GetNumDirections();
-
-	// iterate over all distinct pairs of tiles, including reflectivity, comparing socket types for compatibility
-	for (FWFCTileId TileIdA = 0; TileIdA <= Model->GetMaxTileId(); ++TileIdA)
+	// intern the edge type of every tile's outgoing edge in each world direction,
+	// interior edges of large tiles are INDEX_NONE, since they only allow the exact neighbor tile.
+	TArray<FGameplayTag> EdgeTypes;
+	TMap<FGameplayTag, int32> EdgeTypeIds;
+	TArray<int32> TileEdgeTypeIds;
+	TileEdgeTypeIds.SetNumUninitialized(NumTiles * NumDirections);
+	for (FWFCTileId TileId = 0; TileId < NumTiles; ++TileId)
 	{
-		const FWFCModelAssetTile& TileA = Model->GetTileRef<FWFCModelAssetTile>(TileIdA);
+		const FWFCModelAssetTile& Tile = Model->GetTileRef<FWFCModelAssetTile>(TileId);
+		check(Tile.TileAsset.IsValid());
 
-		// compare A <-> A for each direction
 		for (FWFCGridDirection Direction = 0; Direction < NumDirections; ++Direction)
 		{
-			INC_DWORD_STAT(STAT_WFCEdgeConstraintMappingChecks);
+			int32& EdgeTypeId = TileEdgeTypeIds[TileId * NumDirections + Direction];
 
-			if (AreTilesCompatible(TileA, TileA, Direction))
+			// convert to local space for checking the tile's edge
+			const FWFCGridDirection LocalDirection = Grid->InverseRotateDirection(Direction, Tile.Rotation);
+			if (Tile.TileAsset->IsInteriorEdge(Tile.TileDefIndex, LocalDirection))
 			{
-				AddAllowedTileForDirection(TileIdA, Direction, TileIdA);
+				EdgeTypeId = INDEX_NONE;
+				const int32 NeighborDefIndex = Tile.TileAsset->GetTileDefInDirection(Tile.TileDefIndex, LocalDirection);
+				const FWFCTileId NeighborTileId = AssetModel->GetTileIdForAssetAndRotation(Tile.TileAsset.Get(), NeighborDefIndex, Tile.Rotation);
+				if (NeighborTileId != INDEX_NONE)
+				{
+					AddAllowedTileForDirection(TileId, Direction, NeighborTileId);
+				}
+				continue;
 			}
-		}
 
-		for (FWFCTileId TileIdB = TileIdA + 1; TileIdB <= Model->GetMaxTileId(); ++TileIdB)
-		{
-			const FWFCModelAssetTile& TileB = Model->GetTileRef<FWFCModelAssetTile>(TileIdB);
-
-			// compare A <-> B for each direction
-			for (FWFCGridDirection Direction = 0; Direction < NumDirections; ++Direction)
+			const FGameplayTag EdgeType = Tile.TileAsset->GetTileDefEdgeType(Tile.TileDefIndex, LocalDirection);
+			if (const int32* ExistingEdgeTypeId = EdgeTypeIds.Find(EdgeType))
 			{
-				INC_DWORD_STAT(STAT_WFCEdgeConstraintMappingChecks);
-
-				if (AreTilesCompatible(TileA, TileB, Direction))
-				{
-					AddAllowedTileForDirection(TileIdA, Direction, TileIdB);
-
-					// add opposite directly as well
-					const FWFCGridDirection OppositeDirection = Grid->GetOppositeDirection(Direction);
-					AddAllowedTileForDirection(TileIdB, OppositeDirection, TileIdA);
-				}
+				EdgeTypeId = *ExistingEdgeTypeId;
+			}
+			else
+			{
+				EdgeTypeId = EdgeTypes.Add(EdgeType);
+				EdgeTypeIds.Add(EdgeType, EdgeTypeId);
 			}
 		}
 	}
-}
 
-void UWFCEdgeConstraint::InitializeFromAssets()
-{
-	struct FTileAssetDefEdge
-	{
-		FTileAssetDefEdge(const UWFCTileAsset* InTileAsset, int32 InDefIdx, FWFCGridDirection InDirection, const TArray<FWFCTileId>& InIds)
-			: Asset(InTileAsset), Index(InDefIdx), Direction(InDirection), Ids(InIds)
-		{
-			bIsInterior = Asset->IsInteriorEdge(Index, Direction);
-			EdgeType = Asset->GetTileDefEdgeType(Index, Direction);
-		}
+	const int32 NumEdgeTypes = EdgeTypes.Num();
 
-		const UWFCTileAsset* Asset;
-		int32 Index;
-		FWFCGridDirection Direction;
-		// cached array of tile ids for this asset def
-		TArray<FWFCTileId> Ids;
-		bool bIsInterior;
-		FGameplayTag EdgeType;
-	};
-
-	const FWFCGridDirection NumDirections = Grid->GetNumDirections();
-	TArray<UWFCTileAsset*> TileAssets;
-	AssetModel->GetAllTileAssets(TileAssets);
-
-	// build flat list of tile asset defs so they can be iterated without checking duplicate pairs
-	TArray<FTileAssetDefEdge> TileEdges;
-	// will usually be larger than this but just starting with initial reserve
-	TileEdges.Reserve(TileAssets.Num() * NumDirections);
-	for (const UWFCTileAsset* TileAsset : TileAssets)
+	// check each pair of edge types once, instead of every pair of tiles
+	TArray<TArray<int32>> CompatibleEdgeTypeIds;
+	CompatibleEdgeTypeIds.SetNum(NumEdgeTypes);
+	for (int32 EdgeTypeIdA = 0; EdgeTypeIdA < NumEdgeTypes; ++EdgeTypeIdA)
 	{
-		if (!TileAsset)
-		{
-			continue;
-		}
-		for (int32 DefIdx = 0; DefIdx < TileAsset->GetNumTileDefs(); ++DefIdx)
+		for (int32 EdgeTypeIdB = EdgeTypeIdA; EdgeTypeIdB < NumEdgeTypes; ++EdgeTypeIdB)
 		{
-			TArray<int32> TileIds = AssetModel->GetTileIdsForAssetAndDef(TileAsset, DefIdx);
+			INC_DWORD_STAT(STAT_WFCEdgeConstraintMappingChecks);
 
-			for (FWFCGridDirection Direction = 0; Direction < NumDirections; ++Direction)
+			if (AreEdgesCompatible(EdgeTypes[EdgeTypeIdA], EdgeTypes[EdgeTypeIdB]))
 			{
-				TileEdges.Emplace(TileAsset, DefIdx, Direction, TileIds);
+				CompatibleEdgeTypeIds[EdgeTypeIdA].Add(EdgeTypeIdB);
+				if (EdgeTypeIdA != EdgeTypeIdB)
+				{
+					CompatibleEdgeTypeIds[EdgeTypeIdB].Add(EdgeTypeIdA);
+				}
 			}
 		}
 	}
 
-	// for each tile def edge...
-	for (int32 IdxA = 0; IdxA < TileEdges.Num(); ++IdxA)
+	// bucket tiles by the edge type facing each direction, by [Direction][EdgeTypeId]
+	TArray<FWFCTileBitset> EdgeBuckets;
+	EdgeBuckets.Init(FWFCTileBitset(NumTiles), NumDirections * NumEdgeTypes);
+	for (FWFCTileId TileId = 0; TileId < NumTiles; ++TileId)
 	{
-		const FTileAssetDefEdge& TileEdgeA = TileEdges[IdxA];
-
-		if (TileEdgeA.bIsInterior)
+		for (FWFCGridDirection Direction = 0; Direction < NumDirections; ++Direction)
 		{
-			// interior edge of a large tile, add the exact neighbors
-			AddInteriorAllowedTiles(TileEdgeA.Asset, TileEdgeA.Index, TileEdgeA.Direction, TileEdgeA.Ids);
-			continue;
+			const int32 EdgeTypeId = TileEdgeTypeIds[TileId * NumDirections + Direction];
+			if (EdgeTypeId != INDEX_NONE)
+			{
+				EdgeBuckets[Direction * NumEdgeTypes + EdgeTypeId].Add(TileId);
+			}
 		}
+	}
 
-		// TODO (bsayre): put this logic in the grid somewhere?
-		// don't attempt to try to match up XY and Z directions, since only yaw rotation is supported
-		const bool bIsLateralDirection = TileEdgeA.Direction < 4;
-
-		// for each other tile def edge...
-		for (int32 IdxB = IdxA; IdxB < TileEdges.Num(); ++IdxB)
+	// every tile in a bucket allows the same tiles, which are those with a compatible edge facing back towards it
+	FWFCTileBitset AllowedTileSet(NumTiles);
+	TArray<FWFCTileId> AllowedTileIds;
+	for (FWFCGridDirection Direction = 0; Direction < NumDirections; ++Direction)
+	{
+		const FWFCGridDirection OppositeDirection = Grid->GetOppositeDirection(Direction);
+		for (int32 EdgeTypeId = 0; EdgeTypeId < NumEdgeTypes; ++EdgeTypeId)
 		{
-			const FTileAssetDefEdge& TileEdgeB = TileEdges[IdxB];
-
-			// don't compare vertical and lateral directions, since only yaw rotation is supported
-			if (bIsLateralDirection && TileEdgeB.Direction >= 4 ||
-				!bIsLateralDirection && TileEdgeB.Direction < 4)
+			const FWFCTileBitset& Bucket = EdgeBuckets[Direction * NumEdgeTypes + EdgeTypeId];
+			if (Bucket.IsEmpty())
 			{
-				// either use 0..3 for lateral directions, or 4..5 for vertical
 				continue;
 			}
 
-			// TODO: early out if the tile can never be rotated such that this direction would line up with A
-
-			if (TileEdgeB.bIsInterior)
+			AllowedTileSet.Reset();
+			for (const int32 CompatibleEdgeTypeId : CompatibleEdgeTypeIds[EdgeTypeId])
 			{
-				continue;
+				AllowedTileSet.UnionWith(EdgeBuckets[OppositeDirection * NumEdgeTypes + CompatibleEdgeTypeId]);
 			}
-
-			INC_DWORD_STAT(STAT_WFCEdgeConstraintMappingChecks);
-			if (!AreEdgesCompatible(TileEdgeA.EdgeType, TileEdgeB.EdgeType))
+			if (AllowedTileSet.IsEmpty())
 			{
 				continue;
 			}
 
-			// edges match, add A<-B and B<-A for all rotation variations with the same local directions
-			AddMatchingEdgeAllowedTiles(TileEdgeA.Ids, TileEdgeA.Direction, TileEdgeB.Ids, TileEdgeB.Direction);
-		}
-	}
-}
-
-void UWFCEdgeConstraint::AddInteriorAllowedTiles(const UWFCTileAsset* TileAsset, int32 TileDefIndex,
-                                                 FWFCGridDirection Direction, const TArray<FWFCTileId>& TileDefIds)
-{
-	check(TileAsset != nullptr);
-	check(AssetModel != nullptr);
-
-	const int32 NeighborDefIdxA = TileAsset->GetTileDefInDirection(TileDefIndex, Direction);
-	// the direction was interior, so the neighbor must be valid
-	check(NeighborDefIdxA != INDEX_NONE);
-
-	TArray<FWFCTileId> NeighborTileIds = AssetModel->GetTileIdsForAssetAndDef(TileAsset, NeighborDefIdxA);
-
-	for (const FWFCTileId& TileIdA : TileDefIds)
-	{
-		const FWFCModelAssetTile& AssetTileA = Model->GetTileRef<FWFCModelAssetTile>(TileIdA);
-		const FWFCGridDirection WorldOutDirectionA = Grid->RotateDirection(Direction, AssetTileA.Rotation);
-		const FWFCGridDirection WorldOutDirectionB = Grid->GetOppositeDirection(WorldOutDirectionA);
-
-		// for each rotation of neighbor tile def a...
-		for (const FWFCTileId& TileIdB : NeighborTileIds)
-		{
-			const FWFCModelAssetTile& AssetTileB = Model->GetTileRef<FWFCModelAssetTile>(TileIdB);
-			if (AssetTileA.Rotation == AssetTileB.Rotation)
+			AllowedTileSet.ToArray(AllowedTileIds);
+			for (const FWFCTileId TileId : Bucket)
 			{
-				// add both A<-B and B<-A
-				AddAllowedTileForDirection(TileIdA, WorldOutDirectionA, TileIdB);
-				AddAllowedTileForDirection(TileIdB, WorldOutDirectionB, TileIdA);
+				SetAllowedTilesForDirection(TileId, Direction, AllowedTileIds);
 			}
 		}
 	}
-}
-
-void UWFCEdgeConstraint::AddMatchingEdgeAllowedTiles(const TArray<FWFCTileId>& TileAIds, FWFCGridDirection OutDirectionA,
-                                                     const TArray<FWFCTileId>& TileBIds, FWFCGridDirection OutDirectionB)
-{
-	for (const FWFCTileId TileIdA : TileAIds)
-	{
-		const FWFCModelAssetTile& AssetTileA = Model->GetTileRef<FWFCModelAssetTile>(TileIdA);
-		const FWFCGridDirection WorldDirectionA = Grid->RotateDirection(OutDirectionA, AssetTileA.Rotation);
-		const FWFCGridDirection InvWorldDirectionA = Grid->GetOppositeDirection(WorldDirectionA);
 
-		for (const FWFCTileId TileIdB : TileBIds)
-		{
-			const FWFCModelAssetTile& AssetTileB = Model->GetTileRef<FWFCModelAssetTile>(TileIdB);
-			const FWFCGridDirection WorldDirectionB = Grid->RotateDirection(OutDirectionB, AssetTileB.Rotation);
-			if (InvWorldDirectionA != WorldDirectionB)
-			{
-				// mismatching world directions
-				continue;
-			}
-
-			// add both A<-B and B<-A
-			AddAllowedTileForDirection(TileIdA, WorldDirectionA, TileIdB);
-			AddAllowedTileForDirection(TileIdB, WorldDirectionB, TileIdA);
-		}
-	}
+	UE_LOG(LogWFC, Verbose, TEXT("%s matched %d tiles using %d edge types"), *GetClass()->GetName(), NumTiles, NumEdgeTypes);
 }
@@ -133,11 +133,11 @@ int32 UWFCGrid3D::GetCellIndexForLocation(FIntVector GridLocation) const
 
 FIntVector UWFCGrid3D::GetLocationForCellIndex(int32 CellIndex) const
 {
-	// TODO: simplify
 	const int32 DimXY = Dimensions.X * Dimensions.Y;
-	const int32 Z = FMath::FloorToInt(static_cast<float>(CellIndex) / static_cast<float>(DimXY));
-	const int32 Y = FMath::FloorToInt(static_cast<float>(CellIndex - Z * DimXY) / static_cast<float>(Dimensions.X));
-	const int32 X = CellIndex % Dimensions.X;
+	const int32 Z = CellIndex / DimXY;
+	const int32 IndexInLayer = CellIndex - Z * DimXY;
+	const int32 Y = IndexInLayer / Dimensions.X;
+	const int32 X = IndexInLayer - Y * Dimensions.X;
 	return FIntVector(X, Y, Z);
 }
 
@@ -18,6 +18,26 @@ void UWFCCellSelector::Reset()
 {
 }
 
+void UWFCCellSelector::NotifyCellBan(FWFCCellIndex CellIndex, FWFCTileId BannedTileId)
+{
+}
+
+void UWFCCellSelector::NotifyCellBans(FWFCCellIndex CellIndex, TArrayView<const FWFCTileId> BannedTileIds)
+{
+	for (const FWFCTileId BannedTileId : BannedTileIds)
+	{
+		NotifyCellBan(CellIndex, BannedTileId);
+	}
+}
+
+void UWFCCellSelector::NotifyCellCandidateRestored(FWFCCellIndex CellIndex, FWFCTileId TileId)
+{
+}
+
+void UWFCCellSelector::NotifyCellChanged(FWFCCellIndex CellIndex, bool bHasSelection)
+{
+}
+
 FWFCCellIndex UWFCCellSelector::SelectNextCell()
 {
 	return INDEX_NONE;
@@ -29,19 +49,10 @@ FWFCCellIndex UWFCCellSelector::SelectNextCell()
 
 FWFCCellIndex UWFCRandomCellSelector::SelectNextCell()
 {
-	TArray<FWFCCellIndex> OpenCells;
-	for (FWFCCellIndex CellIndex = 0; CellIndex < Generator->GetNumCells(); ++CellIndex)
-	{
-		if (Generator->GetCell(CellIndex).HasSelectionOrNoCandidates())
-		{
-			continue;
-		}
-		OpenCells.Add(CellIndex);
-	}
-
+	const TArray<FWFCCellIndex>& OpenCells = Generator->GetOpenCells();
 	if (!OpenCells.IsEmpty())
 	{
-		return OpenCells[FMath::RandHelper(OpenCells.Num())];
+		return OpenCells[Generator->GetRandomStream().RandHelper(OpenCells.Num())];
 	}
 	return INDEX_NONE;
 }
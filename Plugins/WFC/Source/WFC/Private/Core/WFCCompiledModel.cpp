@@ -0,0 +1,113 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+
+#include "Core/WFCCompiledModel.h"
+
+#include "WFCCustomVersion.h"
+#include "WFCModule.h"
+#include "Core/WFCConstraint.h"
+#include "Core/WFCGenerator.h"
+#include "Core/WFCGrid.h"
+#include "Core/WFCModel.h"
+#include "Core/Constraints/WFCArcConsistencyConstraint.h"
+#include "Hash/xxhash.h"
+
+
+UWFCCompiledModel::UWFCCompiledModel()
+	: ContentHash(0),
+	  NumTiles(0),
+	  NumDirections(0),
+	  AdjacencyConstraintHash(0),
+	  BoundaryConstraintHash(0)
+{
+}
+
+void UWFCCompiledModel::Compile(const UWFCGenerator* Generator)
+{
+	check(Generator != nullptr);
+	check(Generator->IsInitialized());
+
+	NumTiles = Generator->GetNumTiles();
+	NumDirections = Generator->GetGrid()->GetNumDirections();
+	ContentHash = CalculateContentHash(Generator->GetModel(), NumDirections);
+
+	AdjacencyConstraintClass = nullptr;
+	AdjacencyConstraintHash = 0;
+	Adjacency.Reset();
+	BoundaryConstraintClass = nullptr;
+	BoundaryConstraintHash = 0;
+	BoundaryProhibitedDirections.Reset();
+
+	for (const UWFCConstraint* Constraint : Generator->GetConstraints())
+	{
+		Constraint->CompileModel(this);
+	}
+
+	UE_LOG(LogWFC, Verbose, TEXT("Compiled model %s: %d tiles, %d directions, hash %016llx"),
+	       *GetPathName(), NumTiles, NumDirections, ContentHash);
+}
+
+bool UWFCCompiledModel::IsValidFor(const UWFCModel* Model, int32 InNumDirections) const
+{
+	return Model && NumTiles == Model->GetNumTiles() && NumDirections == InNumDirections &&
+		ContentHash == CalculateContentHash(Model, InNumDirections);
+}
+
+bool UWFCCompiledModel::IsValidForConstraint(const UWFCConstraint* Constraint, const UClass* CompiledClass, uint64 CompiledHash) const
+{
+	check(Constraint != nullptr);
+
+	if (CompiledClass != Constraint->GetClass())
+	{
+		return false;
+	}
+
+	if (CompiledHash != Constraint->CalculateCompiledRulesHash())
+	{
+		UE_LOG(LogWFC, Warning, TEXT("%s has changed since %s was compiled and will build its own rules, it should be recompiled"),
+		       *Constraint->GetClass()->GetName(), *GetPathName());
+		return false;
+	}
+	return true;
+}
+
+uint64 UWFCCompiledModel::CalculateContentHash(const UWFCModel* Model, int32 InNumDirections)
+{
+	check(Model != nullptr);
+
+	FXxHash64Builder Builder;
+	Builder.Update(&InNumDirections, sizeof(InNumDirections));
+	Model->AppendContentHash(Builder, InNumDirections);
+	return Builder.Finalize().Hash;
+}
+
+void UWFCCompiledModel::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	Ar.UsingCustomVersion(FWFCCustomVersion::GUID);
+
+	// the rules are stored as flat arrays after the tagged properties, so they load with a single copy each
+	bool bHasAdjacency = Adjacency.IsValid();
+	Ar << bHasAdjacency;
+	if (bHasAdjacency)
+	{
+		if (Ar.IsLoading())
+		{
+			const TSharedRef<FWFCArcAdjacency> LoadedAdjacency = MakeShared<FWFCArcAdjacency>();
+			LoadedAdjacency->Serialize(Ar);
+			Adjacency = LoadedAdjacency;
+		}
+		else
+		{
+			// saving doesn't modify the adjacency
+			const_cast<FWFCArcAdjacency*>(Adjacency.Get())->Serialize(Ar);
+		}
+	}
+	else if (Ar.IsLoading())
+	{
+		Adjacency.Reset();
+	}
+
+	BoundaryProhibitedDirections.BulkSerialize(Ar);
+}
@@ -4,6 +4,8 @@
 #include "Core/WFCConstraint.h"
 
 #include "Core/WFCGenerator.h"
+#include "Hash/xxhash.h"
+#include "UObject/UnrealType.h"
 
 
 void UWFCConstraint::Initialize(UWFCGenerator* InGenerator)
@@ -30,11 +32,27 @@ void UWFCConstraint::NotifyCellBan(FWFCCellIndex CellIndex, FWFCTileId BannedTil
 {
 }
 
+void UWFCConstraint::NotifyCellBans(FWFCCellIndex CellIndex, TArrayView<const FWFCTileId> BannedTileIds)
+{
+	for (const FWFCTileId BannedTileId : BannedTileIds)
+	{
+		NotifyCellBan(CellIndex, BannedTileId);
+	}
+}
+
 bool UWFCConstraint::Next()
 {
 	return false;
 }
 
+void UWFCConstraint::SaveBacktrackPoint()
+{
+}
+
+void UWFCConstraint::RestoreBacktrackPoint()
+{
+}
+
 void UWFCConstraint::LogDebugInfo() const
 {
 }
@@ -47,3 +65,44 @@ UWFCConstraintSnapshot* UWFCConstraint::CreateSnapshot(UObject* Outer) const
 void UWFCConstraint::ApplySnapshot(const UWFCConstraintSnapshot* Snapshot)
 {
 }
+
+void UWFCConstraint::CompileModel(UWFCCompiledModel* CompiledModel) const
+{
+}
+
+uint64 UWFCConstraint::CalculateCompiledRulesHash() const
+{
+	FXxHash64Builder Builder;
+
+	const UClass* Class = GetClass();
+	const FString ClassPath = Class->GetPathName();
+	Builder.Update(*ClassPath, ClassPath.Len() * sizeof(TCHAR));
+
+	// constraints are always created from their class, so the defaults are the settings used to build their rules.
+	// runtime overrides, such as a generator's propagation mode, only change the instance.
+	const UObject* DefaultObject = Class->GetDefaultObject();
+	for (TFieldIterator<FProperty> It(Class); It; ++It)
+	{
+		const FProperty* Property = *It;
+		if (Property->HasAnyPropertyFlags(CPF_Transient))
+		{
+			continue;
+		}
+
+		for (int32 Index = 0; Index < Property->ArrayDim; ++Index)
+		{
+			FString ValueStr;
+			Property->ExportText_InContainer(Index, ValueStr, DefaultObject, nullptr, nullptr, PPF_None);
+			Builder.Update(*ValueStr, ValueStr.Len() * sizeof(TCHAR));
+		}
+	}
+
+	// Blueprint overrides can change how rules are built without changing any properties
+	for (TFieldIterator<UFunction> It(Class); It; ++It)
+	{
+		const UFunction* Function = *It;
+		Builder.Update(Function->Script.GetData(), Function->Script.Num());
+	}
+
+	return Builder.Finalize().Hash;
+}
@@ -3,17 +3,82 @@
 
 #include "Core/WFCGenerator.h"
 
+#include "WFCCustomVersion.h"
 #include "WFCModule.h"
 #include "Core/WFCCellSelector.h"
+#include "Core/WFCCompiledModel.h"
 #include "Core/WFCConstraint.h"
 #include "Core/WFCGrid.h"
 #include "Core/WFCModel.h"
 #include "Stats/StatsMisc.h"
+#include "UObject/GarbageCollection.h"
+#include "UObject/UObjectHash.h"
 
 DECLARE_CYCLE_STAT(TEXT("WFCGenerator Next"), STAT_WFCGeneratorNext, STATGROUP_WFC);
 DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num Cells"), STAT_WFCGeneratorNumCells, STATGROUP_WFC);
 DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num Tiles"), STAT_WFCGeneratorNumTiles, STATGROUP_WFC);
 DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num Cells Selected"), STAT_WFCGeneratorNumCellsSelected, STATGROUP_WFC);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num Backtracks"), STAT_WFCGeneratorNumBacktracks, STATGROUP_WFC);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num Restarts"), STAT_WFCGeneratorNumRestarts, STATGROUP_WFC);
+
+
+// UWFCGeneratorSnapshot
+// ---------------------
+
+UWFCGeneratorSnapshot::UWFCGeneratorSnapshot()
+	: NumTiles(0)
+{
+}
+
+void UWFCGeneratorSnapshot::SetCells(const TArray<FWFCCell>& InCells)
+{
+	NumTiles = InCells.IsEmpty() ? 0 : InCells[0].TileCandidates.GetNumBits();
+	const int32 NumWords = FWFCTileBitset::GetNumWordsForBits(NumTiles);
+
+	CandidateWords.SetNumUninitialized(InCells.Num() * NumWords);
+	CollapsePhases.SetNumUninitialized(InCells.Num());
+	for (int32 Idx = 0; Idx < InCells.Num(); ++Idx)
+	{
+		const FWFCCell& Cell = InCells[Idx];
+		check(Cell.TileCandidates.GetNumBits() == NumTiles);
+		FMemory::Memcpy(CandidateWords.GetData() + Idx * NumWords, Cell.TileCandidates.GetWords(), NumWords * sizeof(uint64));
+		CollapsePhases[Idx] = static_cast<uint8>(Cell.CollapsePhase);
+	}
+}
+
+void UWFCGeneratorSnapshot::CopyCellsTo(TArray<FWFCCell>& OutCells) const
+{
+	check(OutCells.Num() == GetNumCells());
+	const int32 NumWords = FWFCTileBitset::GetNumWordsForBits(NumTiles);
+
+	for (int32 Idx = 0; Idx < OutCells.Num(); ++Idx)
+	{
+		FWFCCell& Cell = OutCells[Idx];
+		check(Cell.TileCandidates.GetNumBits() == NumTiles);
+		FMemory::Memcpy(Cell.TileCandidates.GetMutableWords(), CandidateWords.GetData() + Idx * NumWords, NumWords * sizeof(uint64));
+		Cell.TileCandidates.RecountBits();
+		Cell.CollapsePhase = static_cast<EWFCGeneratorStepPhase>(CollapsePhases[Idx]);
+	}
+}
+
+void UWFCGeneratorSnapshot::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	Ar.UsingCustomVersion(FWFCCustomVersion::GUID);
+
+	if (Ar.IsLoading() && Ar.CustomVer(FWFCCustomVersion::GUID) < FWFCCustomVersion::CompactSnapshots)
+	{
+		// cells used to be saved one property at a time
+		SetCells(Cells_DEPRECATED);
+		Cells_DEPRECATED.Empty();
+		return;
+	}
+
+	Ar << NumTiles;
+	CandidateWords.BulkSerialize(Ar);
+	CollapsePhases.BulkSerialize(Ar);
+}
 
 
 // UWFCGenerator
@@ -27,7 +92,15 @@ UWFCGenerator::UWFCGenerator()
 	  bIsInitialized(false),
 	  bDidSelectCellThisStep(false),
 	  NumBansThisUpdate(0),
-	  CurrentStepPhase(EWFCGeneratorStepPhase::None)
+	  CurrentStepPhase(EWFCGeneratorStepPhase::None),
+	  AffectedEpoch(1),
+	  NumSelectedCells(0),
+	  NumContradictedCells(0),
+	  NumBacktracks(0),
+	  bHasContradiction(false),
+	  NumRestarts(0),
+	  AttemptSeed(0),
+	  AttemptStartTime(0.0)
 {
 }
 
@@ -35,6 +108,13 @@ void UWFCGenerator::SetState(EWFCGeneratorState NewState)
 {
 	if (State != NewState)
 	{
+		if (NumRestarts > 0 && (NewState == EWFCGeneratorState::Finished || NewState == EWFCGeneratorState::Error))
+		{
+			UE_LOG(LogWFC, Log, TEXT("WFCGenerator %s after %d attempt(s), last attempt took %.2fms with seed %d."),
+			       NewState == EWFCGeneratorState::Finished ? TEXT("finished") : TEXT("failed"),
+			       NumRestarts + 1, GetAttemptTimeMs(), AttemptSeed);
+		}
+
 		State = NewState;
 		OnStateChanged.Broadcast(State);
 	}
@@ -78,8 +158,11 @@ void UWFCGenerator::Initialize(bool bFull)
 
 	SCOPE_LOG_TIME_FUNC();
 
-	// TODO: cache in WFCAsset snapshot, and then put this behind bFull
-	Config.Model->GenerateTiles();
+	RandomStream.Initialize(Config.Seed);
+	AttemptSeed = Config.Seed;
+
+	// the model may be shared with other generators, in which case its tiles already exist
+	Config.Model->EnsureTilesGenerated();
 	NumTiles = Config.Model->GetNumTiles();
 	SET_DWORD_STAT(STAT_WFCGeneratorNumTiles, NumTiles);
 
@@ -126,12 +209,25 @@ void UWFCGenerator::CreateConstraints()
 
 void UWFCGenerator::InitializeConstraints()
 {
+	InitializeCompiledModel();
+
 	for (UWFCConstraint* Constraint : Constraints)
 	{
 		Constraint->Initialize(this);
 	}
 }
 
+void UWFCGenerator::InitializeCompiledModel()
+{
+	CompiledModel = Config.CompiledModel.Get();
+	if (CompiledModel && !CompiledModel->IsValidFor(Config.Model.Get(), Grid->GetNumDirections()))
+	{
+		UE_LOG(LogWFC, Warning, TEXT("%s does not match the model's tiles and will be ignored, it should be recompiled"),
+		       *CompiledModel->GetPathName());
+		CompiledModel = nullptr;
+	}
+}
+
 void UWFCGenerator::CreateCellSelectors()
 {
 	CellSelectors.Reset();
@@ -158,14 +254,8 @@ void UWFCGenerator::InitializeCellSelectors()
 
 void UWFCGenerator::InitializeCells()
 {
-	// generate array of all tile ids for default cell candidate list
-	TArray<FWFCTileId> AllTileCandidates;
-	AllTileCandidates.SetNum(GetNumTiles());
-	for (int32 Idx = 0; Idx < AllTileCandidates.Num(); ++Idx)
-	{
-		// tile id is the same as the tile index
-		AllTileCandidates[Idx] = Idx;
-	}
+	// every tile id is a candidate by default
+	const FWFCTileBitset AllTileCandidates(GetNumTiles(), true);
 
 	// fill the cells array
 	NumCells = Grid->GetNumCells();
@@ -175,25 +265,126 @@ void UWFCGenerator::InitializeCells()
 		Cells[Idx].TileCandidates = AllTileCandidates;
 	}
 
+	CellAffectedEpochs.Init(0, NumCells);
+	AffectedEpoch = 1;
+	CellsAffectedThisUpdate.Reset();
+
+	RecalculateCellStatuses();
+
 	SET_DWORD_STAT(STAT_WFCGeneratorNumCells, NumCells);
-	SET_DWORD_STAT(STAT_WFCGeneratorNumCellsSelected, 0);
 }
 
-bool UWFCGenerator::AreAllCellsSelected() const
+void UWFCGenerator::RecalculateCellStatuses()
+{
+	CellStatuses.SetNumUninitialized(NumCells);
+	NumSelectedCells = 0;
+	NumContradictedCells = 0;
+	OpenCells.Reset(NumCells);
+	OpenCellPositions.Init(INDEX_NONE, NumCells);
+	for (FWFCCellIndex Idx = 0; Idx < NumCells; ++Idx)
+	{
+		const FWFCCell& Cell = Cells[Idx];
+		if (Cell.HasNoCandidates())
+		{
+			CellStatuses[Idx] = EWFCCellStatus::Contradiction;
+			++NumContradictedCells;
+		}
+		else if (Cell.HasSelection())
+		{
+			CellStatuses[Idx] = EWFCCellStatus::Selected;
+			++NumSelectedCells;
+		}
+		else
+		{
+			CellStatuses[Idx] = EWFCCellStatus::Open;
+			AddOpenCell(Idx);
+		}
+	}
+
+	SET_DWORD_STAT(STAT_WFCGeneratorNumCellsSelected, NumSelectedCells);
+}
+
+EWFCCellStatus UWFCGenerator::UpdateCellStatus(FWFCCellIndex CellIndex)
 {
-	// TODO: cache
-	for (const FWFCCell& Cell : Cells)
+	const FWFCCell& Cell = Cells[CellIndex];
+	EWFCCellStatus NewStatus = EWFCCellStatus::Open;
+	if (Cell.HasNoCandidates())
 	{
-		if (!Cell.HasSelection())
+		NewStatus = EWFCCellStatus::Contradiction;
+	}
+	else if (Cell.HasSelection())
+	{
+		NewStatus = EWFCCellStatus::Selected;
+	}
+
+	EWFCCellStatus& Status = CellStatuses[CellIndex];
+	if (Status != NewStatus)
+	{
+		NumSelectedCells += (NewStatus == EWFCCellStatus::Selected) - (Status == EWFCCellStatus::Selected);
+		NumContradictedCells += (NewStatus == EWFCCellStatus::Contradiction) - (Status == EWFCCellStatus::Contradiction);
+		if (Status == EWFCCellStatus::Open)
+		{
+			RemoveOpenCell(CellIndex);
+		}
+		else if (NewStatus == EWFCCellStatus::Open)
 		{
-			return false;
+			AddOpenCell(CellIndex);
 		}
+		Status = NewStatus;
+	}
+	return NewStatus;
+}
+
+void UWFCGenerator::AddOpenCell(FWFCCellIndex CellIndex)
+{
+	OpenCellPositions[CellIndex] = OpenCells.Add(CellIndex);
+}
+
+void UWFCGenerator::RemoveOpenCell(FWFCCellIndex CellIndex)
+{
+	// swap the last open cell into the removed position
+	const int32 Position = OpenCellPositions[CellIndex];
+	const FWFCCellIndex LastCellIndex = OpenCells.Pop(EAllowShrinking::No);
+	if (Position < OpenCells.Num())
+	{
+		OpenCells[Position] = LastCellIndex;
+		OpenCellPositions[LastCellIndex] = Position;
+	}
+	OpenCellPositions[CellIndex] = INDEX_NONE;
+}
+
+void UWFCGenerator::ResetCellsAffectedThisUpdate()
+{
+	CellsAffectedThisUpdate.Reset();
+
+	if (++AffectedEpoch == 0)
+	{
+		// the epoch wrapped around, clear all stamps so that no cell appears affected
+		FMemory::Memzero(CellAffectedEpochs.GetData(), CellAffectedEpochs.Num() * sizeof(uint32));
+		AffectedEpoch = 1;
 	}
-	return true;
+}
+
+void UWFCGenerator::ResetBacktracking()
+{
+	BanTrail.Reset();
+	ChoicePoints.Reset();
+	bHasContradiction = false;
 }
 
 void UWFCGenerator::Reset()
 {
+	RandomStream.Initialize(Config.Seed);
+	AttemptSeed = Config.Seed;
+	ResetBacktracking();
+	NumBacktracks = 0;
+	SET_DWORD_STAT(STAT_WFCGeneratorNumBacktracks, 0);
+
+	// the restart snapshot is captured again before the next first selection
+	RestartSnapshot = nullptr;
+	NumRestarts = 0;
+	SET_DWORD_STAT(STAT_WFCGeneratorNumRestarts, 0);
+
 	InitializeCells();
 
 	for (UWFCConstraint* Constraint : Constraints)
@@ -201,10 +392,14 @@ void UWFCGenerator::Reset()
 		Constraint->Reset();
 	}
 
+	for (UWFCCellSelector* CellSelector : CellSelectors)
+	{
+		CellSelector->Reset();
+	}
+
 	bDidSelectCellThisStep = false;
 	NumBansThisUpdate = 0;
 	CurrentStepPhase = EWFCGeneratorStepPhase::None;
-	CellsAffectedThisUpdate.Reset();
 	SetState(EWFCGeneratorState::None);
 }
 
@@ -259,6 +454,21 @@ void UWFCGenerator::RunStartup(int32 StepLimit)
 	}
 }
 
+void UWFCGenerator::PostAsyncRun()
+{
+	check(IsInGameThread());
+
+	// objects created off the game thread are flagged as async and ignored by garbage collection until cleared
+	if (RestartSnapshot)
+	{
+		RestartSnapshot->AtomicallyClearInternalFlags(EInternalObjectFlags::Async);
+		ForEachObjectWithOuter(RestartSnapshot, [](UObject* Object)
+		{
+			Object->AtomicallyClearInternalFlags(EInternalObjectFlags::Async);
+		});
+	}
+}
+
 void UWFCGenerator::Next(bool bNoSelection)
 {
 	if (State == EWFCGeneratorState::Finished)
@@ -268,7 +478,7 @@ void UWFCGenerator::Next(bool bNoSelection)
 
 	SCOPE_CYCLE_COUNTER(STAT_WFCGeneratorNext);
 	bDidSelectCellThisStep = false;
-	CellsAffectedThisUpdate.Reset();
+	ResetCellsAffectedThisUpdate();
 
 	CurrentStepPhase = EWFCGeneratorStepPhase::Constraints;
 
@@ -277,7 +487,15 @@ void UWFCGenerator::Next(bool bNoSelection)
 	for (UWFCConstraint* Constraint : Constraints)
 	{
 		NumBansThisUpdate = 0;
-		if (Constraint->Next())
+		const bool bDidApplyConstraint = Constraint->Next();
+
+		if (bHasContradiction)
+		{
+			ResolveContradiction();
+			return;
+		}
+
+		if (bDidApplyConstraint)
 		{
 			UE_LOG(LogWFC, Verbose, TEXT("Applied constraint: %s, bans: %d"), *Constraint->GetName(), NumBansThisUpdate);
 
@@ -315,6 +533,11 @@ void UWFCGenerator::Next(bool bNoSelection)
 		return;
 	}
 
+	if (Config.MaxRestarts > 0 && !RestartSnapshot)
+	{
+		CaptureRestartSnapshot();
+	}
+
 	// select a cell to observe
 	const FWFCCellIndex CellIndex = SelectNextCellIndex();
 
@@ -335,8 +558,19 @@ void UWFCGenerator::Next(bool bNoSelection)
 		return;
 	}
 
+	if (IsBacktrackingEnabled())
+	{
+		PushChoicePoint(CellIndex, TileId);
+	}
+
 	Select(CellIndex, TileId);
 
+	if (bHasContradiction)
+	{
+		ResolveContradiction();
+		return;
+	}
+
 	if (State == EWFCGeneratorState::Finished || State == EWFCGeneratorState::Error)
 	{
 		return;
@@ -353,6 +587,10 @@ bool UWFCGenerator::Ban(int32 CellIndex, int32 TileId)
 		FWFCCell& Cell = GetCell(CellIndex);
 		if (Cell.RemoveCandidate(TileId))
 		{
+			if (!ChoicePoints.IsEmpty())
+			{
+				BanTrail.Emplace(CellIndex, TileId);
+			}
 			OnCellCandidateBanned(CellIndex, TileId);
 		}
 
@@ -374,6 +612,10 @@ bool UWFCGenerator::BanMultiple(int32 CellIndex, TArray<int32> TileIds)
 		{
 			if (Cell.RemoveCandidate(TileId))
 			{
+				if (!ChoicePoints.IsEmpty())
+				{
+					BanTrail.Emplace(CellIndex, TileId);
+				}
 				BannedTileIds.Add(TileId);
 				++NumBansThisUpdate;
 			}
@@ -395,6 +637,7 @@ void UWFCGenerator::Select(int32 CellIndex, int32 TileId)
 	{
 		FWFCCell& Cell = GetCell(CellIndex);
 		TArray<FWFCTileId> IdsToBan;
+		IdsToBan.Reserve(Cell.TileCandidates.Num());
 		for (const FWFCTileId& Id : Cell.TileCandidates)
 		{
 			if (Id != TileId)
@@ -404,9 +647,196 @@ void UWFCGenerator::Select(int32 CellIndex, int32 TileId)
 		}
 		if (IdsToBan.Num() > 0)
 		{
-			BanMultiple(CellIndex, IdsToBan);
+			BanMultiple(CellIndex, MoveTemp(IdsToBan));
+		}
+	}
+}
+
+void UWFCGenerator::CollapseCell(int32 CellIndex, int32 StepLimit)
+{
+	if (!IsValidCellIndex(CellIndex) || GetCell(CellIndex).HasSelection())
+	{
+		return;
+	}
+
+	if (State == EWFCGeneratorState::Finished || State == EWFCGeneratorState::Error)
+	{
+		return;
+	}
+
+	bDidSelectCellThisStep = false;
+	ResetCellsAffectedThisUpdate();
+	CurrentStepPhase = EWFCGeneratorStepPhase::Selection;
+
+	if (Config.MaxRestarts > 0 && !RestartSnapshot)
+	{
+		CaptureRestartSnapshot();
+	}
+
+	const FWFCTileId TileId = SelectNextTileForCell(CellIndex);
+	if (TileId == INDEX_NONE)
+	{
+		UE_LOG(LogWFC, Verbose, TEXT("Failed to select a tile"));
+		SetState(EWFCGeneratorState::Error);
+		return;
+	}
+
+	if (IsBacktrackingEnabled())
+	{
+		PushChoicePoint(CellIndex, TileId);
+	}
+
+	Select(CellIndex, TileId);
+
+	if (bHasContradiction)
+	{
+		ResolveContradiction();
+	}
+
+	// propagate until constraints are done and the generator is ready for another selection
+	for (int32 Step = 0; Step < StepLimit; ++Step)
+	{
+		if (State != EWFCGeneratorState::InProgress && State != EWFCGeneratorState::None)
+		{
+			break;
+		}
+
+		Next(true);
+
+		if (CurrentStepPhase == EWFCGeneratorStepPhase::Selection)
+		{
+			break;
+		}
+	}
+}
+
+void UWFCGenerator::PushChoicePoint(FWFCCellIndex CellIndex, FWFCTileId TileId)
+{
+	ChoicePoints.Emplace(CellIndex, TileId, BanTrail.Num());
+
+	for (UWFCConstraint* Constraint : Constraints)
+	{
+		Constraint->SaveBacktrackPoint();
+	}
+}
+
+FWFCGeneratorChoicePoint UWFCGenerator::PopChoicePoint()
+{
+	check(!ChoicePoints.IsEmpty());
+	const FWFCGeneratorChoicePoint ChoicePoint = ChoicePoints.Pop(EAllowShrinking::No);
+
+	// restore bans in reverse order, bans of a cell are usually consecutive so most cells are only updated once
+	FWFCCellIndex PrevCellIndex = INDEX_NONE;
+	for (int32 Idx = BanTrail.Num() - 1; Idx >= ChoicePoint.BanTrailNum; --Idx)
+	{
+		const FWFCCellIndexAndTileId& TrailBan = BanTrail[Idx];
+		if (TrailBan.CellIndex != PrevCellIndex && PrevCellIndex != INDEX_NONE)
+		{
+			OnCellCandidatesRestored(PrevCellIndex);
+		}
+		PrevCellIndex = TrailBan.CellIndex;
+
+		Cells[TrailBan.CellIndex].AddCandidate(TrailBan.TileId);
+
+		for (UWFCCellSelector* CellSelector : CellSelectors)
+		{
+			CellSelector->NotifyCellCandidateRestored(TrailBan.CellIndex, TrailBan.TileId);
+		}
+	}
+	if (PrevCellIndex != INDEX_NONE)
+	{
+		OnCellCandidatesRestored(PrevCellIndex);
+	}
+
+	UE_LOG(LogWFC, VeryVerbose, TEXT("Restored %d ban(s) made since selecting %s for cell %s."),
+	       BanTrail.Num() - ChoicePoint.BanTrailNum,
+	       *GetTileDebugString(ChoicePoint.TileId), *Grid->GetCellName(ChoicePoint.CellIndex));
+
+	BanTrail.SetNum(ChoicePoint.BanTrailNum, EAllowShrinking::No);
+
+	for (UWFCConstraint* Constraint : Constraints)
+	{
+		Constraint->RestoreBacktrackPoint();
+	}
+
+	SET_DWORD_STAT(STAT_WFCGeneratorNumCellsSelected, NumSelectedCells);
+	return ChoicePoint;
+}
+
+void UWFCGenerator::ResolveContradiction()
+{
+	// banning the failed tile can cause another contradiction if it was the last candidate
+	while (bHasContradiction)
+	{
+		bHasContradiction = false;
+
+		if (ChoicePoints.IsEmpty() || NumBacktracks >= Config.MaxBacktracks)
+		{
+			if (RestartSnapshot && NumRestarts < Config.MaxRestarts)
+			{
+				Restart();
+				return;
+			}
+
+			UE_LOG(LogWFC, Verbose, TEXT("Contradiction could not be resolved after %d backtrack(s)."), NumBacktracks);
+			SetState(EWFCGeneratorState::Error);
+			return;
 		}
+
+		const FWFCGeneratorChoicePoint ChoicePoint = PopChoicePoint();
+		++NumBacktracks;
+		SET_DWORD_STAT(STAT_WFCGeneratorNumBacktracks, NumBacktracks);
+
+		UE_LOG(LogWFC, Verbose, TEXT("Backtracking (%d/%d), tile %s is not valid for cell %s."),
+		       NumBacktracks, Config.MaxBacktracks,
+		       *GetTileDebugString(ChoicePoint.TileId), *Grid->GetCellName(ChoicePoint.CellIndex));
+
+		// the failed tile is not valid given all earlier choices, so ban it as part of the previous choice point
+		Ban(ChoicePoint.CellIndex, ChoicePoint.TileId);
+	}
+}
+
+void UWFCGenerator::CaptureRestartSnapshot()
+{
+	// this may be called on a worker thread during an async run, so block garbage collection while creating objects
+	FGCScopeGuard GCScopeGuard;
+	RestartSnapshot = CreateSnapshot(this);
+	AttemptStartTime = FPlatformTime::Seconds();
+}
+
+void UWFCGenerator::Restart()
+{
+	check(RestartSnapshot != nullptr);
+
+	// derive the next seed from the stream, so the original seed still reproduces every attempt
+	const int32 NewSeed = static_cast<int32>(RandomStream.GetUnsignedInt());
+
+	UE_LOG(LogWFC, Log, TEXT("WFCGenerator attempt %d failed after %.2fms and %d backtrack(s), restarting with seed %d (%d/%d)."),
+	       NumRestarts + 1, GetAttemptTimeMs(), NumBacktracks, NewSeed, NumRestarts + 1, Config.MaxRestarts);
+
+	++NumRestarts;
+	SET_DWORD_STAT(STAT_WFCGeneratorNumRestarts, NumRestarts);
+
+	// reseed before applying, since cell selectors draw from the stream when they are reset
+	AttemptSeed = NewSeed;
+	RandomStream.Initialize(AttemptSeed);
+	NumBacktracks = 0;
+	SET_DWORD_STAT(STAT_WFCGeneratorNumBacktracks, 0);
+
+	ApplySnapshot(RestartSnapshot);
+
+	// any cell may have changed
+	for (FWFCCellIndex CellIndex = 0; CellIndex < NumCells; ++CellIndex)
+	{
+		MarkCellAffected(CellIndex);
 	}
+
+	AttemptStartTime = FPlatformTime::Seconds();
+}
+
+double UWFCGenerator::GetAttemptTimeMs() const
+{
+	return AttemptStartTime > 0.0 ? (FPlatformTime::Seconds() - AttemptStartTime) * 1000.0 : 0.0;
 }
 
 FString UWFCGenerator::GetTileDebugString(int32 TileId) const
@@ -434,7 +864,7 @@ void UWFCGenerator::GetSelectedTileIds(TArray<int32>& OutTileIds) const
 UWFCGeneratorSnapshot* UWFCGenerator::CreateSnapshot(UObject* Outer) const
 {
 	UWFCGeneratorSnapshot* Snapshot = NewObject<UWFCGeneratorSnapshot>(Outer);
-	Snapshot->Cells = Cells;
+	Snapshot->SetCells(Cells);
 
 	for (const UWFCConstraint* Constraint : Constraints)
 	{
@@ -455,13 +885,45 @@ void UWFCGenerator::ApplySnapshot(const UWFCGeneratorSnapshot* Snapshot)
 		return;
 	}
 
-	if (Snapshot->Cells.Num() == !Cells.Num())
+	if (Snapshot->GetNumCells() != Cells.Num())
 	{
 		UE_LOG(LogWFC, Error, TEXT("Snapshot does not match cell count: %s"), *Snapshot->GetFullName(Snapshot->GetOuter()));
 		return;
 	}
 
-	Cells = Snapshot->Cells;
+	if (Snapshot->GetNumCells() > 0 && Snapshot->GetNumTiles() != NumTiles)
+	{
+		// snapshots saved before candidates were stored as bitsets, or with a different tile set, have no usable candidates
+		UE_LOG(LogWFC, Error, TEXT("Snapshot does not match tile count, it should be updated: %s"),
+		       *Snapshot->GetFullName(Snapshot->GetOuter()));
+		return;
+	}
+
+	// remember the cells that listeners may have handled a selection for, to report any that change
+	TArray<FWFCCellIndexAndTileId> PrevCollapsedCells;
+	if (OnCellUnselected.IsBound())
+	{
+		for (FWFCCellIndex CellIndex = 0; CellIndex < NumCells; ++CellIndex)
+		{
+			if (CellStatuses[CellIndex] != EWFCCellStatus::Open)
+			{
+				PrevCollapsedCells.Emplace(CellIndex, Cells[CellIndex].GetSelectedTileId());
+			}
+		}
+	}
+
+	Snapshot->CopyCellsTo(Cells);
+	RecalculateCellStatuses();
+	ResetBacktracking();
+
+	for (const FWFCCellIndexAndTileId& PrevCollapsedCell : PrevCollapsedCells)
+	{
+		const FWFCCell& Cell = Cells[PrevCollapsedCell.CellIndex];
+		if (!Cell.HasSelection() || Cell.GetSelectedTileId() != PrevCollapsedCell.TileId)
+		{
+			OnCellUnselected.Broadcast(PrevCollapsedCell.CellIndex);
+		}
+	}
 
 	for (UWFCConstraint* Constraint : Constraints)
 	{
@@ -473,6 +935,12 @@ void UWFCGenerator::ApplySnapshot(const UWFCGeneratorSnapshot* Snapshot)
 		}
 	}
 
+	// cell selectors track cell state, so they must be rebuilt from the new cells
+	for (UWFCCellSelector* CellSelector : CellSelectors)
+	{
+		CellSelector->Reset();
+	}
+
 	UE_LOG(LogWFC, Log, TEXT("Applied snapshot: %s"), *Snapshot->GetFullName(Snapshot->GetOuter()));
 }
 
@@ -502,6 +970,11 @@ void UWFCGenerator::OnCellCandidateBanned(FWFCCellIndex CellIndex, FWFCTileId Ba
 		Constraint->NotifyCellBan(CellIndex, BannedTileId);
 	}
 
+	for (UWFCCellSelector* CellSelector : CellSelectors)
+	{
+		CellSelector->NotifyCellBan(CellIndex, BannedTileId);
+	}
+
 	OnCellChanged(CellIndex);
 }
 
@@ -509,10 +982,12 @@ void UWFCGenerator::OnCellCandidatesBanned(FWFCCellIndex CellIndex, const TArray
 {
 	for (UWFCConstraint* Constraint : Constraints)
 	{
-		for (const FWFCTileId& BannedTileId : BannedTileIds)
-		{
-			Constraint->NotifyCellBan(CellIndex, BannedTileId);
-		}
+		Constraint->NotifyCellBans(CellIndex, BannedTileIds);
+	}
+
+	for (UWFCCellSelector* CellSelector : CellSelectors)
+	{
+		CellSelector->NotifyCellBans(CellIndex, BannedTileIds);
 	}
 
 	OnCellChanged(CellIndex);
@@ -520,10 +995,11 @@ void UWFCGenerator::OnCellCandidatesBanned(FWFCCellIndex CellIndex, const TArray
 
 void UWFCGenerator::OnCellChanged(FWFCCellIndex CellIndex)
 {
-	CellsAffectedThisUpdate.AddUnique(CellIndex);
+	MarkCellAffected(CellIndex);
 
 	FWFCCell& Cell = GetCell(CellIndex);
-	const bool bHasSelection = Cell.HasSelection();
+	const EWFCCellStatus CellStatus = UpdateCellStatus(CellIndex);
+	const bool bHasSelection = CellStatus == EWFCCellStatus::Selected;
 	if (bHasSelection)
 	{
 		Cell.CollapsePhase = CurrentStepPhase;
@@ -533,14 +1009,13 @@ void UWFCGenerator::OnCellChanged(FWFCCellIndex CellIndex)
 		       *GetModel()->GetTileDebugString(GetCell(CellIndex).GetSelectedTileId()),
 		       Cell.CollapsePhase == EWFCGeneratorStepPhase::Constraints ? TEXT("Constraints") : TEXT("Selection"));
 
-		INC_DWORD_STAT(STAT_WFCGeneratorNumCellsSelected);
+		SET_DWORD_STAT(STAT_WFCGeneratorNumCellsSelected, NumSelectedCells);
 		bDidSelectCellThisStep = true;
 		OnCellSelected.Broadcast(CellIndex);
 	}
-	else if (Cell.HasNoCandidates())
+	else if (CellStatus == EWFCCellStatus::Contradiction)
 	{
-		// contradiction
-		SetState(EWFCGeneratorState::Error);
+		NotifyContradiction();
 	}
 
 	for (UWFCConstraint* Constraint : Constraints)
@@ -548,12 +1023,51 @@ void UWFCGenerator::OnCellChanged(FWFCCellIndex CellIndex)
 		Constraint->NotifyCellChanged(CellIndex, bHasSelection);
 	}
 
-	if (AreAllCellsSelected())
+	for (UWFCCellSelector* CellSelector : CellSelectors)
+	{
+		CellSelector->NotifyCellChanged(CellIndex, bHasSelection);
+	}
+
+	// constraints may have found a contradiction when notified of the last selection
+	if (AreAllCellsSelected() && !bHasContradiction && State != EWFCGeneratorState::Error)
 	{
 		SetState(EWFCGeneratorState::Finished);
 	}
 }
 
+void UWFCGenerator::NotifyContradiction()
+{
+	if (IsBacktrackingEnabled() || Config.MaxRestarts > 0)
+	{
+		// resolved once the current constraint or selection returns
+		bHasContradiction = true;
+	}
+	else
+	{
+		SetState(EWFCGeneratorState::Error);
+	}
+}
+
+void UWFCGenerator::OnCellCandidatesRestored(FWFCCellIndex CellIndex)
+{
+	MarkCellAffected(CellIndex);
+
+	// restoring candidates never changes a selection, it only reopens selected or contradicted cells
+	const EWFCCellStatus PrevStatus = CellStatuses[CellIndex];
+	const EWFCCellStatus CellStatus = UpdateCellStatus(CellIndex);
+	const bool bHasSelection = CellStatus == EWFCCellStatus::Selected;
+
+	for (UWFCCellSelector* CellSelector : CellSelectors)
+	{
+		CellSelector->NotifyCellChanged(CellIndex, bHasSelection);
+	}
+
+	if (PrevStatus != EWFCCellStatus::Open && CellStatus == EWFCCellStatus::Open)
+	{
+		OnCellUnselected.Broadcast(CellIndex);
+	}
+}
+
 FWFCCellIndex UWFCGenerator::SelectNextCellIndex()
 {
 	// TODO: why would one cell selector not be used? how do we define phases of selection?
@@ -578,43 +1092,69 @@ FWFCTileId UWFCGenerator::SelectNextTileForCell(FWFCCellIndex CellIndex)
 		return INDEX_NONE;
 	}
 
+	const int32 NumCandidates = Cell.TileCandidates.Num();
+	if (NumCandidates == 1)
+	{
+		return Cell.TileCandidates.GetFirst();
+	}
+
+	const UWFCModel* Model = Config.Model.Get();
+
+	// when most tiles are still candidates, sample from the weights of all tiles using the model's
+	// prefix sums, and retry until a candidate is hit. this is equivalent to sampling from only the candidates.
+	// the number of tries is limited, in case the remaining candidates have very little of the total weight.
+	constexpr int32 RejectionSamplingMaxTries = 16;
+	const double AllTilesWeight = Model->GetTotalTileWeight();
+	if (NumCandidates * 4 >= NumTiles && AllTilesWeight > 0.0)
+	{
+		for (int32 Try = 0; Try < RejectionSamplingMaxTries; ++Try)
+		{
+			const FWFCTileId TileId = Model->FindTileIdForCumulativeWeight(RandomStream.FRand() * AllTilesWeight);
+			if (Cell.TileCandidates.Contains(TileId))
+			{
+				UE_LOG(LogWFC, Verbose, TEXT("Selected tile %s out of %d candidates. (Weight: %f, Tries: %d)"),
+				       *GetModel()->GetTileDebugString(TileId), NumCandidates, Model->GetTileWeightUnchecked(TileId), Try + 1);
+
+				return TileId;
+			}
+		}
+	}
+
 	// select a candidate, applying weighted probabilities
-	float TotalWeight = 0.f;
-	TArray<float> TileWeights;
-	for (const FWFCTileId& TileId : Cell.TileCandidates)
+	double TotalWeight = 0.0;
+	for (const FWFCTileId TileId : Cell.TileCandidates)
 	{
-		const float TileWeight = Config.Model->GetTileWeightUnchecked(TileId);
-		TileWeights.Add(TileWeight);
-		TotalWeight += TileWeight;
+		TotalWeight += Model->GetTileWeightUnchecked(TileId);
 	}
 
 	if (FMath::IsNearlyZero(TotalWeight))
 	{
 		// no weights, treat all equally
-		const int32 Idx = FMath::RandHelper(Cell.TileCandidates.Num());
+		const FWFCTileId TileId = Cell.TileCandidates.GetNth(RandomStream.RandHelper(NumCandidates));
 
 		UE_LOG(LogWFC, Verbose, TEXT("Selected tile %s out of %d candidates, with 0 total weight."),
-		       *GetModel()->GetTileDebugString(Cell.TileCandidates[Idx]), Cell.TileCandidates.Num());
+		       *GetModel()->GetTileDebugString(TileId), NumCandidates);
 
-		return Cell.TileCandidates[Idx];
+		return TileId;
 	}
 
-	float Rand = FMath::FRand() * TotalWeight;
-	for (int32 Idx = 0; Idx < Cell.TileCandidates.Num(); ++Idx)
+	double Rand = RandomStream.FRand() * TotalWeight;
+	for (const FWFCTileId TileId : Cell.TileCandidates)
 	{
-		if (Rand >= TileWeights[Idx])
+		const float TileWeight = Model->GetTileWeightUnchecked(TileId);
+		if (Rand >= TileWeight)
 		{
-			Rand -= TileWeights[Idx];
+			Rand -= TileWeight;
 		}
 		else
 		{
 			UE_LOG(LogWFC, Verbose, TEXT("Selected tile %s out of %d candidates. (Weight: %f, Probability: %f%%)"),
-			       *GetModel()->GetTileDebugString(Cell.TileCandidates[Idx]), Cell.TileCandidates.Num(),
-			       TileWeights[Idx], (TileWeights[Idx] / TotalWeight) * 100.f);
+			       *GetModel()->GetTileDebugString(TileId), NumCandidates,
+			       TileWeight, (TileWeight / TotalWeight) * 100.f);
 
-			return Cell.TileCandidates[Idx];
+			return TileId;
 		}
 	}
 
-	return Cell.TileCandidates[0];
+	return Cell.TileCandidates.GetFirst();
 }
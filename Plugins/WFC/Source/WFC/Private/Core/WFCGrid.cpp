@@ -11,6 +11,7 @@ UWFCGridConfig::UWFCGridConfig()
 
 
 UWFCGrid::UWFCGrid()
+	: CachedNumDirections(0)
 {
 }
 
@@ -20,6 +21,8 @@ UWFCGrid* UWFCGrid::NewGrid(UObject* Outer, const UWFCGridConfig* Config)
 	{
 		UWFCGrid* NewGrid = NewObject<UWFCGrid>(Outer, Config->GridClass);
 		NewGrid->Initialize(Config);
+		// built here rather than by each subclass, so that every grid has them once initialized
+		NewGrid->CacheNeighborIndices();
 		return NewGrid;
 	}
 	return nullptr;
@@ -59,6 +62,44 @@ FWFCCellIndex UWFCGrid::GetCellIndexInDirection(FWFCCellIndex CellIndex, FWFCGri
 	return INDEX_NONE;
 }
 
+void UWFCGrid::CacheNeighborIndices()
+{
+	CachedNumDirections = GetNumDirections();
+	const int32 NumCells = GetNumCells();
+
+	// boundary signatures are direction masks
+	check(CachedNumDirections <= 32);
+
+	NeighborIndices.SetNumUninitialized(NumCells * CachedNumDirections);
+	BoundaryCells.Reset();
+	BoundaryCellMasks.Reset();
+	for (FWFCCellIndex CellIndex = 0; CellIndex < NumCells; ++CellIndex)
+	{
+		uint32 BoundaryMask = 0;
+		for (FWFCGridDirection Direction = 0; Direction < CachedNumDirections; ++Direction)
+		{
+			const FWFCCellIndex NeighborIndex = GetCellIndexInDirection(CellIndex, Direction);
+			NeighborIndices[CellIndex * CachedNumDirections + Direction] = NeighborIndex;
+			if (NeighborIndex == INDEX_NONE)
+			{
+				BoundaryMask |= 1u << Direction;
+			}
+		}
+
+		if (BoundaryMask != 0)
+		{
+			BoundaryCells.Add(CellIndex);
+			BoundaryCellMasks.Add(BoundaryMask);
+		}
+	}
+
+	OppositeDirections.SetNumUninitialized(CachedNumDirections);
+	for (FWFCGridDirection Direction = 0; Direction < CachedNumDirections; ++Direction)
+	{
+		OppositeDirections[Direction] = GetOppositeDirection(Direction);
+	}
+}
+
 FString UWFCGrid::GetDirectionName(int32 Direction) const
 {
 	return FString::FromInt(Direction);
@@ -3,6 +3,14 @@
 
 #include "Core/WFCModel.h"
 
+#include "Algo/BinarySearch.h"
+#include "Hash/xxhash.h"
+
+
+UWFCModel::UWFCModel()
+	: bHasGeneratedTiles(false)
+{
+}
 
 void UWFCModel::Initialize(const UObject* TileData)
 {
@@ -13,6 +21,17 @@ void UWFCModel::GenerateTiles()
 {
 }
 
+void UWFCModel::EnsureTilesGenerated()
+{
+	if (bHasGeneratedTiles)
+	{
+		return;
+	}
+
+	GenerateTiles();
+	bHasGeneratedTiles = true;
+}
+
 FWFCTileId UWFCModel::AddTile(TSharedPtr<FWFCModelTile> Tile)
 {
 	check(Tile.IsValid());
@@ -20,7 +39,16 @@ FWFCTileId UWFCModel::AddTile(TSharedPtr<FWFCModelTile> Tile)
 
 	Tile->Id = Tiles.Num();
 	Tiles.Add(Tile);
-	TileWeights.Add(Tile->Weight);
+
+	// negative weights are treated as no weight, so that every way of sampling tiles uses the same distribution
+	const float Weight = FMath::Max(Tile->Weight, 0.f);
+	TileWeights.Add(Weight);
+
+	if (TileWeightPrefixSums.IsEmpty())
+	{
+		TileWeightPrefixSums.Add(0.0);
+	}
+	TileWeightPrefixSums.Add(TileWeightPrefixSums.Last() + Weight);
 
 	return Tile->Id;
 }
@@ -30,7 +58,29 @@ FWFCModelTile* UWFCModel::GetTile(FWFCTileId TileId) const
 	return Tiles.IsValidIndex(TileId) ? Tiles[TileId].Get() : nullptr;
 }
 
+FWFCTileId UWFCModel::FindTileIdForCumulativeWeight(double Weight) const
+{
+	if (Tiles.IsEmpty())
+	{
+		return INDEX_NONE;
+	}
+
+	// find the last tile that starts at or before the weight, skipping any empty ranges of zero weight tiles
+	const int32 TileId = Algo::UpperBound(TileWeightPrefixSums, Weight) - 1;
+	return FMath::Clamp(TileId, 0, Tiles.Num() - 1);
+}
+
 FString UWFCModel::GetTileDebugString(FWFCTileId TileId) const
 {
 	return FString::Printf(TEXT("Tile %d"), TileId);
 }
+
+void UWFCModel::AppendContentHash(FXxHash64Builder& Builder, int32 NumDirections) const
+{
+	const FString ClassPath = GetClass()->GetPathName();
+	Builder.Update(*ClassPath, ClassPath.Len() * sizeof(TCHAR));
+
+	const int32 NumTiles = Tiles.Num();
+	Builder.Update(&NumTiles, sizeof(NumTiles));
+	Builder.Update(TileWeights.GetData(), TileWeights.Num() * TileWeights.GetTypeSize());
+}
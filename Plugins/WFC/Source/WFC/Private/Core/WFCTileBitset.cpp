@@ -0,0 +1,148 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+
+#include "Core/WFCTileBitset.h"
+
+
+void FWFCTileBitset::Init(int32 InNumBits, bool bValue)
+{
+	check(InNumBits >= 0);
+	NumBits = InNumBits;
+	Words.Init(bValue ? ~0ull : 0ull, GetNumWordsForBits(NumBits));
+	ClearUnusedBits();
+	NumSet = bValue ? NumBits : 0;
+}
+
+void FWFCTileBitset::Reset()
+{
+	FMemory::Memzero(Words.GetData(), Words.Num() * sizeof(uint64));
+	NumSet = 0;
+}
+
+void FWFCTileBitset::SetAll()
+{
+	FMemory::Memset(Words.GetData(), 0xFF, Words.Num() * sizeof(uint64));
+	ClearUnusedBits();
+	NumSet = NumBits;
+}
+
+int32 FWFCTileBitset::UnionWith(const FWFCTileBitset& Other)
+{
+	check(Other.NumBits == NumBits);
+	const int32 PrevNumSet = NumSet;
+	int32 NewNumSet = 0;
+	for (int32 Idx = 0; Idx < Words.Num(); ++Idx)
+	{
+		Words[Idx] |= Other.Words[Idx];
+		NewNumSet += FMath::CountBits(Words[Idx]);
+	}
+	NumSet = NewNumSet;
+	return NumSet - PrevNumSet;
+}
+
+int32 FWFCTileBitset::IntersectWith(const FWFCTileBitset& Other)
+{
+	check(Other.NumBits == NumBits);
+	const int32 PrevNumSet = NumSet;
+	int32 NewNumSet = 0;
+	for (int32 Idx = 0; Idx < Words.Num(); ++Idx)
+	{
+		Words[Idx] &= Other.Words[Idx];
+		NewNumSet += FMath::CountBits(Words[Idx]);
+	}
+	NumSet = NewNumSet;
+	return PrevNumSet - NumSet;
+}
+
+int32 FWFCTileBitset::Subtract(const FWFCTileBitset& Other)
+{
+	check(Other.NumBits == NumBits);
+	const int32 PrevNumSet = NumSet;
+	int32 NewNumSet = 0;
+	for (int32 Idx = 0; Idx < Words.Num(); ++Idx)
+	{
+		Words[Idx] &= ~Other.Words[Idx];
+		NewNumSet += FMath::CountBits(Words[Idx]);
+	}
+	NumSet = NewNumSet;
+	return PrevNumSet - NumSet;
+}
+
+bool FWFCTileBitset::Intersects(const FWFCTileBitset& Other) const
+{
+	check(Other.NumBits == NumBits);
+	for (int32 Idx = 0; Idx < Words.Num(); ++Idx)
+	{
+		if ((Words[Idx] & Other.Words[Idx]) != 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+int32 FWFCTileBitset::GetFirst() const
+{
+	for (int32 Idx = 0; Idx < Words.Num(); ++Idx)
+	{
+		if (Words[Idx] != 0)
+		{
+			return Idx * BitsPerWord + FMath::CountTrailingZeros64(Words[Idx]);
+		}
+	}
+	return INDEX_NONE;
+}
+
+int32 FWFCTileBitset::GetNth(int32 N) const
+{
+	if (N < 0 || N >= NumSet)
+	{
+		return INDEX_NONE;
+	}
+
+	// skip whole words until the word containing the Nth bit is found
+	for (int32 Idx = 0; Idx < Words.Num(); ++Idx)
+	{
+		uint64 Word = Words[Idx];
+		const int32 WordCount = FMath::CountBits(Word);
+		if (N >= WordCount)
+		{
+			N -= WordCount;
+			continue;
+		}
+
+		for (; N > 0; --N)
+		{
+			Word &= Word - 1;
+		}
+		return Idx * BitsPerWord + FMath::CountTrailingZeros64(Word);
+	}
+	return INDEX_NONE;
+}
+
+void FWFCTileBitset::ToArray(TArray<int32>& OutTileIds) const
+{
+	OutTileIds.Reset(NumSet);
+	for (const int32 TileId : *this)
+	{
+		OutTileIds.Add(TileId);
+	}
+}
+
+void FWFCTileBitset::RecountBits()
+{
+	NumSet = 0;
+	for (const uint64 Word : Words)
+	{
+		NumSet += FMath::CountBits(Word);
+	}
+}
+
+void FWFCTileBitset::ClearUnusedBits()
+{
+	const int32 NumUsedBitsInLastWord = NumBits % BitsPerWord;
+	if (NumUsedBitsInLastWord != 0 && Words.Num() > 0)
+	{
+		Words.Last() &= (1ull << NumUsedBitsInLastWord) - 1;
+	}
+}
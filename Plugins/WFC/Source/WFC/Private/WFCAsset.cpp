@@ -7,6 +7,7 @@
 #include "WFCStatics.h"
 #include "WFCTileSet.h"
 #include "Core/WFCCellSelector.h"
+#include "Core/WFCCompiledModel.h"
 #include "Core/WFCGenerator.h"
 #include "Misc/DataValidation.h"
 #include "UObject/ObjectSaveContext.h"
@@ -16,6 +17,12 @@
 
 
 UWFCAsset::UWFCAsset()
+	: MaxBacktracks(0),
+	  MaxRestarts(0),
+	  bOverrideArcPropagationMode(false),
+	  ArcPropagationMode(EWFCArcPropagationMode::SupportCounts),
+	  bOverrideArcResidueMemoryBudget(false),
+	  ArcResidueMemoryBudgetMB(64)
 {
 	GeneratorClass = UWFCGenerator::StaticClass();
 	CellSelectorClasses = {UWFCRandomCellSelector::StaticClass()};
@@ -41,6 +48,9 @@ void UWFCAsset::PreSave(FObjectPreSaveContext SaveContext)
 			return TileSetA.GetName() < TileSetB.GetName();
 		});
 	}
+
+	// tiles may have changed since the last save, and cooked assets must always have an up to date compiled model
+	RebuildCompiledModel();
 }
 
 EDataValidationResult UWFCAsset::IsDataValid(FDataValidationContext& Context)
@@ -77,6 +87,43 @@ void UWFCAsset::UpdateSnapshot()
 	StartupSnapshot = Generator->CreateSnapshot(this);
 	Modify();
 }
+
+void UWFCAsset::UpdateCompiledModel()
+{
+	Modify();
+	RebuildCompiledModel();
+}
+
+void UWFCAsset::RebuildCompiledModel()
+{
+	if (!GridConfig || TileSets.IsEmpty())
+	{
+		// nothing to compile yet
+		CompiledModel = nullptr;
+		return;
+	}
+
+	UWFCGenerator* Generator = UWFCStatics::CreateWFCGenerator(GetTransientPackage(), this);
+	if (!Generator)
+	{
+		return;
+	}
+
+	// compile from scratch, not from the current compiled model
+	Generator->Config.CompiledModel = nullptr;
+	Generator->Initialize();
+
+	if (Generator->State == EWFCGeneratorState::Error)
+	{
+		return;
+	}
+
+	if (!CompiledModel)
+	{
+		CompiledModel = NewObject<UWFCCompiledModel>(this);
+	}
+	CompiledModel->Compile(Generator);
+}
 #endif
 
 #undef LOCTEXT_NAMESPACE
@@ -8,6 +8,7 @@
 #include "WFCTileAsset.h"
 #include "WFCTileSet.h"
 #include "WFCTileSetConfig.h"
+#include "Hash/xxhash.h"
 #include "Stats/StatsMisc.h"
 
 
@@ -172,6 +173,43 @@ FString UWFCAssetModel::GetTileDebugString(FWFCTileId TileId) const
 	return Super::GetTileDebugString(TileId);
 }
 
+void UWFCAssetModel::AppendContentHash(FXxHash64Builder& Builder, int32 NumDirections) const
+{
+	Super::AppendContentHash(Builder, NumDirections);
+
+	const auto AppendString = [&Builder](const FString& String)
+	{
+		Builder.Update(*String, String.Len() * sizeof(TCHAR));
+	};
+
+	// edges of every tile def in local space, which tiles reference along with their rotation
+	TArray<UWFCTileAsset*> TileAssets;
+	GetAllTileAssets(TileAssets);
+	for (const UWFCTileAsset* TileAsset : TileAssets)
+	{
+		AppendString(TileAsset->GetPathName());
+		for (int32 TileDefIdx = 0; TileDefIdx < TileAsset->GetNumTileDefs(); ++TileDefIdx)
+		{
+			for (FWFCGridDirection Direction = 0; Direction < NumDirections; ++Direction)
+			{
+				const int32 NeighborDefIdx = TileAsset->IsInteriorEdge(TileDefIdx, Direction)
+					                             ? TileAsset->GetTileDefInDirection(TileDefIdx, Direction)
+					                             : INDEX_NONE;
+				Builder.Update(&NeighborDefIdx, sizeof(NeighborDefIdx));
+				AppendString(TileAsset->GetTileDefEdgeType(TileDefIdx, Direction).ToString());
+			}
+		}
+	}
+
+	for (const TSharedPtr<FWFCModelTile>& Tile : GetTiles())
+	{
+		const FWFCModelAssetTile* AssetTile = static_cast<FWFCModelAssetTile*>(Tile.Get());
+		const int32 TileAssetIndex = TileAssets.IndexOfByKey(AssetTile->TileAsset.Get());
+		const int32 TileValues[] = {TileAssetIndex, AssetTile->TileDefIndex, AssetTile->Rotation};
+		Builder.Update(TileValues, sizeof(TileValues));
+	}
+}
+
 void UWFCAssetModel::CacheAssetTileLookup()
 {
 	TArray<UWFCTileAsset*> TileAssets;
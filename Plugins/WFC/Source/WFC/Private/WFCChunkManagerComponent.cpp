@@ -0,0 +1,559 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+
+#include "WFCChunkManagerComponent.h"
+
+#include "WFCAsset.h"
+#include "WFCModule.h"
+#include "WFCStatics.h"
+#include "Core/WFCGenerator.h"
+#include "Core/WFCModel.h"
+#include "Core/Constraints/WFCBoundaryConstraint.h"
+#include "Core/Constraints/WFCFixedTileConstraint.h"
+#include "Core/Grids/WFCGrid2D.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/PlayerController.h"
+#include "UObject/StrongObjectPtr.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Chunks - Loaded"), STAT_WFCChunksLoaded, STATGROUP_WFC);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Chunks - Generating"), STAT_WFCChunksGenerating, STATGROUP_WFC);
+
+
+/**
+ * State shared between a chunk manager and the worker thread generating a chunk.
+ * The shared model and grid config are referenced by the chunk manager, which waits for all workers before ending play.
+ */
+struct FWFCChunkGenerationState
+{
+	TStrongObjectPtr<UWFCGenerator> Generator;
+
+	std::atomic<bool> bCancelRequested = false;
+
+	/** Set by the worker thread once it no longer accesses the generator. */
+	std::atomic<bool> bIsComplete = false;
+};
+
+
+UWFCChunkManagerComponent::UWFCChunkManagerComponent()
+	: StepLimit(100000),
+	  Seed(0),
+	  GenerationRadius(2),
+	  EvictionRadius(4),
+	  MaxChunkRetries(3),
+	  ChunkRetryDelay(1.f),
+	  MaxConcurrentChunks(2),
+	  bUsePlayerStreamingSources(true),
+	  ChunkSize(FIntPoint::ZeroValue)
+{
+	PrimaryComponentTick.bCanEverTick = true;
+}
+
+void UWFCChunkManagerComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (!InitializeChunks())
+	{
+		SetComponentTickEnabled(false);
+	}
+}
+
+void UWFCChunkManagerComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	ResetChunks();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UWFCChunkManagerComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (!StartupSnapshot)
+	{
+		return;
+	}
+
+	TArray<FIntPoint> SourceChunkCoords;
+	GetStreamingSourceChunkCoords(SourceChunkCoords);
+
+	EvictDistantChunks(SourceChunkCoords);
+	FinishGeneratedChunks();
+	StartChunksNearSources(SourceChunkCoords);
+}
+
+bool UWFCChunkManagerComponent::InitializeChunks()
+{
+	if (!WFCAsset || !WFCAsset->ModelClass)
+	{
+		UE_LOG(LogWFC, Warning, TEXT("No WFCAsset or ModelClass was specified: %s"), *GetNameSafe(GetOwner()));
+		return false;
+	}
+
+	const UWFCGrid2DConfig* GridConfig = Cast<UWFCGrid2DConfig>(WFCAsset->GridConfig);
+	if (!GridConfig)
+	{
+		UE_LOG(LogWFC, Error, TEXT("WFCChunkManagerComponent requires a UWFCGrid2DConfig: %s"), *GetNameSafe(WFCAsset));
+		return false;
+	}
+
+	if (GenerationRadius > EvictionRadius)
+	{
+		// chunks would be evicted as soon as they are generated, and then generated again
+		UE_LOG(LogWFC, Warning, TEXT("WFCChunkManagerComponent EvictionRadius (%d) is less than GenerationRadius (%d), ")
+		       TEXT("GenerationRadius will be used instead: %s"), EvictionRadius, GenerationRadius, *GetNameSafe(GetOwner()));
+	}
+
+	SCOPE_LOG_TIME_FUNC();
+
+	ChunkSize = GridConfig->Dimensions;
+	ChunkGrid = Cast<UWFCGrid2D>(UWFCGrid::NewGrid(this, GridConfig));
+
+	PaddedGridConfig = DuplicateObject<UWFCGrid2DConfig>(GridConfig, this);
+	PaddedGridConfig->Dimensions = ChunkSize + FIntPoint(2, 2);
+
+	Model = NewObject<UWFCModel>(this, WFCAsset->ModelClass);
+	Model->Initialize(WFCAsset);
+
+	// run startup once for an empty chunk, so that every chunk can start from it and share its adjacency
+	UWFCGenerator* Generator = UWFCStatics::CreateWFCGeneratorWithModel(this, WFCAsset, Model, Seed);
+	if (!Generator)
+	{
+		return false;
+	}
+
+	ConfigureChunkGenerator(Generator);
+
+	Generator->Initialize();
+	Generator->RunStartup();
+	if (Generator->State == EWFCGeneratorState::Error)
+	{
+		UE_LOG(LogWFC, Error, TEXT("WFCChunkManagerComponent failed to run startup for an empty chunk: %s"), *GetNameSafe(WFCAsset));
+		return false;
+	}
+
+	StartupSnapshot = Generator->CreateSnapshot(this);
+	return true;
+}
+
+void UWFCChunkManagerComponent::ConfigureChunkGenerator(UWFCGenerator* Generator) const
+{
+	FWFCGeneratorConfig Config = Generator->Config;
+	Config.GridConfig = PaddedGridConfig;
+
+	// the padding cells are inside neighboring chunks, so the boundary constraint would ban seam tiles from them
+	Config.ConstraintClasses.RemoveAll([](const TSubclassOf<UWFCConstraint>& ConstraintClass)
+	{
+		return ConstraintClass && ConstraintClass->IsChildOf<UWFCBoundaryConstraint>();
+	});
+	Config.ConstraintClasses.Insert(UWFCChunkSeamConstraint::StaticClass(), 0);
+	Generator->Configure(Config);
+}
+
+void UWFCChunkManagerComponent::AddStreamingSource(AActor* Actor)
+{
+	if (Actor)
+	{
+		StreamingSources.AddUnique(Actor);
+	}
+}
+
+void UWFCChunkManagerComponent::RemoveStreamingSource(AActor* Actor)
+{
+	StreamingSources.Remove(Actor);
+}
+
+void UWFCChunkManagerComponent::ResetChunks()
+{
+	TArray<FIntPoint> ChunkCoords;
+	Chunks.GetKeys(ChunkCoords);
+	for (const FIntPoint& ChunkCoord : ChunkCoords)
+	{
+		EvictChunk(ChunkCoord);
+	}
+}
+
+FIntPoint UWFCChunkManagerComponent::GetChunkCoordForLocation(FVector WorldLocation) const
+{
+	if (!ChunkGrid)
+	{
+		return FIntPoint::ZeroValue;
+	}
+
+	const FVector LocalLocation = GetComponentTransform().InverseTransformPosition(WorldLocation);
+	const FIntPoint CellCoord(FMath::FloorToInt32(LocalLocation.X / ChunkGrid->CellSize.X),
+	                          FMath::FloorToInt32(LocalLocation.Y / ChunkGrid->CellSize.Y));
+	return GetChunkCoordForCell(CellCoord);
+}
+
+FIntPoint UWFCChunkManagerComponent::GetChunkCoordForCell(FIntPoint CellCoord) const
+{
+	if (ChunkSize.X <= 0 || ChunkSize.Y <= 0)
+	{
+		return FIntPoint::ZeroValue;
+	}
+
+	// round towards negative infinity, so that negative cells belong to negative chunks
+	return FIntPoint(FMath::FloorToInt32(static_cast<double>(CellCoord.X) / ChunkSize.X),
+	                 FMath::FloorToInt32(static_cast<double>(CellCoord.Y) / ChunkSize.Y));
+}
+
+EWFCChunkState UWFCChunkManagerComponent::GetChunkState(FIntPoint ChunkCoord) const
+{
+	const FWFCChunk* Chunk = Chunks.Find(ChunkCoord);
+	return Chunk ? Chunk->State : EWFCChunkState::None;
+}
+
+void UWFCChunkManagerComponent::GetChunkTileIds(FIntPoint ChunkCoord, TArray<int32>& OutTileIds) const
+{
+	const FWFCChunk* Chunk = Chunks.Find(ChunkCoord);
+	if (Chunk && Chunk->State == EWFCChunkState::Generated)
+	{
+		OutTileIds = Chunk->TileIds;
+	}
+	else
+	{
+		OutTileIds.Reset();
+	}
+}
+
+int32 UWFCChunkManagerComponent::GetTileIdForCell(FIntPoint CellCoord) const
+{
+	const FIntPoint ChunkCoord = GetChunkCoordForCell(CellCoord);
+	const FWFCChunk* Chunk = Chunks.Find(ChunkCoord);
+	if (!Chunk || Chunk->State != EWFCChunkState::Generated)
+	{
+		return INDEX_NONE;
+	}
+
+	const FIntPoint LocalCoord = CellCoord - ChunkCoord * ChunkSize;
+	return Chunk->TileIds[LocalCoord.X + LocalCoord.Y * ChunkSize.X];
+}
+
+FTransform UWFCChunkManagerComponent::GetCellWorldTransform(FIntPoint CellCoord, int32 Rotation) const
+{
+	if (!ChunkGrid)
+	{
+		return GetComponentTransform();
+	}
+
+	FTransform Result = ChunkGrid->GetRotationTransform(Rotation);
+	Result.AddToTranslation(FVector(CellCoord) * FVector(ChunkGrid->CellSize.X, ChunkGrid->CellSize.Y, 0));
+	return Result * GetComponentTransform();
+}
+
+int32 UWFCChunkManagerComponent::GetNumGeneratingChunks() const
+{
+	int32 NumGenerating = 0;
+	for (const TPair<FIntPoint, FWFCChunk>& Pair : Chunks)
+	{
+		if (Pair.Value.State == EWFCChunkState::Generating)
+		{
+			++NumGenerating;
+		}
+	}
+	return NumGenerating;
+}
+
+void UWFCChunkManagerComponent::GetStreamingSourceChunkCoords(TArray<FIntPoint>& OutChunkCoords) const
+{
+	OutChunkCoords.Reset();
+
+	if (bUsePlayerStreamingSources)
+	{
+		for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+		{
+			if (const APlayerController* PlayerController = It->Get())
+			{
+				FVector ViewLocation;
+				FRotator ViewRotation;
+				PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+				OutChunkCoords.AddUnique(GetChunkCoordForLocation(ViewLocation));
+			}
+		}
+	}
+
+	for (const TWeakObjectPtr<AActor>& StreamingSource : StreamingSources)
+	{
+		if (const AActor* Actor = StreamingSource.Get())
+		{
+			OutChunkCoords.AddUnique(GetChunkCoordForLocation(Actor->GetActorLocation()));
+		}
+	}
+}
+
+void UWFCChunkManagerComponent::EvictDistantChunks(const TArray<FIntPoint>& SourceChunkCoords)
+{
+	TArray<FIntPoint> ChunksToEvict;
+	for (const TPair<FIntPoint, FWFCChunk>& Pair : Chunks)
+	{
+		const bool bIsNearSource = SourceChunkCoords.ContainsByPredicate([&](const FIntPoint& SourceChunkCoord)
+		{
+			return GetChunkDistance(Pair.Key, SourceChunkCoord) <= GetEffectiveEvictionRadius();
+		});
+
+		if (!bIsNearSource)
+		{
+			ChunksToEvict.Add(Pair.Key);
+		}
+	}
+
+	for (const FIntPoint& ChunkCoord : ChunksToEvict)
+	{
+		EvictChunk(ChunkCoord);
+	}
+}
+
+void UWFCChunkManagerComponent::EvictChunk(FIntPoint ChunkCoord)
+{
+	FWFCChunk* Chunk = Chunks.Find(ChunkCoord);
+	if (!Chunk)
+	{
+		return;
+	}
+
+	if (Chunk->GenerationState.IsValid())
+	{
+		Chunk->GenerationState->bCancelRequested = true;
+		Chunk->Task.Wait();
+		if (UWFCGenerator* Generator = Chunk->GenerationState->Generator.Get())
+		{
+			Generator->PostAsyncRun();
+		}
+		DEC_DWORD_STAT(STAT_WFCChunksGenerating);
+	}
+
+	if (Chunk->State != EWFCChunkState::Generating)
+	{
+		OnChunkEvictedEvent.Broadcast(ChunkCoord);
+		OnChunkEvictedEvent_BP.Broadcast(ChunkCoord);
+	}
+
+	Chunks.Remove(ChunkCoord);
+	DEC_DWORD_STAT(STAT_WFCChunksLoaded);
+}
+
+void UWFCChunkManagerComponent::FinishGeneratedChunks()
+{
+	TArray<FIntPoint> FinishedChunkCoords;
+	for (TPair<FIntPoint, FWFCChunk>& Pair : Chunks)
+	{
+		FWFCChunk& Chunk = Pair.Value;
+		if (!Chunk.GenerationState.IsValid() || !Chunk.GenerationState->bIsComplete)
+		{
+			continue;
+		}
+
+		UWFCGenerator* Generator = Chunk.GenerationState->Generator.Get();
+		Generator->PostAsyncRun();
+
+		if (Generator->State == EWFCGeneratorState::Finished)
+		{
+			// keep only the tiles inside the padding, the generator itself is released
+			Chunk.TileIds.SetNumUninitialized(ChunkSize.X * ChunkSize.Y);
+			const UWFCGrid2D* Grid = CastChecked<UWFCGrid2D>(Generator->GetGrid());
+			for (int32 Y = 0; Y < ChunkSize.Y; ++Y)
+			{
+				for (int32 X = 0; X < ChunkSize.X; ++X)
+				{
+					const FWFCCell& Cell = Generator->GetCell(Grid->GetCellIndexForLocation(FIntPoint(X + 1, Y + 1)));
+					Chunk.TileIds[X + Y * ChunkSize.X] = Cell.GetSelectedTileId();
+				}
+			}
+			Chunk.State = EWFCChunkState::Generated;
+		}
+		else
+		{
+			Chunk.State = EWFCChunkState::Failed;
+			++Chunk.NumFailures;
+			if (Chunk.NumFailures <= MaxChunkRetries)
+			{
+				// neighbors may also be generated in the meantime, which changes the seams
+				const double Delay = ChunkRetryDelay * static_cast<double>(1ll << FMath::Min(Chunk.NumFailures - 1, 30));
+				Chunk.RetryTime = GetWorld()->GetTimeSeconds() + Delay;
+				UE_LOG(LogWFC, Warning, TEXT("Failed to generate chunk %s with seed %d, retrying in %.2fs (%d/%d): %s"),
+				       *Pair.Key.ToString(), Generator->GetSeed(), Delay, Chunk.NumFailures, MaxChunkRetries, *GetNameSafe(GetOwner()));
+			}
+			else
+			{
+				UE_LOG(LogWFC, Warning, TEXT("Failed to generate chunk %s with seed %d, after %d retries: %s"),
+				       *Pair.Key.ToString(), Generator->GetSeed(), MaxChunkRetries, *GetNameSafe(GetOwner()));
+			}
+		}
+
+		Chunk.GenerationState.Reset();
+		Chunk.Task = UE::Tasks::FTask();
+		DEC_DWORD_STAT(STAT_WFCChunksGenerating);
+
+		FinishedChunkCoords.Add(Pair.Key);
+	}
+
+	// broadcast after the loop, since handlers may access other chunks
+	for (const FIntPoint& ChunkCoord : FinishedChunkCoords)
+	{
+		const bool bSuccess = GetChunkState(ChunkCoord) == EWFCChunkState::Generated;
+		OnChunkGeneratedEvent.Broadcast(ChunkCoord, bSuccess);
+		OnChunkGeneratedEvent_BP.Broadcast(ChunkCoord, bSuccess);
+	}
+}
+
+void UWFCChunkManagerComponent::StartChunksNearSources(const TArray<FIntPoint>& SourceChunkCoords)
+{
+	int32 NumToStart = MaxConcurrentChunks - GetNumGeneratingChunks();
+	if (NumToStart <= 0)
+	{
+		return;
+	}
+
+	// gather missing chunks, nearest to a source first
+	TArray<TPair<int32, FIntPoint>> MissingChunks;
+	for (const FIntPoint& SourceChunkCoord : SourceChunkCoords)
+	{
+		for (int32 Y = -GenerationRadius; Y <= GenerationRadius; ++Y)
+		{
+			for (int32 X = -GenerationRadius; X <= GenerationRadius; ++X)
+			{
+				const FIntPoint ChunkCoord = SourceChunkCoord + FIntPoint(X, Y);
+				const FWFCChunk* Chunk = Chunks.Find(ChunkCoord);
+				if (!Chunk || CanRetryChunk(*Chunk))
+				{
+					MissingChunks.Emplace(GetChunkDistance(ChunkCoord, SourceChunkCoord), ChunkCoord);
+				}
+			}
+		}
+	}
+
+	MissingChunks.Sort([](const TPair<int32, FIntPoint>& A, const TPair<int32, FIntPoint>& B)
+	{
+		return A.Key < B.Key;
+	});
+
+	for (const TPair<int32, FIntPoint>& MissingChunk : MissingChunks)
+	{
+		if (NumToStart <= 0)
+		{
+			break;
+		}
+
+		// sources close to each other may request the same chunk
+		if (CanStartChunk(MissingChunk.Value))
+		{
+			StartChunk(MissingChunk.Value);
+			--NumToStart;
+		}
+	}
+}
+
+bool UWFCChunkManagerComponent::CanStartChunk(FIntPoint ChunkCoord) const
+{
+	const FWFCChunk* Chunk = Chunks.Find(ChunkCoord);
+	if (Chunk && !CanRetryChunk(*Chunk))
+	{
+		return false;
+	}
+
+	// a neighbor that is still generating has no seams yet, so both would be generated without matching
+	for (int32 Y = -1; Y <= 1; ++Y)
+	{
+		for (int32 X = -1; X <= 1; ++X)
+		{
+			if (GetChunkState(ChunkCoord + FIntPoint(X, Y)) == EWFCChunkState::Generating)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool UWFCChunkManagerComponent::CanRetryChunk(const FWFCChunk& Chunk) const
+{
+	return Chunk.State == EWFCChunkState::Failed && Chunk.NumFailures <= MaxChunkRetries &&
+		GetWorld()->GetTimeSeconds() >= Chunk.RetryTime;
+}
+
+void UWFCChunkManagerComponent::StartChunk(FIntPoint ChunkCoord)
+{
+	const FWFCChunk* FailedChunk = Chunks.Find(ChunkCoord);
+	const int32 NumFailures = FailedChunk ? FailedChunk->NumFailures : 0;
+
+	UWFCGenerator* Generator = UWFCStatics::CreateWFCGeneratorWithModel(this, WFCAsset, Model, GetChunkSeed(ChunkCoord, NumFailures));
+	check(Generator != nullptr);
+
+	ConfigureChunkGenerator(Generator);
+
+	// initialization creates objects, so it must happen on the game thread before the run starts
+	Generator->Initialize(false);
+	Generator->ApplySnapshot(StartupSnapshot);
+	Generator->InitializeConstraints();
+	AddSeamTiles(ChunkCoord, Generator);
+
+	if (!FailedChunk)
+	{
+		INC_DWORD_STAT(STAT_WFCChunksLoaded);
+	}
+
+	FWFCChunk& Chunk = Chunks.FindOrAdd(ChunkCoord);
+	Chunk.State = EWFCChunkState::Generating;
+	Chunk.GenerationState = MakeShared<FWFCChunkGenerationState>();
+	Chunk.GenerationState->Generator.Reset(Generator);
+	INC_DWORD_STAT(STAT_WFCChunksGenerating);
+
+	Chunk.Task = UE::Tasks::Launch(UE_SOURCE_LOCATION, [GenerationState = Chunk.GenerationState, RunStepLimit = StepLimit]()
+	{
+		UWFCGenerator* RunGenerator = GenerationState->Generator.Get();
+		for (int32 Step = 0; Step < RunStepLimit && !GenerationState->bCancelRequested; ++Step)
+		{
+			RunGenerator->Next();
+
+			if (RunGenerator->State != EWFCGeneratorState::InProgress &&
+				RunGenerator->State != EWFCGeneratorState::None)
+			{
+				break;
+			}
+		}
+
+		GenerationState->bIsComplete = true;
+	});
+}
+
+void UWFCChunkManagerComponent::AddSeamTiles(FIntPoint ChunkCoord, UWFCGenerator* Generator) const
+{
+	UWFCChunkSeamConstraint* SeamConstraint = Generator->GetConstraint<UWFCChunkSeamConstraint>();
+	const UWFCGrid2D* Grid = Cast<UWFCGrid2D>(Generator->GetGrid());
+	if (!SeamConstraint || !Grid)
+	{
+		return;
+	}
+
+	// padding cells are the edge cells of neighboring chunks
+	const FIntPoint PaddedOrigin = ChunkCoord * ChunkSize - FIntPoint(1, 1);
+	for (int32 CellIndex = 0; CellIndex < Grid->GetNumCells(); ++CellIndex)
+	{
+		const FIntPoint PaddedLocation = Grid->GetLocationForCellIndex(CellIndex);
+		const bool bIsPadding = PaddedLocation.X == 0 || PaddedLocation.Y == 0 ||
+			PaddedLocation.X == Grid->Dimensions.X - 1 || PaddedLocation.Y == Grid->Dimensions.Y - 1;
+		if (!bIsPadding)
+		{
+			continue;
+		}
+
+		const FWFCTileId TileId = GetTileIdForCell(PaddedOrigin + PaddedLocation);
+		if (TileId != INDEX_NONE)
+		{
+			SeamConstraint->AddFixedTileMapping(CellIndex, TileId);
+		}
+	}
+}
+
+int32 UWFCChunkManagerComponent::GetChunkSeed(FIntPoint ChunkCoord, int32 NumFailures) const
+{
+	const uint32 ChunkSeed = HashCombineFast(GetTypeHash(ChunkCoord), static_cast<uint32>(Seed));
+	return static_cast<int32>(NumFailures > 0 ? HashCombineFast(ChunkSeed, static_cast<uint32>(NumFailures)) : ChunkSeed);
+}
+
+int32 UWFCChunkManagerComponent::GetChunkDistance(FIntPoint A, FIntPoint B)
+{
+	return FMath::Max(FMath::Abs(A.X - B.X), FMath::Abs(A.Y - B.Y));
+}
@@ -0,0 +1,10 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+#include "WFCCustomVersion.h"
+
+#include "Serialization/CustomVersion.h"
+
+
+const FGuid FWFCCustomVersion::GUID(0x7C1D2A46, 0x3B8E4F19, 0x9A5C6E02, 0xD4F8B731);
+
+FCustomVersionRegistration GRegisterWFCCustomVersion(FWFCCustomVersion::GUID, FWFCCustomVersion::LatestVersion, TEXT("WFCVer"));
@@ -5,19 +5,72 @@
 
 #include "WFCAsset.h"
 #include "WFCModule.h"
+#include "WFCRegionSolver.h"
 #include "WFCStatics.h"
 #include "Core/WFCGenerator.h"
 #include "Core/WFCGrid.h"
+#include "Core/WFCModel.h"
+#include "Containers/Queue.h"
 #include "GameFramework/Actor.h"
+#include "UObject/StrongObjectPtr.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Time Sliced Frames"), STAT_WFCTimeSlicedFrames, STATGROUP_WFC);
+
+
+/** An event broadcast by the generator on the worker thread during an async run. */
+struct FWFCGeneratorAsyncEvent
+{
+	/** The cell that was selected or unselected, or INDEX_NONE if this is a state change. */
+	int32 CellIndex = INDEX_NONE;
+
+	EWFCGeneratorState State = EWFCGeneratorState::None;
+
+	/** True if the cell was unselected instead of selected. */
+	bool bIsUnselected = false;
+};
+
+
+/**
+ * State shared between a generator component and the worker thread running its generator.
+ * Holds strong references to the generator, its model, and the asset, since the generator only weakly
+ * references its model and the component may be destroyed or change assets while the run is in flight.
+ * The generator's grid, constraints, and cell selectors are referenced by the generator itself.
+ */
+struct FWFCGeneratorAsyncRunState
+{
+	TStrongObjectPtr<UWFCGenerator> Generator;
+	TStrongObjectPtr<UWFCModel> Model;
+	TStrongObjectPtr<UWFCAsset> Asset;
+
+	std::atomic<bool> bCancelRequested = false;
+
+	/** Set by the worker thread once it no longer accesses the generator. */
+	std::atomic<bool> bIsComplete = false;
+
+	std::atomic<float> Progress = 0.f;
+
+	/** When true, events are only dispatched once the run is complete, since selections may still be undone. */
+	bool bDeferEventsUntilComplete = false;
+
+	TQueue<FWFCGeneratorAsyncEvent, EQueueMode::Spsc> Events;
+};
 
 
 UWFCGeneratorComponent::UWFCGeneratorComponent()
 	: StepLimit(100000),
 	  bUseStartupSnapshot(true),
+	  bUseRandomSeed(true),
+	  Seed(0),
 	  bAutoRun(true),
+	  RunMode(EWFCGeneratorRunMode::Immediate),
+	  FrameBudgetMs(2.f),
+	  RegionSize(FIntPoint(32, 32)),
 	  StepGranularity(EWFCGeneratorStepGranularity::None),
 	  DebugGridColor(FLinearColor::White)
 {
+	// only ticks while running async or time sliced
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
 }
 
 void UWFCGeneratorComponent::BeginPlay()
@@ -30,6 +83,33 @@ void UWFCGeneratorComponent::BeginPlay()
 	}
 }
 
+void UWFCGeneratorComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (AsyncRunState.IsValid())
+	{
+		// wait for the worker to stop, but don't dispatch events to anything that is also ending play
+		AsyncRunState->bCancelRequested = true;
+		AsyncRunTask.Wait();
+		FinishAsyncRun();
+	}
+
+	bIsRunningTimeSliced = false;
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UWFCGeneratorComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	DispatchAsyncRunEvents();
+
+	if (bIsRunningTimeSliced)
+	{
+		TickTimeSlicedRun();
+	}
+}
+
 bool UWFCGeneratorComponent::Initialize(bool bForce)
 {
 	if (!bForce && IsInitialized())
@@ -44,13 +124,20 @@ bool UWFCGeneratorComponent::Initialize(bool bForce)
 		return false;
 	}
 
-	Generator = UWFCStatics::CreateWFCGenerator(this, WFCAsset);
+	// the current generator can't be replaced while it's running
+	CancelRun();
+
+	const int32 GeneratorSeed = bUseRandomSeed ? FMath::Rand() : Seed;
+	Generator = UWFCStatics::CreateWFCGenerator(this, WFCAsset, GeneratorSeed);
 	if (!Generator)
 	{
 		return false;
 	}
 
+	UE_LOG(LogWFC, Verbose, TEXT("Created WFCGenerator with seed %d: %s"), GeneratorSeed, *GetNameSafe(GetOwner()));
+
 	Generator->OnCellSelected.AddUObject(this, &UWFCGeneratorComponent::OnCellSelected);
+	Generator->OnCellUnselected.AddUObject(this, &UWFCGeneratorComponent::OnCellUnselected);
 	Generator->OnStateChanged.AddUObject(this, &UWFCGeneratorComponent::OnStateChanged);
 
 	Generator->Initialize(false);
@@ -77,6 +164,30 @@ void UWFCGeneratorComponent::ResetGenerator()
 
 void UWFCGeneratorComponent::Run()
 {
+	if (RunMode == EWFCGeneratorRunMode::Async)
+	{
+		RunAsync();
+		return;
+	}
+
+	if (RunMode == EWFCGeneratorRunMode::TimeSliced)
+	{
+		RunTimeSliced();
+		return;
+	}
+
+	if (RunMode == EWFCGeneratorRunMode::Regions)
+	{
+		RunRegions();
+		return;
+	}
+
+	if (IsRunningAsync() || bIsRunningTimeSliced)
+	{
+		UE_LOG(LogWFC, Warning, TEXT("WFCGenerator is already running: %s"), *GetNameSafe(GetOwner()));
+		return;
+	}
+
 	if (!IsInitialized())
 	{
 		Initialize();
@@ -88,8 +199,273 @@ void UWFCGeneratorComponent::Run()
 	}
 }
 
+void UWFCGeneratorComponent::RunAsync()
+{
+	if (IsRunningAsync() || bIsRunningTimeSliced)
+	{
+		UE_LOG(LogWFC, Warning, TEXT("WFCGenerator is already running: %s"), *GetNameSafe(GetOwner()));
+		return;
+	}
+
+	// initialization creates objects, so it must happen on the game thread before the run starts
+	if (!IsInitialized())
+	{
+		Initialize();
+	}
+
+	if (!IsInitialized())
+	{
+		return;
+	}
+
+	AsyncRunState = MakeShared<FWFCGeneratorAsyncRunState>();
+	AsyncRunState->Generator.Reset(Generator);
+	AsyncRunState->Model.Reset(Generator->Config.Model.Get());
+	AsyncRunState->Asset.Reset(WFCAsset);
+	AsyncRunState->bDeferEventsUntilComplete = Generator->Config.MaxBacktracks > 0 || Generator->Config.MaxRestarts > 0;
+
+	SetComponentTickEnabled(true);
+
+	UE_LOG(LogWFC, Verbose, TEXT("Running WFCGenerator async: %s"), *GetNameSafe(GetOwner()));
+
+	AsyncRunTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [RunState = AsyncRunState, RunStepLimit = StepLimit]()
+	{
+		UWFCGenerator* RunGenerator = RunState->Generator.Get();
+		const int32 NumCells = RunGenerator->GetNumCells();
+
+		for (int32 Step = 0; Step < RunStepLimit && !RunState->bCancelRequested; ++Step)
+		{
+			RunGenerator->Next();
+
+			RunState->Progress = NumCells > 0 ? static_cast<float>(RunGenerator->GetNumSelectedCells()) / NumCells : 1.f;
+
+			if (RunGenerator->State != EWFCGeneratorState::InProgress &&
+				RunGenerator->State != EWFCGeneratorState::None)
+			{
+				break;
+			}
+		}
+
+		RunState->bIsComplete = true;
+	});
+}
+
+void UWFCGeneratorComponent::RunTimeSliced()
+{
+	if (IsRunningAsync() || bIsRunningTimeSliced)
+	{
+		UE_LOG(LogWFC, Warning, TEXT("WFCGenerator is already running: %s"), *GetNameSafe(GetOwner()));
+		return;
+	}
+
+	if (!IsInitialized())
+	{
+		Initialize();
+	}
+
+	if (!IsInitialized())
+	{
+		return;
+	}
+
+	if (Generator->State != EWFCGeneratorState::InProgress && Generator->State != EWFCGeneratorState::None)
+	{
+		// there is nothing left to run, and no state change would ever end the run
+		UE_LOG(LogWFC, Warning, TEXT("WFCGenerator has already %s, it must be reset before running again: %s"),
+		       Generator->State == EWFCGeneratorState::Finished ? TEXT("finished") : TEXT("failed"), *GetNameSafe(GetOwner()));
+		return;
+	}
+
+	bIsRunningTimeSliced = true;
+	NumTimeSlicedFrames = 0;
+	NumTimeSlicedSteps = 0;
+	SET_DWORD_STAT(STAT_WFCTimeSlicedFrames, 0);
+
+	// the first slice runs during the next tick
+	SetComponentTickEnabled(true);
+}
+
+void UWFCGeneratorComponent::RunRegions()
+{
+	if (IsRunningAsync() || bIsRunningTimeSliced)
+	{
+		UE_LOG(LogWFC, Warning, TEXT("WFCGenerator is already running: %s"), *GetNameSafe(GetOwner()));
+		return;
+	}
+
+	if (!IsInitialized())
+	{
+		Initialize();
+	}
+
+	if (!IsInitialized())
+	{
+		return;
+	}
+
+	UWFCRegionSolver* RegionSolver = NewObject<UWFCRegionSolver>(this);
+	RegionSolver->RegionSize = RegionSize;
+	RegionSolver->Solve(Generator, StepLimit);
+}
+
+void UWFCGeneratorComponent::TickTimeSlicedRun()
+{
+	++NumTimeSlicedFrames;
+	INC_DWORD_STAT(STAT_WFCTimeSlicedFrames);
+
+	// break as often as possible within constraints, so that a slice doesn't overrun the budget by much
+	Generator->StepGranularity = EWFCGeneratorStepGranularity::ConstraintDetailed;
+
+	const double EndTime = FPlatformTime::Seconds() + FrameBudgetMs / 1000.0;
+	do
+	{
+		if (NumTimeSlicedSteps >= StepLimit)
+		{
+			UE_LOG(LogWFC, Warning, TEXT("WFCGenerator time sliced run reached the step limit (%d): %s"), StepLimit, *GetNameSafe(GetOwner()));
+			FinishTimeSlicedRun();
+			return;
+		}
+
+		Generator->Next();
+		++NumTimeSlicedSteps;
+
+		// the run is usually finished by the generator's state change, or by a handler cancelling it
+		if (!bIsRunningTimeSliced)
+		{
+			return;
+		}
+
+		// the generator may also stop without changing state, e.g. if it was already in an error state
+		if (Generator->State != EWFCGeneratorState::InProgress && Generator->State != EWFCGeneratorState::None)
+		{
+			FinishTimeSlicedRun();
+			return;
+		}
+	}
+	while (FPlatformTime::Seconds() < EndTime);
+}
+
+void UWFCGeneratorComponent::FinishTimeSlicedRun()
+{
+	UE_LOG(LogWFC, Verbose, TEXT("WFCGenerator time sliced run used %d frame(s): %s"), NumTimeSlicedFrames, *GetNameSafe(GetOwner()));
+
+	bIsRunningTimeSliced = false;
+	Generator->StepGranularity = StepGranularity;
+	if (!IsRunningAsync())
+	{
+		SetComponentTickEnabled(false);
+	}
+}
+
+void UWFCGeneratorComponent::CancelRun()
+{
+	if (bIsRunningTimeSliced)
+	{
+		FinishTimeSlicedRun();
+	}
+
+	if (!AsyncRunState.IsValid())
+	{
+		return;
+	}
+
+	AsyncRunState->bCancelRequested = true;
+	AsyncRunTask.Wait();
+
+	UE_LOG(LogWFC, Verbose, TEXT("Cancelled WFCGenerator async run: %s"), *GetNameSafe(GetOwner()));
+
+	// dispatch anything that happened before the run stopped
+	DispatchAsyncRunEvents();
+}
+
+bool UWFCGeneratorComponent::IsRunningAsync() const
+{
+	return AsyncRunState.IsValid();
+}
+
+float UWFCGeneratorComponent::GetProgress() const
+{
+	if (AsyncRunState.IsValid())
+	{
+		return AsyncRunState->Progress;
+	}
+
+	if (Generator && Generator->GetNumCells() > 0)
+	{
+		return static_cast<float>(Generator->GetNumSelectedCells()) / Generator->GetNumCells();
+	}
+	return 0.f;
+}
+
+void UWFCGeneratorComponent::DispatchAsyncRunEvents()
+{
+	// keep the state alive, since handlers may start or cancel another run
+	const TSharedPtr<FWFCGeneratorAsyncRunState> RunState = AsyncRunState;
+	if (!RunState.IsValid())
+	{
+		return;
+	}
+
+	// check for completion before draining, so that every event queued by the worker is dispatched
+	const bool bIsComplete = RunState->bIsComplete;
+	if (bIsComplete)
+	{
+		// finish first, so handlers of the final events see that the run is over
+		FinishAsyncRun();
+	}
+	else if (RunState->bDeferEventsUntilComplete)
+	{
+		return;
+	}
+
+	FWFCGeneratorAsyncEvent Event;
+	while (RunState->Events.Dequeue(Event))
+	{
+		if (Event.CellIndex != INDEX_NONE && Event.bIsUnselected)
+		{
+			OnCellUnselected(Event.CellIndex);
+		}
+		else if (Event.CellIndex != INDEX_NONE)
+		{
+			OnCellSelected(Event.CellIndex);
+		}
+		else
+		{
+			OnStateChanged(Event.State);
+		}
+	}
+}
+
+void UWFCGeneratorComponent::FinishAsyncRun()
+{
+	check(AsyncRunState.IsValid() && AsyncRunState->bIsComplete);
+
+	if (UWFCGenerator* RunGenerator = AsyncRunState->Generator.Get())
+	{
+		RunGenerator->PostAsyncRun();
+	}
+
+	// release references on the game thread, the task may still briefly hold on to the state itself
+	AsyncRunState->Generator.Reset();
+	AsyncRunState->Model.Reset();
+	AsyncRunState->Asset.Reset();
+	AsyncRunState.Reset();
+	AsyncRunTask = UE::Tasks::FTask();
+
+	if (!bIsRunningTimeSliced)
+	{
+		SetComponentTickEnabled(false);
+	}
+}
+
 void UWFCGeneratorComponent::Next()
 {
+	if (IsRunningAsync() || bIsRunningTimeSliced)
+	{
+		UE_LOG(LogWFC, Warning, TEXT("WFCGenerator is already running: %s"), *GetNameSafe(GetOwner()));
+		return;
+	}
+
 	if (!IsInitialized())
 	{
 		Initialize();
@@ -106,8 +482,17 @@ const UWFCGrid* UWFCGeneratorComponent::GetGrid() const
 	return Generator ? Generator->GetGrid() : nullptr;
 }
 
+int32 UWFCGeneratorComponent::GetGeneratorSeed() const
+{
+	return Generator ? Generator->GetSeed() : 0;
+}
+
 EWFCGeneratorState UWFCGeneratorComponent::GetState() const
 {
+	if (IsRunningAsync())
+	{
+		return EWFCGeneratorState::InProgress;
+	}
 	return Generator ? Generator->State : EWFCGeneratorState::None;
 }
 
@@ -128,7 +513,7 @@ void UWFCGeneratorComponent::GetSelectedTileId(int32 CellIndex, bool& bSuccess,
 
 void UWFCGeneratorComponent::GetSelectedTileIds(TArray<int32>& TileIds) const
 {
-	if (Generator)
+	if (Generator && !IsRunningAsync())
 	{
 		Generator->GetSelectedTileIds(TileIds);
 	}
@@ -140,12 +525,43 @@ void UWFCGeneratorComponent::GetSelectedTileIds(TArray<int32>& TileIds) const
 
 void UWFCGeneratorComponent::OnCellSelected(int32 CellIndex)
 {
+	if (!IsInGameThread())
+	{
+		// the game thread doesn't modify the run state while the worker is running
+		AsyncRunState->Events.Enqueue(FWFCGeneratorAsyncEvent{CellIndex, EWFCGeneratorState::InProgress});
+		return;
+	}
+
 	OnCellSelectedEvent.Broadcast(CellIndex);
 	OnCellSelectedEvent_BP.Broadcast(CellIndex);
 }
 
+void UWFCGeneratorComponent::OnCellUnselected(int32 CellIndex)
+{
+	if (!IsInGameThread())
+	{
+		AsyncRunState->Events.Enqueue(FWFCGeneratorAsyncEvent{CellIndex, EWFCGeneratorState::InProgress, true});
+		return;
+	}
+
+	OnCellUnselectedEvent.Broadcast(CellIndex);
+	OnCellUnselectedEvent_BP.Broadcast(CellIndex);
+}
+
 void UWFCGeneratorComponent::OnStateChanged(EWFCGeneratorState State)
 {
+	if (!IsInGameThread())
+	{
+		AsyncRunState->Events.Enqueue(FWFCGeneratorAsyncEvent{INDEX_NONE, State});
+		return;
+	}
+
+	if (bIsRunningTimeSliced && (State == EWFCGeneratorState::Finished || State == EWFCGeneratorState::Error))
+	{
+		// finish first, so handlers see that the run is over
+		FinishTimeSlicedRun();
+	}
+
 	OnStateChangedEvent_BP.Broadcast(State);
 
 	if (State == EWFCGeneratorState::Finished || State == EWFCGeneratorState::Error)
@@ -0,0 +1,134 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+
+#include "WFCPortfolioRunner.h"
+
+#include "WFCAsset.h"
+#include "WFCModule.h"
+#include "WFCStatics.h"
+#include "Core/WFCGenerator.h"
+#include "Core/WFCModel.h"
+#include "Tasks/Task.h"
+
+
+bool UWFCPortfolioRunner::Initialize(UWFCAsset* InWFCAsset, int32 NumGenerators, int32 Seed)
+{
+	check(IsInGameThread());
+
+	if (!InWFCAsset || !InWFCAsset->ModelClass)
+	{
+		UE_LOG(LogWFC, Warning, TEXT("No WFCAsset or ModelClass was specified for portfolio runner"));
+		return false;
+	}
+
+	SCOPE_LOG_TIME_FUNC();
+
+	WFCAsset = InWFCAsset;
+	Generators.Reset();
+	Winner = nullptr;
+
+	// tiles are generated once by the first generator, then reused by all others
+	Model = NewObject<UWFCModel>(this, WFCAsset->ModelClass);
+	Model->Initialize(WFCAsset);
+
+	const FRandomStream SeedStream(Seed);
+
+	// run startup once, then start every other generator from a snapshot of it
+	UWFCGenerator* FirstGenerator = UWFCStatics::CreateWFCGeneratorWithModel(this, WFCAsset, Model, SeedStream.GetUnsignedInt());
+	if (!FirstGenerator)
+	{
+		return false;
+	}
+
+	FirstGenerator->Initialize(false);
+	if (WFCAsset->StartupSnapshot)
+	{
+		FirstGenerator->ApplySnapshot(WFCAsset->StartupSnapshot);
+	}
+	FirstGenerator->InitializeConstraints();
+	FirstGenerator->RunStartup();
+	Generators.Add(FirstGenerator);
+
+	const UWFCGeneratorSnapshot* StartupSnapshot = FirstGenerator->CreateSnapshot(this);
+
+	for (int32 Idx = 1; Idx < NumGenerators; ++Idx)
+	{
+		UWFCGenerator* Generator = UWFCStatics::CreateWFCGeneratorWithModel(this, WFCAsset, Model, SeedStream.GetUnsignedInt());
+		if (!Generator)
+		{
+			// don't leave a partial portfolio that Run would use
+			Generators.Reset();
+			return false;
+		}
+
+		Generator->Initialize(false);
+		Generator->ApplySnapshot(StartupSnapshot);
+		Generator->InitializeConstraints();
+		Generators.Add(Generator);
+	}
+
+	return true;
+}
+
+UWFCGenerator* UWFCPortfolioRunner::Run(int32 StepLimit)
+{
+	check(IsInGameThread());
+
+	if (Generators.IsEmpty())
+	{
+		UE_LOG(LogWFC, Error, TEXT("Initialize must be called before Run on a WFCPortfolioRunner"));
+		return nullptr;
+	}
+
+	SCOPE_LOG_TIME(TEXT("UWFCPortfolioRunner::Run"), nullptr);
+
+	// the index of the first generator to finish, which also tells every other generator to stop
+	std::atomic<int32> WinnerIndex = INDEX_NONE;
+
+	TArray<UE::Tasks::FTask> Tasks;
+	Tasks.Reserve(Generators.Num());
+	for (int32 Idx = 0; Idx < Generators.Num(); ++Idx)
+	{
+		Tasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION, [Generator = Generators[Idx].Get(), Idx, StepLimit, &WinnerIndex]()
+		{
+			for (int32 Step = 0; Step < StepLimit && WinnerIndex.load(std::memory_order_relaxed) == INDEX_NONE; ++Step)
+			{
+				Generator->Next();
+
+				if (Generator->State == EWFCGeneratorState::Finished)
+				{
+					int32 Expected = INDEX_NONE;
+					WinnerIndex.compare_exchange_strong(Expected, Idx);
+					break;
+				}
+
+				if (Generator->State != EWFCGeneratorState::InProgress &&
+					Generator->State != EWFCGeneratorState::None)
+				{
+					break;
+				}
+			}
+		}));
+	}
+
+	// the game thread is blocked until all workers stop, so nothing can be garbage collected during the run
+	UE::Tasks::Wait(Tasks);
+
+	for (int32 Idx = 0; Idx < Generators.Num(); ++Idx)
+	{
+		UWFCGenerator* Generator = Generators[Idx];
+		Generator->PostAsyncRun();
+
+		UE_LOG(LogWFC, Verbose, TEXT("Portfolio generator %d (seed %d): %s, %d restart(s), %d backtrack(s)"),
+		       Idx, Generator->GetSeed(), *UEnum::GetValueAsString(Generator->State),
+		       Generator->GetNumRestarts(), Generator->GetNumBacktracks());
+	}
+
+	const int32 FinalWinnerIndex = WinnerIndex.load();
+	Winner = FinalWinnerIndex != INDEX_NONE ? Generators[FinalWinnerIndex].Get() : nullptr;
+	if (!Winner)
+	{
+		UE_LOG(LogWFC, Warning, TEXT("No generator finished out of %d in portfolio run: %s"), Generators.Num(), *GetNameSafe(WFCAsset));
+	}
+	return Winner;
+}
@@ -0,0 +1,225 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+
+#include "WFCRegionSolver.h"
+
+#include "WFCModule.h"
+#include "Core/WFCGenerator.h"
+#include "Core/Constraints/WFCBoundaryConstraint.h"
+#include "Core/Constraints/WFCFixedTileConstraint.h"
+#include "Core/Grids/WFCGrid2D.h"
+#include "Tasks/Task.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Region Solver - Regions"), STAT_WFCRegionSolverRegions, STATGROUP_WFC);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Region Solver - Failed Regions"), STAT_WFCRegionSolverFailedRegions, STATGROUP_WFC);
+
+
+UWFCRegionSolver::UWFCRegionSolver()
+	: RegionSize(FIntPoint(32, 32))
+{
+}
+
+bool UWFCRegionSolver::Solve(UWFCGenerator* Generator, int32 StepLimit)
+{
+	check(IsInGameThread());
+
+	if (!Generator || !Generator->IsInitialized())
+	{
+		UE_LOG(LogWFC, Error, TEXT("Solve must be called with an initialized WFCGenerator"));
+		return false;
+	}
+
+	const UWFCGrid2D* Grid = Cast<UWFCGrid2D>(Generator->GetGrid());
+	if (!Grid)
+	{
+		UE_LOG(LogWFC, Error, TEXT("UWFCRegionSolver requires a UWFCGrid2D: %s"), *Generator->GetName());
+		return false;
+	}
+
+	SCOPE_LOG_TIME(TEXT("UWFCRegionSolver::Solve"), nullptr);
+
+	// run startup constraints, then fix the seams so that regions can't conflict with each other
+	Generator->RunStartup(StepLimit);
+	SolveSeams(Generator, Grid, StepLimit);
+	if (Generator->State != EWFCGeneratorState::InProgress)
+	{
+		return Generator->State == EWFCGeneratorState::Finished;
+	}
+
+	TArray<FWFCSolverRegion> Regions;
+	CreateRegions(Grid->Dimensions, Regions);
+	SET_DWORD_STAT(STAT_WFCRegionSolverRegions, Regions.Num());
+
+	for (FWFCSolverRegion& Region : Regions)
+	{
+		Region.Generator = CreateRegionGenerator(Generator, Grid, Region);
+	}
+
+	// region generators don't share anything that changes, and the game thread is blocked until they are done
+	TArray<UE::Tasks::FTask> Tasks;
+	Tasks.Reserve(Regions.Num());
+	for (const FWFCSolverRegion& Region : Regions)
+	{
+		Tasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION, [RegionGenerator = Region.Generator, StepLimit]()
+		{
+			RegionGenerator->Run(StepLimit);
+		}));
+	}
+	UE::Tasks::Wait(Tasks);
+
+	int32 NumFailedRegions = 0;
+	for (const FWFCSolverRegion& Region : Regions)
+	{
+		Region.Generator->PostAsyncRun();
+
+		if (Region.Generator->State == EWFCGeneratorState::Finished)
+		{
+			MergeRegion(Generator, Grid, Region);
+		}
+		else
+		{
+			UE_LOG(LogWFC, Verbose, TEXT("Region %s - %s failed with seed %d, it will be solved by the main generator"),
+			       *Region.InteriorMin.ToString(), *Region.InteriorMax.ToString(), Region.Generator->GetSeed());
+			++NumFailedRegions;
+		}
+	}
+	SET_DWORD_STAT(STAT_WFCRegionSolverFailedRegions, NumFailedRegions);
+
+	RegionGenerators.Reset();
+
+	// solve any regions that failed, which still match the seams around them
+	if (Generator->State == EWFCGeneratorState::InProgress)
+	{
+		Generator->Run(StepLimit);
+	}
+
+	UE_LOG(LogWFC, Verbose, TEXT("Solved %d region(s), %d failed"), Regions.Num(), NumFailedRegions);
+
+	return Generator->State == EWFCGeneratorState::Finished;
+}
+
+bool UWFCRegionSolver::IsSeamCell(FIntPoint CellLocation) const
+{
+	return CellLocation.X % (RegionSize.X + 1) == RegionSize.X || CellLocation.Y % (RegionSize.Y + 1) == RegionSize.Y;
+}
+
+void UWFCRegionSolver::CreateRegions(FIntPoint Dimensions, TArray<FWFCSolverRegion>& OutRegions) const
+{
+	OutRegions.Reset();
+
+	// each region is followed by a seam one cell wide
+	for (int32 MinY = 0; MinY < Dimensions.Y; MinY += RegionSize.Y + 1)
+	{
+		for (int32 MinX = 0; MinX < Dimensions.X; MinX += RegionSize.X + 1)
+		{
+			FWFCSolverRegion& Region = OutRegions.AddDefaulted_GetRef();
+			Region.InteriorMin = FIntPoint(MinX, MinY);
+			Region.InteriorMax = FIntPoint(FMath::Min(MinX + RegionSize.X, Dimensions.X) - 1,
+			                               FMath::Min(MinY + RegionSize.Y, Dimensions.Y) - 1);
+
+			// include the surrounding seams, which are already collapsed
+			Region.Min = FIntPoint(FMath::Max(Region.InteriorMin.X - 1, 0), FMath::Max(Region.InteriorMin.Y - 1, 0));
+			Region.Max = FIntPoint(FMath::Min(Region.InteriorMax.X + 1, Dimensions.X - 1),
+			                       FMath::Min(Region.InteriorMax.Y + 1, Dimensions.Y - 1));
+		}
+	}
+}
+
+void UWFCRegionSolver::SolveSeams(UWFCGenerator* Generator, const UWFCGrid2D* Grid, int32 StepLimit) const
+{
+	SCOPE_LOG_TIME_FUNC();
+
+	// backtracking may undo earlier seam cells, so repeat until all are collapsed
+	bool bDidCollapseAnyCell = true;
+	while (bDidCollapseAnyCell && Generator->State == EWFCGeneratorState::InProgress)
+	{
+		bDidCollapseAnyCell = false;
+		for (FWFCCellIndex CellIndex = 0; CellIndex < Grid->GetNumCells(); ++CellIndex)
+		{
+			if (Generator->State != EWFCGeneratorState::InProgress)
+			{
+				return;
+			}
+
+			if (IsSeamCell(Grid->GetLocationForCellIndex(CellIndex)) && !Generator->GetCell(CellIndex).HasSelection())
+			{
+				Generator->CollapseCell(CellIndex, StepLimit);
+				bDidCollapseAnyCell = true;
+			}
+		}
+	}
+}
+
+UWFCGenerator* UWFCRegionSolver::CreateRegionGenerator(UWFCGenerator* Generator, const UWFCGrid2D* Grid, const FWFCSolverRegion& Region)
+{
+	const FIntPoint Size = Region.GetSize();
+
+	TObjectPtr<UWFCGrid2DConfig>& GridConfig = RegionGridConfigs.FindOrAdd(Size);
+	if (!GridConfig)
+	{
+		GridConfig = DuplicateObject<UWFCGrid2DConfig>(CastChecked<UWFCGrid2DConfig>(Generator->Config.GridConfig.Get()), this);
+		GridConfig->Dimensions = Size;
+	}
+
+	FWFCGeneratorConfig Config = Generator->Config;
+	Config.GridConfig = GridConfig;
+	Config.Seed = static_cast<int32>(Generator->GetRandomStream().GetUnsignedInt());
+	Config.ConstraintClasses.RemoveAll([](const TSubclassOf<UWFCConstraint>& ConstraintClass)
+	{
+		return ConstraintClass && (ConstraintClass->IsChildOf<UWFCBoundaryConstraint>() ||
+			ConstraintClass->IsChildOf<UWFCFixedTileConstraint>());
+	});
+
+	UWFCGenerator* RegionGenerator = NewObject<UWFCGenerator>(this, Generator->GetClass());
+	RegionGenerator->Configure(Config);
+	RegionGenerators.Add(RegionGenerator);
+
+	if (const UWFCGeneratorSnapshot* Snapshot = RegionSnapshots.FindRef(Size))
+	{
+		RegionGenerator->Initialize(false);
+		RegionGenerator->ApplySnapshot(Snapshot);
+		RegionGenerator->InitializeConstraints();
+	}
+	else
+	{
+		RegionGenerator->Initialize();
+		RegionGenerator->RunStartup();
+		RegionSnapshots.Add(Size, RegionGenerator->CreateSnapshot(this));
+	}
+
+	// ban anything that is no longer a candidate in the main generator, including everything but the seam tiles
+	const UWFCGrid2D* RegionGrid = CastChecked<UWFCGrid2D>(RegionGenerator->GetGrid());
+	for (FWFCCellIndex RegionCellIndex = 0; RegionCellIndex < RegionGrid->GetNumCells(); ++RegionCellIndex)
+	{
+		const FIntPoint CellLocation = Region.Min + RegionGrid->GetLocationForCellIndex(RegionCellIndex);
+		const FWFCCell& Cell = Generator->GetCell(Grid->GetCellIndexForLocation(CellLocation));
+
+		FWFCTileBitset BannedTiles = RegionGenerator->GetCell(RegionCellIndex).TileCandidates;
+		BannedTiles.Subtract(Cell.TileCandidates);
+		if (!BannedTiles.IsEmpty())
+		{
+			RegionGenerator->BanMultiple(RegionCellIndex, BannedTiles.ToArray());
+		}
+	}
+
+	return RegionGenerator;
+}
+
+void UWFCRegionSolver::MergeRegion(UWFCGenerator* Generator, const UWFCGrid2D* Grid, const FWFCSolverRegion& Region) const
+{
+	const UWFCGrid2D* RegionGrid = CastChecked<UWFCGrid2D>(Region.Generator->GetGrid());
+	for (int32 Y = Region.InteriorMin.Y; Y <= Region.InteriorMax.Y; ++Y)
+	{
+		for (int32 X = Region.InteriorMin.X; X <= Region.InteriorMax.X; ++X)
+		{
+			const FWFCCellIndex CellIndex = Grid->GetCellIndexForLocation(FIntPoint(X, Y));
+			if (Generator->GetCell(CellIndex).HasSelection())
+			{
+				continue;
+			}
+
+			const FWFCCellIndex RegionCellIndex = RegionGrid->GetCellIndexForLocation(FIntPoint(X, Y) - Region.Min);
+			Generator->Select(CellIndex, Region.Generator->GetCell(RegionCellIndex).GetSelectedTileId());
+		}
+	}
+}
@@ -87,7 +87,8 @@ FDebugRenderSceneProxy* UWFCRenderingComponent::CreateDebugSceneProxy()
 	const FVector GridMax = GridTransform.TransformPosition(FVector(GridDimensions) * GridCellSize);
 	DebugProxy->Boxes.Emplace(FBox(GridMin, GridMax), GeneratorComp->DebugGridColor.ToFColor(true));
 
-	if (GeneratorComp->IsInitialized())
+	// cells are being modified on another thread while running async
+	if (GeneratorComp->IsInitialized() && !GeneratorComp->IsRunningAsync())
 	{
 		const UWFCGenerator* Generator = GeneratorComp->GetGenerator();
 		const UWFCGrid* Grid = Generator->GetGrid();
@@ -125,8 +126,8 @@ FDebugRenderSceneProxy* UWFCRenderingComponent::CreateDebugSceneProxy()
 			// draw arc cells visited during last update
 			for (const FWFCCellIndexAndDirection& CellVisited : AdjacencyConstraint->GetVisitedDuringPropagation())
 			{
-				FWFCCellIndex CellIndexB = Grid->GetCellIndexInDirection(CellVisited.CellIndex, CellVisited.Direction);
-				if (!Grid->IsValidCellIndex(CellIndexB))
+				const FWFCCellIndex CellIndexB = Grid->GetNeighborIndex(CellVisited.CellIndex, CellVisited.Direction);
+				if (CellIndexB == INDEX_NONE)
 				{
 					continue;
 				}
@@ -141,7 +142,7 @@ FDebugRenderSceneProxy* UWFCRenderingComponent::CreateDebugSceneProxy()
 		for (int32 CellIndex = 0; CellIndex < Generator->GetNumCells(); ++CellIndex)
 		{
 			const FWFCCell& Cell = Generator->GetCell(CellIndex);
-			const bool bWasAffectedThisUpdate = Generator->GetCellsAffectedThisUpdate().Contains(CellIndex);
+			const bool bWasAffectedThisUpdate = Generator->WasCellAffectedThisUpdate(CellIndex);
 
 			TArray<FString> CellTextLines;
 			if (Settings.bShowCellCoordinates)
@@ -184,7 +185,7 @@ FDebugRenderSceneProxy* UWFCRenderingComponent::CreateDebugSceneProxy()
 				TextColor = Color * 1.5f;
 				if (Settings.bShowCandidates)
 				{
-					CellTextLines.Add(GetTileIdsDebugString(Cell.TileCandidates, Settings.MaxTileIdCount));
+					CellTextLines.Add(GetTileIdsDebugString(Cell.TileCandidates.ToArray(), Settings.MaxTileIdCount));
 				}
 				if (Settings.bShowEntropy && EntropySelector)
 				{
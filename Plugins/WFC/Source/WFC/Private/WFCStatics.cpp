@@ -5,6 +5,8 @@
 
 #include "WFCAsset.h"
 #include "WFCModule.h"
+#include "WFCPortfolioRunner.h"
+#include "Core/WFCCompiledModel.h"
 #include "Core/WFCGenerator.h"
 #include "Core/WFCGrid.h"
 #include "Core/WFCModel.h"
@@ -38,7 +40,7 @@ FLinearColor UWFCStatics::GetRandomDebugColor(int32 Seed, float Saturation, floa
 	return HSV.HSVToLinearRGB();
 }
 
-UWFCGenerator* UWFCStatics::CreateWFCGenerator(UObject* Outer, UWFCAsset* WFCAsset)
+UWFCGenerator* UWFCStatics::CreateWFCGenerator(UObject* Outer, UWFCAsset* WFCAsset, int32 Seed)
 {
 	if (!WFCAsset)
 	{
@@ -51,27 +53,55 @@ UWFCGenerator* UWFCStatics::CreateWFCGenerator(UObject* Outer, UWFCAsset* WFCAss
 		return nullptr;
 	}
 
+	// create and initialize the model, but don't generate tiles, that will be run by the generator
+	UWFCModel* Model = NewObject<UWFCModel>(Outer, WFCAsset->ModelClass);
+	check(Model != nullptr);
+	Model->Initialize(WFCAsset);
+
+	return CreateWFCGeneratorWithModel(Outer, WFCAsset, Model, Seed);
+}
+
+UWFCGenerator* UWFCStatics::CreateWFCGeneratorWithModel(UObject* Outer, UWFCAsset* WFCAsset, UWFCModel* Model, int32 Seed)
+{
+	if (!WFCAsset || !Model)
+	{
+		return nullptr;
+	}
+
 	if (!WFCAsset->GeneratorClass)
 	{
 		UE_LOG(LogWFC, Warning, TEXT("No GeneratorClass was specified: %s"), *WFCAsset->GetName());
 		return nullptr;
 	}
 
-	// create and initialize the model, but don't generate tiles, that will be run by the generator
-	UWFCModel* Model = NewObject<UWFCModel>(Outer, WFCAsset->ModelClass);
-	check(Model != nullptr);
-	Model->Initialize(WFCAsset);
-
 	// create and configure the generator
 	UWFCGenerator* Generator = NewObject<UWFCGenerator>(Outer, WFCAsset->GeneratorClass);
 
 	FWFCGeneratorConfig Config;
 	Config.Model = Model;
 	Config.GridConfig = WFCAsset->GridConfig;
+	Config.CompiledModel = WFCAsset->CompiledModel;
 	Config.ConstraintClasses = WFCAsset->ConstraintClasses;
 	Config.CellSelectorClasses = WFCAsset->CellSelectorClasses;
+	Config.Seed = Seed;
+	Config.MaxBacktracks = WFCAsset->MaxBacktracks;
+	Config.MaxRestarts = WFCAsset->MaxRestarts;
+	Config.bOverrideArcPropagationMode = WFCAsset->bOverrideArcPropagationMode;
+	Config.ArcPropagationMode = WFCAsset->ArcPropagationMode;
+	Config.bOverrideArcResidueMemoryBudget = WFCAsset->bOverrideArcResidueMemoryBudget;
+	Config.ArcResidueMemoryBudgetMB = WFCAsset->ArcResidueMemoryBudgetMB;
 
 	Generator->Configure(Config);
 
 	return Generator;
 }
+
+UWFCPortfolioRunner* UWFCStatics::CreateWFCPortfolioRunner(UObject* Outer, UWFCAsset* WFCAsset, int32 NumGenerators, int32 Seed)
+{
+	UWFCPortfolioRunner* Runner = NewObject<UWFCPortfolioRunner>(Outer);
+	if (!Runner->Initialize(WFCAsset, NumGenerators, Seed))
+	{
+		return nullptr;
+	}
+	return Runner;
+}
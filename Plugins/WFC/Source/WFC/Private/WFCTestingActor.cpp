@@ -79,6 +79,7 @@ void AWFCTestingActor::PostInitializeComponents()
 	if (GetWorld() && GetWorld()->IsGameWorld())
 	{
 		WFCGenerator->OnCellSelectedEvent.AddUObject(this, &AWFCTestingActor::OnCellSelected);
+		WFCGenerator->OnCellUnselectedEvent.AddUObject(this, &AWFCTestingActor::OnCellUnselected);
 		WFCGenerator->OnFinishedEvent.AddUObject(this, &AWFCTestingActor::OnGeneratorFinished);
 	}
 }
@@ -91,6 +92,12 @@ void AWFCTestingActor::OnCellSelected(int32 CellIndex)
 	}
 }
 
+void AWFCTestingActor::OnCellUnselected(int32 CellIndex)
+{
+	// the tile may have been spawned for the selection that was undone
+	DestroyActorForCell(CellIndex);
+}
+
 void AWFCTestingActor::OnGeneratorFinished(EWFCGeneratorState State)
 {
 	if (State == EWFCGeneratorState::Finished ||
@@ -189,6 +196,15 @@ void AWFCTestingActor::LoadAllTileActorLevels()
 	}
 }
 
+void AWFCTestingActor::DestroyActorForCell(int32 CellIndex)
+{
+	TWeakObjectPtr<AActor> TileActor;
+	if (SpawnedTileActors.RemoveAndCopyValue(CellIndex, TileActor) && TileActor.IsValid())
+	{
+		TileActor->Destroy();
+	}
+}
+
 void AWFCTestingActor::DestroyAllSpawnedActors()
 {
 	for (auto& Elem : SpawnedTileActors)
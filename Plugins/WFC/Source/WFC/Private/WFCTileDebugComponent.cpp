@@ -167,7 +167,7 @@ void UWFCTileDebugComponent::GetDebugTileInstances(TArray<FWFCTileDebugInstance>
 	{
 		for (FWFCGridDirection Direction = 0; Direction < Grid->GetNumDirections(); ++Direction)
 		{
-			const TArray<FWFCTileId>& AllowedTileIds = Arc->GetAllowedTileIds(AssetTile->Id, Direction);
+			const TArrayView<const FWFCTileId> AllowedTileIds = Arc->GetAllowedTileIds(AssetTile->Id, Direction);
 			for (int32 Idx = 0; Idx < AllowedTileIds.Num(); ++Idx)
 			{
 				const FVector DirectionVector = FVector(Grid->GetDirectionVector(Direction));
@@ -0,0 +1,46 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Core/WFCCellSelector.h"
+#include "WFCCandidateCountCellSelector.generated.h"
+
+
+/**
+ * Returns a random cell from those with the least number of candidates remaining.
+ * This is equivalent to the entropy selector when all tiles have the same weight, but much cheaper.
+ *
+ * Open cells are kept in buckets by their candidate count, and moved between buckets
+ * as candidates are banned, so selecting the next cell doesn't need to visit every cell.
+ */
+UCLASS()
+class WFC_API UWFCCandidateCountCellSelector : public UWFCCellSelector
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(UWFCGenerator* InGenerator) override;
+	virtual void Reset() override;
+	virtual void NotifyCellChanged(FWFCCellIndex CellIndex, bool bHasSelection) override;
+	virtual FWFCCellIndex SelectNextCell() override;
+
+protected:
+	/** Open cells for each [CandidateCount], in no particular order. */
+	TArray<TArray<FWFCCellIndex>> Buckets;
+
+	/** The candidate count of the bucket containing each cell, or INDEX_NONE if the cell is not open. */
+	TArray<int32> CellBuckets;
+
+	/** The index of each cell within its bucket. */
+	TArray<int32> CellBucketPositions;
+
+	/** A candidate count that no open cell is below, the lowest non-empty bucket is found by searching up from here. */
+	int32 MinBucket;
+
+	/** Add a cell to a bucket. */
+	void AddToBucket(FWFCCellIndex CellIndex, int32 CandidateCount);
+
+	/** Remove a cell from its current bucket, if any. */
+	void RemoveFromBucket(FWFCCellIndex CellIndex);
+};
@@ -10,6 +10,10 @@
 /**
  * Returns a random cell biasing those with the lowest entropy,
  * roughly equivalent to those with the least number of candidates remaining.
+ *
+ * The sums needed to calculate entropy are cached per cell and updated as candidates are banned,
+ * and open cells are kept in a min-heap keyed by entropy plus a small random noise assigned to each cell,
+ * so selecting the next cell doesn't need to visit every cell.
  */
 UCLASS()
 class WFC_API UWFCEntropyCellSelector : public UWFCCellSelector
@@ -27,8 +31,55 @@ public:
 	UFUNCTION(BlueprintPure)
 	float GetCellEntropy(int32 CellIndex) const;
 
+	virtual void Initialize(UWFCGenerator* InGenerator) override;
+	virtual void Reset() override;
+	virtual void NotifyCellBan(FWFCCellIndex CellIndex, FWFCTileId BannedTileId) override;
+	virtual void NotifyCellBans(FWFCCellIndex CellIndex, TArrayView<const FWFCTileId> BannedTileIds) override;
+	virtual void NotifyCellCandidateRestored(FWFCCellIndex CellIndex, FWFCTileId TileId) override;
+	virtual void NotifyCellChanged(FWFCCellIndex CellIndex, bool bHasSelection) override;
 	virtual FWFCCellIndex SelectNextCell() override;
 
 protected:
-	virtual float CalculateShannonEntropy(const FWFCCell& Cell) const;
+	/** The weight of each tile, or 0 for tiles with no positive weight. */
+	TArray<double> TileWeights;
+
+	/** The weight times log of weight of each tile. */
+	TArray<double> TileWeightLogWeights;
+
+	/** The sum of weights of the candidates of each cell. */
+	TArray<double> CellSumOfWeights;
+
+	/** The sum of weight times log of weight of the candidates of each cell. */
+	TArray<double> CellSumOfWeightLogWeights;
+
+	/** The number of candidates with a positive weight for each cell, so that sums can be exactly zero. */
+	TArray<int32> CellNumWeightedCandidates;
+
+	/** The random noise of each cell, assigned once on reset. */
+	TArray<float> CellNoise;
+
+	/** The entropy plus noise of each cell, used to order the heap. */
+	TArray<double> CellKeys;
+
+	/** Open cells, ordered as a binary min-heap by CellKeys. */
+	TArray<FWFCCellIndex> Heap;
+
+	/** The index of each cell within Heap, or INDEX_NONE if the cell is not open. */
+	TArray<int32> HeapIndices;
+
+	/** Return the entropy of a cell from its cached sums. */
+	virtual double CalculateShannonEntropy(FWFCCellIndex CellIndex) const;
+
+	/** Update the heap position of a cell, adding or removing it depending on whether it's open. */
+	void UpdateCell(FWFCCellIndex CellIndex);
+
+	void HeapRemove(FWFCCellIndex CellIndex);
+	void HeapSiftUp(int32 HeapIndex);
+	void HeapSiftDown(int32 HeapIndex);
+
+	FORCEINLINE void HeapSet(int32 HeapIndex, FWFCCellIndex CellIndex)
+	{
+		Heap[HeapIndex] = CellIndex;
+		HeapIndices[CellIndex] = HeapIndex;
+	}
 };
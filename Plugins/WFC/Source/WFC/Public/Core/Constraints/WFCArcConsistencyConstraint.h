@@ -6,19 +6,118 @@
 #include "Core/WFCConstraint.h"
 #include "WFCArcConsistencyConstraint.generated.h"
 
+class UWFCCompiledModel;
 
+
+/**
+ * The allowed tiles for each [TileId][Direction] of an arc consistency constraint, stored as one flat array of
+ * tile ids with an offset per tile and direction. It is never modified once built, so it can be shared by every
+ * generator that uses the same model, including generators running on other threads.
+ */
+struct WFC_API FWFCArcAdjacency
+{
+	FWFCArcAdjacency();
+	FWFCArcAdjacency(const TArray<TArray<TArray<FWFCTileId>>>& AllowedTiles, int32 InNumDirections);
+
+	FORCEINLINE int32 GetNumTiles() const { return NumTiles; }
+
+	FORCEINLINE int32 GetNumDirections() const { return NumDirections; }
+
+	/** Return the tiles that can be placed next to a tile in a direction, sorted by tile id. */
+	FORCEINLINE TArrayView<const FWFCTileId> GetAllowedTiles(FWFCTileId TileId, FWFCGridDirection Direction) const
+	{
+		const int32 Index = TileId * NumDirections + Direction;
+		return TArrayView<const FWFCTileId>(TileIds.GetData() + Offsets[Index], Offsets[Index + 1] - Offsets[Index]);
+	}
+
+	/** Return the largest number of allowed tiles for any tile and direction. */
+	int32 GetMaxNumAllowedTiles() const;
+
+	SIZE_T GetAllocatedSize() const { return Offsets.GetAllocatedSize() + TileIds.GetAllocatedSize(); }
+
+	void Serialize(FArchive& Ar);
+
+private:
+	int32 NumTiles;
+
+	int32 NumDirections;
+
+	/** The index of the first allowed tile for each [TileId][Direction], with one extra entry for the end. */
+	TArray<int32> Offsets;
+
+	/** The allowed tiles of every tile and direction. */
+	TArray<FWFCTileId> TileIds;
+};
+
+
+/**
+ * A snapshot of an arc consistency constraint.
+ * Like the constraint, only the rows of support counts that were written are kept. When saved, the adjacency is either
+ * referenced from a compiled model or stored in its compact form, and written support counts are stored as deltas
+ * from the default counts, skipping every row of counts that still matches the defaults.
+ */
 UCLASS()
 class WFC_API UWFCArcConstraintSnapshot : public UWFCConstraintSnapshot
 {
 	GENERATED_BODY()
 
 public:
+	UWFCArcConstraintSnapshot();
+
+	/** The compiled model containing the adjacency, if it was used by the constraint, so that it isn't saved twice. */
+	UPROPERTY()
+	TObjectPtr<const UWFCCompiledModel> CompiledModel;
+
+	/** The allowed tiles for each [TileId][Direction], only used if the allowed tiles weren't compiled yet. */
 	TArray<TArray<TArray<FWFCTileId>>> AllowedTiles;
-	TArray<TArray<TArray<int32>>> SupportCounts;
-	TArray<TArray<TArray<int32>>> DefaultSupportCounts;
+	/** The compiled adjacency shared with the constraint this was created from, or loaded from the snapshot. */
+	TSharedPtr<const FWFCArcAdjacency> Adjacency;
+	int32 NumDirections;
+	/** The size in bytes of each support count, or 0 if the support counts are not valid. */
+	int32 SupportCountSize;
+	/** The index of each [CellIndex][Direction] row in SupportCounts, or INDEX_NONE if it was never written. */
+	TArray<int32> SupportCountRowIndices;
+	/** The written rows of support counts, one after another. */
+	TArray64<uint8> SupportCounts;
+	TArray<uint8> DefaultSupportCounts;
 	TArray<FWFCCellIndexAndTileId> BansToPropagate;
 
+	/** Return the adjacency of this snapshot, or of its compiled model. */
+	TSharedPtr<const FWFCArcAdjacency> GetAdjacency() const;
+
 	virtual void Serialize(FArchive& Ar) override;
+
+protected:
+	/** Serialize snapshots saved before CompactSnapshots, only used when loading. */
+	void SerializeLegacy(FArchive& Ar);
+
+	/** Save or load the support counts as deltas from the default counts of each direction. */
+	template <typename CounterType>
+	void SerializeSupportCountDeltas(FArchive& Ar);
+};
+
+
+/** The length of the ban trail of an arc consistency constraint at a backtrack point. */
+struct FWFCArcBacktrackPoint
+{
+	FWFCArcBacktrackPoint()
+		: PropagatedTrailNum(0)
+	{
+	}
+
+	FWFCArcBacktrackPoint(int32 InPropagatedTrailNum, const TArray<FWFCCellIndexAndTileId>& InBansToPropagate)
+		: PropagatedTrailNum(InPropagatedTrailNum),
+		  BansToPropagate(InBansToPropagate)
+	{
+	}
+
+	int32 PropagatedTrailNum;
+
+	/** Bans that had not been propagated yet, this is almost always empty since selection happens after propagation. */
+	TArray<FWFCCellIndexAndTileId> BansToPropagate;
+
+	/** Changed cells that had not been propagated yet, when using bitset propagation. */
+	TArray<FWFCCellIndex> CellsToPropagate;
 };
 
 
@@ -31,6 +130,11 @@ public:
  * a cell has left for each tile candidate, decrements the support count when an option is removed,
  * and removes a tile candidate when it's support count reaches 0.
  * See https://www.boristhebrave.com/2021/08/30/arc-consistency-explained/ for more info.
+ *
+ * Alternatively, the Bitsets propagation mode uses a bit-parallel version of AC3, which keeps no support counts
+ * and instead rechecks every neighbor of a changed cell against the combined allowed tiles of its candidates,
+ * and the Residues mode uses AC3rm, which keeps a fixed amount of memory regardless of the grid size.
+ * The mode can be overridden for every constraint of a generator by its config, see UWFCAsset::ArcPropagationMode.
  */
 UCLASS(Abstract)
 class WFC_API UWFCArcConsistencyConstraint : public UWFCConstraint
@@ -43,17 +147,37 @@ public:
 	/**
 	 * When true, treat cells with no candidates as empty spaces and don't
 	 * use them to ban candidates from neighboring cells.
+	 * Propagation continues past these cells instead of stopping at the contradiction, in every propagation mode.
 	 */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	bool bIgnoreContradictionCells;
 
+	/**
+	 * How bans are propagated to neighboring cells. Every mode reaches the same candidates once propagation is done,
+	 * they only differ in speed and memory use. When contradiction cells are ignored, the candidates left next to
+	 * them can differ between modes, since each mode stops using a cell at a different point while it is emptied.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	EWFCArcPropagationMode PropagationMode;
+
+	/**
+	 * The maximum memory in MB for residual supports when using the Residues mode.
+	 * Grids that would need more than this share residues between cells, which only means supports are searched for more often.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (ClampMin = "1"))
+	int32 ResidueMemoryBudgetMB;
+
 	virtual void Initialize(UWFCGenerator* InGenerator) override;
 	virtual void Reset() override;
 	virtual void NotifyCellBan(FWFCCellIndex CellIndex, FWFCTileId BannedTileId) override;
+	virtual void NotifyCellBans(FWFCCellIndex CellIndex, TArrayView<const FWFCTileId> BannedTileIds) override;
 	virtual bool Next() override;
+	virtual void SaveBacktrackPoint() override;
+	virtual void RestoreBacktrackPoint() override;
 	virtual void LogDebugInfo() const override;
 	virtual UWFCConstraintSnapshot* CreateSnapshot(UObject* Outer) const override;
 	virtual void ApplySnapshot(const UWFCConstraintSnapshot* Snapshot) override;
+	virtual void CompileModel(UWFCCompiledModel* CompiledModel) const override;
 
 	/**
 	 * Add an entry to the table that allows a tile to be placed next to another tile
@@ -64,36 +188,234 @@ public:
 	 */
 	void AddAllowedTileForDirection(FWFCTileId TileId, FWFCGridDirection Direction, FWFCTileId AllowedTileId);
 
-	/** Return the array of all valid tiles that can be placed next to a tile in a direction. */
-	const TArray<FWFCTileId>& GetAllowedTileIds(FWFCTileId TileId, FWFCGridDirection Direction) const;
+	/**
+	 * Replace every tile that is allowed to be placed next to a tile for an incoming direction at once,
+	 * which is much faster than adding them one at a time.
+	 * @param AllowedTileIds The allowed tile ids, which must be unique and sorted.
+	 */
+	void SetAllowedTilesForDirection(FWFCTileId TileId, FWFCGridDirection Direction, TArrayView<const FWFCTileId> AllowedTileIds);
+
+	/** Return the array of all valid tiles that can be placed next to a tile in a direction, sorted by tile id. */
+	TArrayView<const FWFCTileId> GetAllowedTileIds(FWFCTileId TileId, FWFCGridDirection Direction) const;
+
+	/** Return the compiled adjacency, which is only valid once support counts have been allocated. */
+	const TSharedPtr<const FWFCArcAdjacency>& GetAdjacency() const { return Adjacency; }
 
 	const TArray<FWFCCellIndexAndTileId>& GetBansToPropagate() const { return BansToPropagate; }
 
 	const TArray<FWFCCellIndexAndDirection>& GetVisitedDuringPropagation() const { return VisitedDuringPropagation; }
 
+	/** Return the memory allocated for propagation in bytes, including support counts, residues, and allowed tile bitsets. */
+	SIZE_T GetPropagationAllocatedSize() const;
+
 protected:
 	bool bIsInitialized;
 
-	/** Contains the allowed list of tiles for each [TileId][Direction]. */
+	/** The cached number of tiles in the model. */
+	int32 NumTiles;
+
+	/** The cached number of directions in the grid. */
+	int32 NumDirections;
+
+	/**
+	 * Contains the allowed list of tiles for each [TileId][Direction], sorted by tile id.
+	 * Only used while adding allowed tiles, and emptied once they are compiled into the adjacency.
+	 */
 	TArray<TArray<TArray<FWFCTileId>>> AllowedTiles;
 
-	/** Contains the number of supports for each [CellIndex][TileId][Direction]. */
-	TArray<TArray<TArray<int32>>> SupportCounts;
+	/** The compiled allowed tiles, built when support counts are allocated and shared with any snapshots. */
+	TSharedPtr<const FWFCArcAdjacency> Adjacency;
+
+	/**
+	 * The size in bytes of each support count, the smallest of 1, 2, or 4 that can hold the largest allowed tiles list.
+	 * 0 until the support counts have been allocated.
+	 */
+	int32 SupportCountSize;
+
+	/**
+	 * The index of the written row of support counts for each [CellIndex][Direction], or INDEX_NONE if it hasn't been written.
+	 * Rows that haven't are still equal to the defaults, or zero if the cell has no neighbor in that direction,
+	 * so they are only stored once they first change.
+	 */
+	TArray<int32> SupportCountRowIndices;
+
+	/**
+	 * The written rows of unsigned support counts, with the counts of every tile for one cell and direction contiguous.
+	 * Rows are added in pages that are never reallocated, so a row keeps its address while others are added.
+	 */
+	TArray<TArray<uint8>> SupportCountPages;
+
+	/** The number of rows that have been written to SupportCountPages. */
+	int32 NumSupportCountRows;
 
-	/** Cached copy of the support counts after initialization for faster resetting. */
-	TArray<TArray<TArray<int32>>> DefaultSupportCounts;
+	/** The size in bytes of each row of support counts. */
+	int32 SupportCountRowSize;
+
+	/** The number of rows of support counts in each page. */
+	int32 SupportCountRowsPerPage;
+
+	/** The initial support counts for each [Direction][TileId], used by any cell that has a neighbor in that direction. */
+	TArray<uint8> DefaultSupportCounts;
 
 	/** List of banned tiles per cell that need to be propagated in the next update. */
 	TArray<FWFCCellIndexAndTileId> BansToPropagate;
 
+	/**
+	 * The allowed tiles for each [TileId][Direction] as bitsets of GetNumWordsForBits(NumTiles) words each,
+	 * followed by the allowed tiles of every tile combined for each [Direction]. Only used by bitset propagation.
+	 */
+	TArray<uint64> AllowedTileMasks;
+
+	/** Cells whose candidates changed and need to be checked against their neighbors, when using bitset propagation. */
+	TArray<FWFCCellIndex> CellsToPropagate;
+
+	/** Whether each cell is in CellsToPropagate. */
+	TBitArray<> QueuedCells;
+
+	/**
+	 * The index into the allowed tiles of the last support found for each [CellIndex][Direction][TileId], when using residues.
+	 * They are only hints that are checked before being used, so cells can share them when the grid exceeds the memory budget.
+	 */
+	TArray64<uint16> Residues;
+
+	/** The shift used to hash residue indices into the residues table, or 0 if every residue has its own entry. */
+	int32 ResidueHashShift;
+
 	/** Unique cell directions that were visited during the last propagation. */
 	TArray<FWFCCellIndexAndDirection> VisitedDuringPropagation;
 
 	bool bDidApplyInitialConsistency;
 
+	/** Bans that decremented the support counts of their neighbors since the first backtrack point. */
+	TArray<FWFCCellIndexAndTileId> PropagatedTrail;
+
+	/** The saved trail lengths for each backtrack point, most recent last. */
+	TArray<FWFCArcBacktrackPoint> BacktrackPoints;
+
+	/** Clear all backtrack points and trails. */
+	void ResetBacktracking();
+
+	/** Use the propagation settings of a generator's config, if it overrides them. */
+	void ApplyConfigOverrides(const UWFCGenerator* InGenerator);
+
+	/** Return the smallest counter size in bytes that can hold the support count of any tile. */
+	int32 CalculateSupportCountSize() const;
+
+	/** Return the index of the first support count for a cell and direction, in units of counters. */
+	FORCEINLINE int64 GetSupportCountOffset(FWFCCellIndex CellIndex, FWFCGridDirection Direction) const
+	{
+		return (static_cast<int64>(CellIndex) * NumDirections + Direction) * NumTiles;
+	}
+
+	/** Return the data of a written row of support counts. */
+	FORCEINLINE uint8* GetWrittenSupportCountRow(int32 WrittenRowIndex)
+	{
+		return SupportCountPages[WrittenRowIndex / SupportCountRowsPerPage].GetData() +
+			(WrittenRowIndex % SupportCountRowsPerPage) * SupportCountRowSize;
+	}
+
+	FORCEINLINE const uint8* GetWrittenSupportCountRow(int32 WrittenRowIndex) const
+	{
+		return const_cast<UWFCArcConsistencyConstraint*>(this)->GetWrittenSupportCountRow(WrittenRowIndex);
+	}
+
+	/** Return the support counts of a cell and direction for modification, writing their initial values the first time. */
+	template <typename CounterType>
+	FORCEINLINE CounterType* GetMutableSupportCountRow(FWFCCellIndex CellIndex, FWFCGridDirection Direction)
+	{
+		int32& WrittenRowIndex = SupportCountRowIndices[CellIndex * NumDirections + Direction];
+		if (WrittenRowIndex == INDEX_NONE)
+		{
+			WrittenRowIndex = AddSupportCountRow();
+			WriteInitialSupportCountRow(GetWrittenSupportCountRow(WrittenRowIndex), CellIndex, Direction);
+		}
+		return reinterpret_cast<CounterType*>(GetWrittenSupportCountRow(WrittenRowIndex));
+	}
+
+	/** Add a row to the written support counts, adding a page if needed, and return its index. */
+	int32 AddSupportCountRow();
+
+	/** Remove every written row of support counts, keeping their pages for reuse if the row size hasn't changed. */
+	void ResetSupportCountRows(int32 RowSize);
+
+	/** Release all support counts, until they are allocated again. */
+	void EmptySupportCounts();
+
+	/** Return the memory used by the support counts, including the row indices and defaults. */
+	SIZE_T GetSupportCountsAllocatedSize() const;
+
+	/** Write the initial support counts of a cell and direction, which are the defaults if it has a neighbor, or zero. */
+	void WriteInitialSupportCountRow(uint8* Row, FWFCCellIndex CellIndex, FWFCGridDirection Direction) const;
+
+	/** Compile the allowed tiles into the adjacency table and release them. */
+	void CompileAdjacency();
+
+	/**
+	 * Use the adjacency of the generator's compiled model instead of adding allowed tiles, if it was compiled for this class.
+	 * @return True if the compiled adjacency is used.
+	 */
+	bool InitializeFromCompiledModel();
+
+	/** Allocate support counts and fill out the default counts, once all allowed tiles have been added. */
+	void AllocateSupportCounts();
+
+	template <typename CounterType>
+	void FillDefaultSupportCounts();
+
+	/** Undo all support count decrements recorded in the trail since a backtrack point. */
+	template <typename CounterType>
+	void RestoreSupportCounts(const FWFCArcBacktrackPoint& BacktrackPoint);
+
 	/** Initialize support counts and check for contradictions. */
 	void ApplyInitialConsistency();
 
+	/** Ban tiles with no allowed tiles at all in a direction from every cell that has a neighbor in that direction. */
+	void BanUnsupportedTiles();
+
 	/** Propagate changes due to banned tiles and ensure consistency. */
 	bool PropagateChanges();
+
+	template <typename CounterType>
+	bool PropagateChangesWithCounters();
+
+	/** Build the allowed tile bitsets from the adjacency, once all allowed tiles have been added. */
+	void AllocateAllowedTileMasks();
+
+	/** Return the allowed tiles bitset for a tile and direction, or for every tile combined if TileId is INDEX_NONE. */
+	FORCEINLINE const uint64* GetAllowedTileMask(FWFCTileId TileId, FWFCGridDirection Direction) const
+	{
+		const int32 MaskIndex = TileId == INDEX_NONE ? NumTiles * NumDirections + Direction : TileId * NumDirections + Direction;
+		return AllowedTileMasks.GetData() + MaskIndex * FWFCTileBitset::GetNumWordsForBits(NumTiles);
+	}
+
+	/** Add a cell to the bitset propagation queue, if it isn't already queued. */
+	void QueueCellToPropagate(FWFCCellIndex CellIndex);
+
+	/** Propagate changed cells to their neighbors using the allowed tile bitsets. */
+	bool PropagateChangesWithBitsets();
+
+	/**
+	 * Return the number of entries needed for the residues table within the memory budget.
+	 * @param OutHashShift The shift used to hash residue indices, or 0 if every residue fits.
+	 */
+	int64 CalculateResiduesSize(int32& OutHashShift) const;
+
+	/** Allocate the residues table, once all allowed tiles have been added. */
+	void AllocateResidues();
+
+	/** Return the index in the residues table for a cell, direction, and tile. */
+	FORCEINLINE int64 GetResidueIndex(FWFCCellIndex CellIndex, FWFCGridDirection Direction, FWFCTileId TileId) const
+	{
+		const int64 Index = GetSupportCountOffset(CellIndex, Direction) + TileId;
+		return ResidueHashShift == 0 ? Index : static_cast<int64>((static_cast<uint64>(Index) * 0x9E3779B97F4A7C15ull) >> ResidueHashShift);
+	}
+
+	/**
+	 * Return true if a tile in a cell still has any allowed tile remaining in the neighbor cell in a direction,
+	 * checking the residue first and updating it if a new support is found.
+	 */
+	bool HasResidualSupport(FWFCCellIndex CellIndex, FWFCGridDirection Direction, FWFCTileId TileId, const FWFCTileBitset& NeighborCandidates);
+
+	/** Propagate banned tiles by searching for new supports of the tiles they supported. */
+	bool PropagateChangesWithResidues();
 };
@@ -23,6 +23,9 @@ public:
 /**
  * Require tiles placed next to the grid boundary to follow certain rules.
  * This is useful for enforcing that large tiles remain wholly inside the grid.
+ *
+ * Cells are grouped by their boundary signature from the grid, and the tiles to ban are calculated once
+ * per signature, so only the boundary cells are visited and each one costs a single ban.
  */
 UCLASS(DisplayName = "Boundary Constraint")
 class WFC_API UWFCBoundaryConstraint : public UWFCConstraint
@@ -39,6 +42,7 @@ public:
 	virtual bool Next() override;
 	virtual UWFCConstraintSnapshot* CreateSnapshot(UObject* Outer) const override;
 	virtual void ApplySnapshot(const UWFCConstraintSnapshot* Snapshot) override;
+	virtual void CompileModel(UWFCCompiledModel* CompiledModel) const override;
 
 	/**
 	 * Add a mapping that prohibits a tile from being placed next to a grid boundary for an outgoing direction.
@@ -51,14 +55,29 @@ public:
 protected:
 	bool bIsInitialized;
 	
-	/** Map of tiles and the outgoing directions for which they are prohibited from being adjacent to the grid boundary. */
-	TMap<FWFCTileId, TArray<FWFCGridDirection>> TileBoundaryProhibitionMap;
+	/** A mask of the outgoing directions that each tile is prohibited from being adjacent to the grid boundary, by tile id. */
+	TArray<uint32> TileProhibitedDirections;
 
 	bool bDidApplyInitialConstraint;
 
-	/** Cached map of tiles to ban for each cell. Calculated after the first time this constraint is run in case it needs to re-run */
-	TMap<FWFCCellIndex, TArray<FWFCTileId>> TilesToBan;
+	/**
+	 * The tiles to ban for each boundary signature, calculated the first time a signature is seen.
+	 * These only depend on the tiles, so they are kept across resets and work for any size of grid.
+	 */
+	TMap<uint32, TArray<FWFCTileId>> BoundaryMaskTilesToBan;
+
+	/**
+	 * Use the prohibitions of the generator's compiled model instead of checking every tile, if it was compiled for this class.
+	 * @return True if the compiled prohibitions are used.
+	 */
+	bool InitializeFromCompiledModel();
+
+	/** Return true if a tile is not allowed to be adjacent to boundaries in any of the outgoing directions of a mask. */
+	FORCEINLINE bool IsTileBoundaryDirectionProhibited(FWFCTileId TileId, uint32 BoundaryMask) const
+	{
+		return (TileProhibitedDirections[TileId] & BoundaryMask) != 0;
+	}
 
-	/** Return true if a tile is not allowed to be adjacent to boundaries in the given outgoing directions. */
-	bool IsTileBoundaryDirectionProhibited(FWFCTileId TileId, const TArray<FWFCGridDirection>& BoundaryDirections) const;
+	/** Return the tiles to ban from cells with a boundary signature, calculating them if needed. */
+	const TArray<FWFCTileId>& GetTilesToBanForBoundaryMask(uint32 BoundaryMask);
 };
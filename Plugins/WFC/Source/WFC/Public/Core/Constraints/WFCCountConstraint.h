@@ -16,25 +16,71 @@ struct FWFCCountConstraintTileGroup
 	GENERATED_BODY()
 
 	FWFCCountConstraintTileGroup()
-		: MaxCount(0)
+		: MinCount(0),
+		  MaxCount(0)
 	{
 	}
 
-	FWFCCountConstraintTileGroup(TArray<FWFCTileId> InTileIds, int32 InMaxCount)
+	FWFCCountConstraintTileGroup(TArray<FWFCTileId> InTileIds, int32 InMinCount, int32 InMaxCount, int32 NumTiles)
 		: TileIds(InTileIds),
+		  TileSet(NumTiles),
+		  MinCount(InMinCount),
 		  MaxCount(InMaxCount)
 	{
+		for (const FWFCTileId TileId : TileIds)
+		{
+			TileSet.Add(TileId);
+		}
 	}
 
 	TArray<FWFCTileId> TileIds;
 
-	/** Maximum number of times this group have a tile selected */
+	/** The same tile ids as a set, for checking whether a cell can still hold any of them. */
+	FWFCTileBitset TileSet;
+
+	/** Minimum number of times this group must have a tile selected, or 0 for no minimum. */
+	int32 MinCount;
+
+	/** Maximum number of times this group can have a tile selected, or 0 for no maximum. */
 	int32 MaxCount;
 };
 
 
+UCLASS()
+class WFC_API UWFCCountConstraintSnapshot : public UWFCConstraintSnapshot
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY()
+	TArray<int32> TileGroupCurrentCounts;
+
+	UPROPERTY()
+	TArray<int32> TileGroupsToBan;
+
+	UPROPERTY()
+	TArray<int32> BannedGroups;
+};
+
+
+/** The counts and ban state of a count constraint at a backtrack point. */
+struct FWFCCountConstraintBacktrackPoint
+{
+	TArray<int32> TileGroupCurrentCounts;
+	TArray<int32> TileGroupsToBan;
+	TBitArray<> BannedGroups;
+	TArray<int32> TileGroupCandidateCellCounts;
+	TBitArray<> ForcedGroups;
+	bool bIsOccupancyValid = false;
+};
+
+
 /**
- * Limits the number of times a tile can be selected.
+ * Limits the number of times a tile can be selected, or requires that it is selected a minimum number of times.
+ *
+ * The number of cells that can still hold a tile from each group is kept up to date from ban notifications,
+ * so that once a group reaches its max count its tiles are only banned from those cells, and once the number of
+ * cells left equals a group's min count, each of them is forced to use a tile from the group.
  */
 UCLASS(Abstract)
 class WFC_API UWFCCountConstraint : public UWFCConstraint
@@ -42,20 +88,42 @@ class WFC_API UWFCCountConstraint : public UWFCConstraint
 	GENERATED_BODY()
 
 public:
+	UWFCCountConstraint();
+
+	/**
+	 * When true, keep a list of the cells that could hold each tile group when generation starts,
+	 * so that bans and forced selections only visit those cells instead of the whole grid.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bTrackGroupCells;
+
 	virtual void Initialize(UWFCGenerator* InGenerator) override;
 	virtual void Reset() override;
 	virtual void NotifyCellChanged(FWFCCellIndex CellIndex, bool bHasSelection) override;
+	virtual void NotifyCellBan(FWFCCellIndex CellIndex, FWFCTileId BannedTileId) override;
+	virtual void NotifyCellBans(FWFCCellIndex CellIndex, TArrayView<const FWFCTileId> BannedTileIds) override;
 	virtual bool Next() override;
+	virtual void SaveBacktrackPoint() override;
+	virtual void RestoreBacktrackPoint() override;
+	virtual UWFCConstraintSnapshot* CreateSnapshot(UObject* Outer) const override;
+	virtual void ApplySnapshot(const UWFCConstraintSnapshot* Snapshot) override;
 
 	/** Set the maximum number of times that a set of tiles can be used. */
 	void AddTileGroupMaxCountMapping(const TArray<FWFCTileId>& TileIds, int32 MaxCount);
 
+	/**
+	 * Set the minimum and maximum number of times that a set of tiles can be used.
+	 * @param MinCount The minimum number of selections, or 0 for no minimum.
+	 * @param MaxCount The maximum number of selections, or 0 for no maximum.
+	 */
+	void AddTileGroupCountMapping(const TArray<FWFCTileId>& TileIds, int32 MinCount, int32 MaxCount);
+
 protected:
-	/** Array of tile ids in each tile group, and their maximum count. */
+	/** Array of tile ids in each tile group, and their min and max counts. */
 	TArray<FWFCCountConstraintTileGroup> TileGroupMaxCounts;
 
-	/** Map of tile groups indexed by tile id for fast lookup. */
-	TMap<int32, int32> TileIdsToGroups;
+	/** The tile group of each tile id, or INDEX_NONE. */
+	TArray<int32> TileIdsToGroups;
 
 	/** The number of times each tile group has had a tile selected. */
 	TArray<int32> TileGroupCurrentCounts;
@@ -64,31 +132,80 @@ protected:
 	TArray<int32> TileGroupsToBan;
 
 	/** Tile groups have already been banned. */
-	TArray<int32> BannedGroups;
+	TBitArray<> BannedGroups;
+
+	/**
+	 * The number of cells that still have a candidate from each tile group, including cells that selected one.
+	 * Only valid once bIsOccupancyValid is true, since it is counted from the cells during the first update.
+	 */
+	TArray<int32> TileGroupCandidateCellCounts;
+
+	/** The cells that had a candidate from each tile group when the occupancy was counted, if bTrackGroupCells is true. */
+	TArray<TArray<FWFCCellIndex>> TileGroupCells;
+
+	/** Tile groups whose remaining cells have already been forced to use them, to reach their min count. */
+	TBitArray<> ForcedGroups;
+
+	/** Whether the candidate cell counts are up to date. */
+	bool bIsOccupancyValid;
+
+	/** Copies of the counts for each backtrack point, most recent last. There are only a few groups, so copying is cheap. */
+	TArray<FWFCCountConstraintBacktrackPoint> BacktrackPoints;
+
+	/** Count the cells that have a candidate from each tile group, and gather them if tracking cells. */
+	void UpdateOccupancy();
+
+	/** Return true if a tile group has reached its max count and been banned. */
+	FORCEINLINE bool IsGroupBanned(int32 TileGroupIndex) const
+	{
+		return BannedGroups.IsValidIndex(TileGroupIndex) && BannedGroups[TileGroupIndex];
+	}
+
+	/** Call a function for every cell that may still have a candidate from a tile group, until it returns true. */
+	template <typename FuncType>
+	bool ForEachGroupCell(int32 TileGroupIndex, FuncType Func) const;
+
+	/**
+	 * Ban the tiles of a group that reached its max count from every unselected cell.
+	 * @return True if a contradiction occurred.
+	 */
+	bool BanTileGroup(int32 TileGroupIndex);
+
+	/**
+	 * Force every unselected cell that can hold a tile group to use it, once there are only enough cells left for its min count.
+	 * @return True if a contradiction occurred.
+	 */
+	bool ForceTileGroup(int32 TileGroupIndex);
 };
 
 
-/** Defines a max count that should be applied to all tiles with a matching tag. */
+/** Defines a min and max count that should be applied to all tiles with a matching tag. */
 USTRUCT(BlueprintType)
 struct FWFCTileTagMaxCount
 {
 	GENERATED_BODY()
 
 	FWFCTileTagMaxCount()
-		: MaxCount(1)
+		: MinCount(0),
+		  MaxCount(1)
 	{
 	}
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	FGameplayTag Tag;
 
+	/** The minimum number of times a matching tile must be selected, or 0 for no minimum. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (UIMin = "0", UIMax = "10"))
+	int32 MinCount;
+
+	/** The maximum number of times a matching tile can be selected, or 0 for no maximum. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (UIMin = "0", UIMax = "10"))
 	int32 MaxCount;
 };
 
 
 /**
- * Limit the max count of tiles based on the tags of each tile asset.
+ * Limit the min and max count of tiles based on the tags of each tile asset.
  */
 UCLASS(Abstract, DisplayName = "Tag Count Constraint")
 class WFC_API UWFCTagCountConstraint : public UWFCCountConstraint
@@ -96,10 +213,15 @@ class WFC_API UWFCTagCountConstraint : public UWFCCountConstraint
 	GENERATED_BODY()
 
 public:
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (TitleProperty = "{Tag} = {MaxCount}"), Category = "TagMaxCounts")
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (TitleProperty = "{Tag} = {MinCount} - {MaxCount}"), Category = "TagMaxCounts")
 	TArray<FWFCTileTagMaxCount> MaxCounts;
 
+	/** Return the count rule for a tile asset, which is the first rule whose tag the tile has. */
+	virtual const FWFCTileTagMaxCount* GetTileCountRule(const UWFCTileAsset* TileAsset) const;
+
 	virtual int32 GetTileMaxCount(const UWFCTileAsset* TileAsset) const;
 
+	virtual int32 GetTileMinCount(const UWFCTileAsset* TileAsset) const;
+
 	virtual void Initialize(UWFCGenerator* InGenerator) override;
 };
@@ -26,11 +26,18 @@ public:
 	virtual void Initialize(UWFCGenerator* InGenerator) override;
 	virtual void ApplySnapshot(const UWFCConstraintSnapshot* Snapshot) override;
 
-	/** Return true if two edges are allowed to be next to each other. */
+	/**
+	 * Return true if two edges are allowed to be next to each other.
+	 * Compatibility must be symmetric, since each pair of edge types is only checked once.
+	 */
 	virtual bool AreEdgesCompatible(const FGameplayTag& EdgeA, const FGameplayTag& EdgeB) const;
 
-	/** Return true if TileB can be placed next to TileA in a direction going from A -> B. */
-	virtual bool AreTilesCompatible(const FWFCModelAssetTile& TileA, const FWFCModelAssetTile& TileB, FWFCGridDirection Direction) const;
+	/**
+	 * Return true if TileB can be placed next to TileA in a direction going from A -> B.
+	 * No longer virtual, since initialization only checks each pair of edge types, override AreEdgesCompatible instead.
+	 */
+	UE_DEPRECATED(5.6, "Tiles are matched by edge type, override AreEdgesCompatible to customize matching instead.")
+	bool AreTilesCompatible(const FWFCModelAssetTile& TileA, const FWFCModelAssetTile& TileB, FWFCGridDirection Direction) const;
 
 protected:
 	bool bIsInitializedFromTiles;
@@ -40,37 +47,10 @@ protected:
 	TObjectPtr<const UWFCAssetModel> AssetModel;
 
 	/**
-	 * Initialize the allowed tiles by iterating all tiles in the model,
-	 * looking up their edge types, and adding mappings.
+	 * Initialize the allowed tiles from the edge types of every tile in the model.
+	 * Edge types are interned as ids and tiles are bucketed by the edge type facing each direction, so only edge types
+	 * are checked with AreEdgesCompatible, and each bucket's allowed tiles are built once for every tile in it.
+	 * Interior edges of large tiles only allow the exact neighbor tile with the same rotation.
 	 */
 	void InitializeFromTiles();
-
-	/**
-	 * Initialize the allowed tiles by iterating all assets, checking their edge types against
-	 * other assets, then adding mappings for the matching tiles and rotation variants.
-	 * Experimental, performs less checks but inefficiently attempts to add redundant entries
-	 * and has issues if there are duplicate tile assets in the tile set.
-	 */
-	void InitializeFromAssets();
-
-	/**
-	 * Add allowed tiles for a large tile interior edge, including all rotation variants.
-	 * @param TileAsset The tile asset containing the tile def.
-	 * @param TileDefIndex The tile def to add neighbor allowed tile entries.
-	 * @param Direction The local direction in the tile asset pointing to the neighbor.
-	 * @param TileDefIds The list of tile ids matching the tile def index, precalculated for faster lookup.
-	 */
-	void AddInteriorAllowedTiles(const UWFCTileAsset* TileAsset, int32 TileDefIndex, FWFCGridDirection Direction,
-	                             const TArray<FWFCTileId>& TileDefIds);
-
-	/**
-	 * Add allowed tiles for a tile def whose edge is compatible with another tile def.
-	 * Adds mappings for rotation variants in which the local direction pairing is the same.
-	 * @param TileAIds The list of tile ids for tile def A.
-	 * @param OutDirectionA The direction local to A, going from A->B. 
-	 * @param TileBIds The list of tile ids for tile def B.
-	 * @param OutDirectionB The direction local to B, going from B->A.
-	 */
-	void AddMatchingEdgeAllowedTiles(const TArray<FWFCTileId>& TileAIds, FWFCGridDirection OutDirectionA,
-	                                 const TArray<FWFCTileId>& TileBIds, FWFCGridDirection OutDirectionB);
 };
@@ -50,6 +50,18 @@ protected:
 };
 
 
+/**
+ * A fixed tile constraint whose tiles are only added at runtime, after the generator is initialized.
+ * Used by the chunk manager to select the tiles of neighboring chunks around the edge of a new chunk,
+ * so that its own cells match the seams.
+ */
+UCLASS()
+class WFC_API UWFCChunkSeamConstraint : public UWFCFixedTileConstraint
+{
+	GENERATED_BODY()
+};
+
+
 // 3D Fixed Tile Constraints
 // -------------------------
 
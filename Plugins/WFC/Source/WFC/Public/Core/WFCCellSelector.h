@@ -25,9 +25,24 @@ public:
 	/** Initialize the selector for a generator */
 	virtual void Initialize(UWFCGenerator* InGenerator);
 
-	/** Reset the selector to its initialized state */
+	/** Reset the selector to its initialized state, using the current state of the generator's cells. */
 	virtual void Reset();
 
+	/** Called when a tile candidate has been banned from a cell. */
+	virtual void NotifyCellBan(FWFCCellIndex CellIndex, FWFCTileId BannedTileId);
+
+	/**
+	 * Called when multiple tile candidates have been banned from a cell at once.
+	 * By default this calls NotifyCellBan for each tile, override it to handle the whole batch at once.
+	 */
+	virtual void NotifyCellBans(FWFCCellIndex CellIndex, TArrayView<const FWFCTileId> BannedTileIds);
+
+	/** Called when a banned tile candidate has been restored to a cell while backtracking. */
+	virtual void NotifyCellCandidateRestored(FWFCCellIndex CellIndex, FWFCTileId TileId);
+
+	/** Called after the candidates of a cell have changed, once all bans for the change have been notified. */
+	virtual void NotifyCellChanged(FWFCCellIndex CellIndex, bool bHasSelection);
+
 	/** Select and return the next best cell to collapse. */
 	virtual FWFCCellIndex SelectNextCell();
 
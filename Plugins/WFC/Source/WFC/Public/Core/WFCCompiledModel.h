@@ -0,0 +1,82 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WFCTypes.h"
+#include "Templates/SubclassOf.h"
+#include "UObject/Object.h"
+#include "WFCCompiledModel.generated.h"
+
+class UWFCConstraint;
+class UWFCGenerator;
+class UWFCModel;
+struct FWFCArcAdjacency;
+
+
+/**
+ * Rules built by the constraints of a generator that only depend on the model's tiles and the type of grid,
+ * such as the allowed tiles of an adjacency constraint. Compiled in the editor and when cooking, and stored
+ * in a WFCAsset so that generators can skip building them at runtime.
+ *
+ * The content hash covers every tile of the model and their edges, so a compiled model that no longer matches
+ * its source tiles is ignored rather than producing incorrect results. Each compiled constraint's rules also store
+ * a hash of that constraint, and are ignored by constraints whose settings or class have changed since.
+ */
+UCLASS(DefaultToInstanced, EditInlineNew)
+class WFC_API UWFCCompiledModel : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UWFCCompiledModel();
+
+	/** Hash of the model's tiles when this was compiled. */
+	UPROPERTY(VisibleAnywhere)
+	uint64 ContentHash;
+
+	UPROPERTY(VisibleAnywhere)
+	int32 NumTiles;
+
+	UPROPERTY(VisibleAnywhere)
+	int32 NumDirections;
+
+	/** The arc consistency constraint class whose allowed tiles were compiled. */
+	UPROPERTY(VisibleAnywhere)
+	TSubclassOf<UWFCConstraint> AdjacencyConstraintClass;
+
+	/** The compiled rules hash of the arc consistency constraint, see UWFCConstraint::CalculateCompiledRulesHash. */
+	UPROPERTY(VisibleAnywhere)
+	uint64 AdjacencyConstraintHash;
+
+	/** The compiled allowed tiles, shared with every constraint that uses them. */
+	TSharedPtr<const FWFCArcAdjacency> Adjacency;
+
+	/** The boundary constraint class whose prohibitions were compiled. */
+	UPROPERTY(VisibleAnywhere)
+	TSubclassOf<UWFCConstraint> BoundaryConstraintClass;
+
+	/** The compiled rules hash of the boundary constraint, see UWFCConstraint::CalculateCompiledRulesHash. */
+	UPROPERTY(VisibleAnywhere)
+	uint64 BoundaryConstraintHash;
+
+	/** A mask of the outgoing directions that each tile is prohibited from being next to the grid boundary, by tile id. */
+	TArray<uint32> BoundaryProhibitedDirections;
+
+	/** Compile the rules of an initialized generator, replacing anything compiled before. */
+	void Compile(const UWFCGenerator* Generator);
+
+	/** Return true if this was compiled from the same tiles as a model, for a grid with some number of directions. */
+	bool IsValidFor(const UWFCModel* Model, int32 InNumDirections) const;
+
+	/**
+	 * Return true if rules compiled by a constraint class with a hash can be used by a constraint,
+	 * logging a warning if the class matches but the constraint has changed since.
+	 */
+	bool IsValidForConstraint(const UWFCConstraint* Constraint, const UClass* CompiledClass, uint64 CompiledHash) const;
+
+	/** Return the hash of a model's tiles for a grid with some number of directions. */
+	static uint64 CalculateContentHash(const UWFCModel* Model, int32 InNumDirections);
+
+	virtual void Serialize(FArchive& Ar) override;
+};
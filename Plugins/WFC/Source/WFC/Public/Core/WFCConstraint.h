@@ -7,6 +7,7 @@
 #include "UObject/Object.h"
 #include "WFCConstraint.generated.h"
 
+class UWFCCompiledModel;
 class UWFCGrid;
 class UWFCModel;
 class UWFCGenerator;
@@ -44,12 +45,30 @@ public:
 	/** Called when a tile candidate has been banned from a cell. */
 	virtual void NotifyCellBan(FWFCCellIndex CellIndex, FWFCTileId BannedTileId);
 
+	/**
+	 * Called when multiple tile candidates have been banned from a cell at once.
+	 * By default this calls NotifyCellBan for each tile, override it to handle the whole batch at once.
+	 */
+	virtual void NotifyCellBans(FWFCCellIndex CellIndex, TArrayView<const FWFCTileId> BannedTileIds);
+
 	/**
 	 * Update the constraint
 	 * @return True if the constraint made any changes, false otherwise.
 	 */
 	virtual bool Next();
 
+	/**
+	 * Save any state needed to undo changes made to this constraint from now on.
+	 * Called by the generator before each selection when backtracking is enabled.
+	 */
+	virtual void SaveBacktrackPoint();
+
+	/**
+	 * Restore the state saved by the most recent SaveBacktrackPoint and discard it.
+	 * Called after the generator has restored the candidates of every cell changed since then.
+	 */
+	virtual void RestoreBacktrackPoint();
+
 	/** Log debug info about this constraint. */
 	virtual void LogDebugInfo() const;
 
@@ -57,6 +76,18 @@ public:
 
 	virtual void ApplySnapshot(const UWFCConstraintSnapshot* Snapshot);
 
+	/**
+	 * Store any rules built during initialize that only depend on the model and type of grid in a compiled model.
+	 * Constraints that do this should check the generator's compiled model during initialize and use it if they can.
+	 */
+	virtual void CompileModel(UWFCCompiledModel* CompiledModel) const;
+
+	/**
+	 * Return a hash of this constraint's class, its default property values, and any Blueprint functions,
+	 * stored with compiled rules so that they are ignored once the constraint that compiled them has changed.
+	 */
+	virtual uint64 CalculateCompiledRulesHash() const;
+
 protected:
 	UPROPERTY(Transient)
 	TObjectPtr<UWFCGenerator> Generator;
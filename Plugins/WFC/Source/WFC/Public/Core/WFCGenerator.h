@@ -8,6 +8,7 @@
 #include "UObject/Object.h"
 #include "WFCGenerator.generated.h"
 
+class UWFCCompiledModel;
 class UWFCConstraintSnapshot;
 class UWFCCellSelector;
 class UWFCModel;
@@ -16,19 +17,47 @@ class UWFCGridConfig;
 class UWFCConstraint;
 
 
-/** Stores information about a generator that can be used to restore state. */
+/**
+ * Stores information about a generator that can be used to restore state.
+ * Cell candidates are stored as one flat buffer of bitset words, so they are saved, loaded, and applied in bulk.
+ */
 UCLASS(DefaultToInstanced, EditInlineNew)
 class WFC_API UWFCGeneratorSnapshot : public UObject
 {
 	GENERATED_BODY()
 
 public:
-	UPROPERTY(VisibleAnywhere)
-	TArray<FWFCCell> Cells;
+	UWFCGeneratorSnapshot();
 
 	/** Snapshots for each of the constraints, by class. */
 	UPROPERTY(VisibleAnywhere)
 	TMap<TSubclassOf<UWFCConstraint>, TObjectPtr<UWFCConstraintSnapshot>> ConstraintSnapshots;
+
+	/** Store the candidates and collapse phase of every cell, which must all have the same number of tiles. */
+	void SetCells(const TArray<FWFCCell>& InCells);
+
+	/** Copy the stored candidates and collapse phase into every cell, whose candidates must already hold GetNumTiles bits. */
+	void CopyCellsTo(TArray<FWFCCell>& OutCells) const;
+
+	int32 GetNumCells() const { return CollapsePhases.Num(); }
+
+	/** Return the number of tiles that each cell's candidates can hold. */
+	int32 GetNumTiles() const { return NumTiles; }
+
+	virtual void Serialize(FArchive& Ar) override;
+
+protected:
+	int32 NumTiles;
+
+	/** The candidate bitset words of every cell, with the same number of words for each cell. */
+	TArray<uint64> CandidateWords;
+
+	/** The EWFCGeneratorStepPhase during which each cell was fully collapsed. */
+	TArray<uint8> CollapsePhases;
+
+	/** The cells of snapshots saved before they were compacted, converted when loaded. */
+	UPROPERTY()
+	TArray<FWFCCell> Cells_DEPRECATED;
 };
 
 
@@ -41,6 +70,13 @@ struct FWFCGeneratorConfig
 	GENERATED_BODY()
 
 	FWFCGeneratorConfig()
+		: Seed(0),
+		  MaxBacktracks(0),
+		  MaxRestarts(0),
+		  bOverrideArcPropagationMode(false),
+		  ArcPropagationMode(EWFCArcPropagationMode::SupportCounts),
+		  bOverrideArcResidueMemoryBudget(false),
+		  ArcResidueMemoryBudgetMB(0)
 	{
 	}
 
@@ -50,15 +86,78 @@ struct FWFCGeneratorConfig
 	UPROPERTY()
 	TWeakObjectPtr<const UWFCGridConfig> GridConfig;
 
+	/** Optional rules compiled ahead of time for the model, used by constraints if they are still valid. */
+	UPROPERTY()
+	TWeakObjectPtr<const UWFCCompiledModel> CompiledModel;
+
 	UPROPERTY()
 	TArray<TSubclassOf<UWFCConstraint>> ConstraintClasses;
 
 	UPROPERTY()
 	TArray<TSubclassOf<UWFCCellSelector>> CellSelectorClasses;
+
+	/** The seed for all random decisions made by the generator, the same seed and inputs produce the same output. */
+	UPROPERTY()
+	int32 Seed;
+
+	/**
+	 * The maximum number of times the generator can undo a selection that led to a contradiction, before failing.
+	 * When 0, any contradiction is an error and no backtracking state is recorded.
+	 */
+	UPROPERTY()
+	int32 MaxBacktracks;
+
+	/**
+	 * The maximum number of times the generator can start over with a new seed after a contradiction
+	 * that could not be resolved by backtracking, before failing.
+	 * Restarts restore the state captured right before the first selection, so startup constraints don't run again.
+	 */
+	UPROPERTY()
+	int32 MaxRestarts;
+
+	/** If true, every arc consistency constraint uses ArcPropagationMode instead of its own. */
+	UPROPERTY()
+	bool bOverrideArcPropagationMode;
+
+	UPROPERTY()
+	EWFCArcPropagationMode ArcPropagationMode;
+
+	/** If true, every arc consistency constraint uses ArcResidueMemoryBudgetMB instead of its own. */
+	UPROPERTY()
+	bool bOverrideArcResidueMemoryBudget;
+
+	UPROPERTY()
+	int32 ArcResidueMemoryBudgetMB;
 };
 
 
-// TODO: make async
+/** A tile selection made by the generator, which can be undone if it leads to a contradiction. */
+struct FWFCGeneratorChoicePoint
+{
+	FWFCGeneratorChoicePoint()
+		: CellIndex(INDEX_NONE),
+		  TileId(INDEX_NONE),
+		  BanTrailNum(0)
+	{
+	}
+
+	FWFCGeneratorChoicePoint(FWFCCellIndex InCellIndex, FWFCTileId InTileId, int32 InBanTrailNum)
+		: CellIndex(InCellIndex),
+		  TileId(InTileId),
+		  BanTrailNum(InBanTrailNum)
+	{
+	}
+
+	/** The cell that was selected. */
+	FWFCCellIndex CellIndex;
+
+	/** The tile that was selected for the cell. */
+	FWFCTileId TileId;
+
+	/** The length of the ban trail before the selection was made. */
+	int32 BanTrailNum;
+};
+
 
 /**
  * Handles running the actual processes for selecting, banning, and propagating
@@ -98,6 +197,19 @@ public:
 	UFUNCTION(BlueprintPure)
 	const UWFCModel* GetModel() const { return Config.Model.Get(); }
 
+	/** Return the seed used to initialize the random stream. */
+	UFUNCTION(BlueprintPure)
+	int32 GetSeed() const { return Config.Seed; }
+
+	/**
+	 * Return the random stream used for all random decisions during generation.
+	 * Cell selectors and constraints must use this instead of global random functions, so that runs are reproducible.
+	 */
+	FORCEINLINE FRandomStream& GetRandomStream() { return RandomStream; }
+
+	/** Return the compiled model from the config, or null if there isn't one or it doesn't match the model. */
+	FORCEINLINE const UWFCCompiledModel* GetCompiledModel() const { return CompiledModel; }
+
 	/** Return the grid config of the source asset. */
 	UFUNCTION(BlueprintPure)
 	const UWFCGridConfig* GetGridConfig() const { return Config.GridConfig.Get(); }
@@ -153,6 +265,12 @@ public:
 	UFUNCTION(BlueprintCallable)
 	void RunStartup(int32 StepLimit = 100000);
 
+	/**
+	 * Called on the game thread after the generator has been run on another thread,
+	 * so that any objects created during the run can be garbage collected normally.
+	 */
+	void PostAsyncRun();
+
 	/** Continue the generator forward by selecting the next tile. */
 	UFUNCTION(BlueprintCallable, Meta = (AdvancedDisplay = "0"))
 	void Next(bool bNoSelection = false);
@@ -171,6 +289,12 @@ public:
 	UFUNCTION(BlueprintCallable)
 	bool BanMultiple(int32 CellIndex, TArray<int32> TileIds);
 
+	/**
+	 * Report a contradiction that isn't caused by a cell running out of candidates, such as a constraint whose
+	 * requirements can no longer be met. It is resolved like any other contradiction once the constraint returns.
+	 */
+	void NotifyContradiction();
+
 	/**
 	 * Select a tile to use for a cell.
 	 * This is equivalent to banning all other tile candidates.
@@ -178,6 +302,14 @@ public:
 	UFUNCTION(BlueprintCallable)
 	void Select(int32 CellIndex, int32 TileId);
 
+	/**
+	 * Select a random tile for a specific cell, the same way Next would if it had picked the cell,
+	 * then run constraints until they have nothing left to do.
+	 * Allows cells to be collapsed in an order decided outside of the generator, such as region seams first.
+	 */
+	UFUNCTION(BlueprintCallable)
+	void CollapseCell(int32 CellIndex, int32 StepLimit = 100000);
+
 	FORCEINLINE bool IsValidCellIndex(FWFCCellIndex Index) const { return Cells.IsValidIndex(Index); }
 
 	FORCEINLINE bool IsValidTileId(FWFCTileId TileId) const { return TileId >= 0 && TileId < NumTiles; }
@@ -210,11 +342,55 @@ public:
 
 	const TArray<FWFCCellIndex>& GetCellsAffectedThisUpdate() const { return CellsAffectedThisUpdate; }
 
+	/** Return true if a cell was modified during the last update. */
+	FORCEINLINE bool WasCellAffectedThisUpdate(FWFCCellIndex CellIndex) const
+	{
+		return CellAffectedEpochs.IsValidIndex(CellIndex) && CellAffectedEpochs[CellIndex] == AffectedEpoch;
+	}
+
+	/** Return true if selections that lead to a contradiction are undone instead of failing. */
+	FORCEINLINE bool IsBacktrackingEnabled() const { return Config.MaxBacktracks > 0; }
+
+	/** Return the number of times a selection has been undone since the last reset. */
+	UFUNCTION(BlueprintPure)
+	FORCEINLINE int32 GetNumBacktracks() const { return NumBacktracks; }
+
+	/** Return the number of times the generator has started over since the last reset. */
+	UFUNCTION(BlueprintPure)
+	FORCEINLINE int32 GetNumRestarts() const { return NumRestarts; }
+
+	/** Return the seed used by the current attempt, which differs from the config seed after a restart. */
+	UFUNCTION(BlueprintPure)
+	FORCEINLINE int32 GetAttemptSeed() const { return AttemptSeed; }
+
+	/** Return the number of cells that have been collapsed to a single tile. */
+	UFUNCTION(BlueprintPure)
+	FORCEINLINE int32 GetNumSelectedCells() const { return NumSelectedCells; }
+
+	/** Return the number of cells that have no candidates left. */
+	UFUNCTION(BlueprintPure)
+	FORCEINLINE int32 GetNumContradictedCells() const { return NumContradictedCells; }
+
+	/** Return all cells that have more than one candidate left, in no particular order. */
+	FORCEINLINE const TArray<FWFCCellIndex>& GetOpenCells() const { return OpenCells; }
+
+	/** Return the number of cells that have more than one candidate left. */
+	UFUNCTION(BlueprintPure)
+	FORCEINLINE int32 GetNumOpenCells() const { return OpenCells.Num(); }
+
 	DECLARE_MULTICAST_DELEGATE_OneParam(FCellSelectedDelegate, int32 /* CellIndex */);
 
 	/** Called when a cell has been fully collapsed to a single selected tile id. */
 	FCellSelectedDelegate OnCellSelected;
 
+	DECLARE_MULTICAST_DELEGATE_OneParam(FCellUnselectedDelegate, int32 /* CellIndex */);
+
+	/**
+	 * Called when a cell that was selected, or had no candidates left, has been reopened or changed by backtracking,
+	 * restarting, or applying a snapshot, so that anything created for its previous selection can be discarded.
+	 */
+	FCellUnselectedDelegate OnCellUnselected;
+
 	DECLARE_MULTICAST_DELEGATE_OneParam(FStateChangedDelegate, EWFCGeneratorState /* State */);
 
 	/** Called when the state has changed */
@@ -233,6 +409,17 @@ protected:
 	UPROPERTY(Transient)
 	TArray<TObjectPtr<UWFCCellSelector>> CellSelectors;
 
+	/** The compiled model from the config, once validated against the model. */
+	UPROPERTY(Transient)
+	TObjectPtr<const UWFCCompiledModel> CompiledModel;
+
+	/** The random stream, seeded from the config on initialize and reset, and with a new seed on each restart. */
+	FRandomStream RandomStream;
+
+	/** The state of the generator right before the first selection, restored when restarting. */
+	UPROPERTY(Transient)
+	TObjectPtr<UWFCGeneratorSnapshot> RestartSnapshot;
+
 	/** The cached total number of available tiles. */
 	int32 NumTiles;
 
@@ -254,6 +441,52 @@ protected:
 	/** Array of cells that were modified during the last update. */
 	TArray<FWFCCellIndex> CellsAffectedThisUpdate;
 
+	/** The update epoch in which each cell was last affected, a cell is in CellsAffectedThisUpdate if it matches AffectedEpoch. */
+	TArray<uint32> CellAffectedEpochs;
+
+	/** The current update epoch, incremented instead of clearing CellAffectedEpochs. */
+	uint32 AffectedEpoch;
+
+	/** The last known status of each cell, used to keep the selected and contradicted counts up to date. */
+	TArray<EWFCCellStatus> CellStatuses;
+
+	/** The number of cells with exactly one candidate. */
+	int32 NumSelectedCells;
+
+	/** The number of cells with no candidates. */
+	int32 NumContradictedCells;
+
+	/** Cells with more than one candidate, in no particular order. */
+	TArray<FWFCCellIndex> OpenCells;
+
+	/** The index of each cell within OpenCells, or INDEX_NONE if the cell is not open. */
+	TArray<int32> OpenCellPositions;
+
+	/** Every ban made since the first choice point, in order, so that they can be undone when backtracking. */
+	TArray<FWFCCellIndexAndTileId> BanTrail;
+
+	/** The selections that can still be undone, most recent last. */
+	TArray<FWFCGeneratorChoicePoint> ChoicePoints;
+
+	/** The number of times a selection has been undone since the last reset. */
+	int32 NumBacktracks;
+
+	/** True when a cell has run out of candidates and the contradiction has not been resolved yet. */
+	bool bHasContradiction;
+
+	/** The number of times the generator has started over since the last reset. */
+	int32 NumRestarts;
+
+	/** The seed the random stream was initialized with for the current attempt. */
+	int32 AttemptSeed;
+
+	/** The time that the selection phase of the current attempt began. */
+	double AttemptStartTime;
+
+	void AddOpenCell(FWFCCellIndex CellIndex);
+
+	void RemoveOpenCell(FWFCCellIndex CellIndex);
+
 	/** Create and initialize the grid. */
 	virtual void InitializeGrid(const UWFCGridConfig* GridConfig);
 
@@ -267,7 +500,56 @@ protected:
 	/** Populate the cells array with default values for every cell in the grid */
 	virtual void InitializeCells();
 
-	bool AreAllCellsSelected() const;
+	/** Use the compiled model from the config if it matches the model, otherwise ignore it. */
+	void InitializeCompiledModel();
+
+	FORCEINLINE bool AreAllCellsSelected() const { return NumSelectedCells == NumCells; }
+
+	/** Recalculate the status of every cell and the selected and contradicted counts. */
+	void RecalculateCellStatuses();
+
+	/** Update the status of a cell after its candidates changed. Return the new status. */
+	EWFCCellStatus UpdateCellStatus(FWFCCellIndex CellIndex);
+
+	/** Start a new update, clearing the cells affected during the last one. */
+	void ResetCellsAffectedThisUpdate();
+
+	/** Add a cell to the cells affected this update, if it isn't already. */
+	FORCEINLINE void MarkCellAffected(FWFCCellIndex CellIndex)
+	{
+		if (CellAffectedEpochs[CellIndex] != AffectedEpoch)
+		{
+			CellAffectedEpochs[CellIndex] = AffectedEpoch;
+			CellsAffectedThisUpdate.Add(CellIndex);
+		}
+	}
+
+	/** Clear all choice points and the ban trail. */
+	void ResetBacktracking();
+
+	/** Record a selection that is about to be made, and save the state of all constraints so it can be undone. */
+	void PushChoicePoint(FWFCCellIndex CellIndex, FWFCTileId TileId);
+
+	/**
+	 * Undo all bans made since the last choice point, and restore the state of all constraints and cell selectors.
+	 * The choice point is removed and returned.
+	 */
+	FWFCGeneratorChoicePoint PopChoicePoint();
+
+	/**
+	 * Handle a contradiction, by undoing the last selection and banning the failed tile if the backtrack budget allows,
+	 * or by restarting if the restart budget allows. Otherwise the generator is put into an error state.
+	 */
+	virtual void ResolveContradiction();
+
+	/** Capture the current state to be restored by restarts, called right before the first selection. */
+	void CaptureRestartSnapshot();
+
+	/** Start over from the restart snapshot, using a new seed from the random stream. */
+	virtual void Restart();
+
+	/** Return the time in milliseconds since the selection phase of the current attempt began. */
+	double GetAttemptTimeMs() const;
 
 	/** Called when a tile candidate has been banned from a cell. */
 	virtual void OnCellCandidateBanned(FWFCCellIndex CellIndex, FWFCTileId BannedTileId);
@@ -278,6 +560,12 @@ protected:
 	/** Called when the candidates for a cell have changed. */
 	virtual void OnCellChanged(FWFCCellIndex CellIndex);
 
+	/**
+	 * Called when banned candidates have been restored to a cell while backtracking.
+	 * Constraints are not notified, since they restore their own state from their backtrack points.
+	 */
+	virtual void OnCellCandidatesRestored(FWFCCellIndex CellIndex);
+
 	/** Return the next cell that should be fully collapsed. */
 	virtual FWFCCellIndex SelectNextCellIndex();
 
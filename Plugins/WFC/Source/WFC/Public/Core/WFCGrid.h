@@ -40,10 +40,10 @@ class WFC_API UWFCGrid : public UObject
 public:
 	UWFCGrid();
 
-	/** Create a new grid object and initialize it using a config */
+	/** Create a new grid object, initialize it using a config, and build its neighbor tables. */
 	static UWFCGrid* NewGrid(UObject* Outer, const UWFCGridConfig* Config);
 
-	/** Initialize the grid */
+	/** Initialize the grid. The neighbor tables are built afterwards by NewGrid, from GetCellIndexInDirection. */
 	virtual void Initialize(const UWFCGridConfig* Config);
 
 	/** Return the total number of cells in this grid */
@@ -78,9 +78,37 @@ public:
 	/** Return a rotation combined with a delta rotation. */
 	virtual int32 CombineRotations(int32 RotationA, int32 RotationB) const;
 
-	/** Return the index of the cell that is one unit in a direction from another cell. */
+	/**
+	 * Return the index of the cell that is one unit in a direction from another cell.
+	 * This is used to build the neighbor table, prefer GetNeighborIndex for anything performance sensitive.
+	 */
 	virtual FWFCCellIndex GetCellIndexInDirection(FWFCCellIndex CellIndex, FWFCGridDirection Direction) const;
 
+	/**
+	 * Return the index of the cell that is one unit in a direction from another cell, or INDEX_NONE if there isn't one.
+	 * Reads from the neighbor table, so the cell index and direction must be valid.
+	 */
+	FORCEINLINE FWFCCellIndex GetNeighborIndex(FWFCCellIndex CellIndex, FWFCGridDirection Direction) const
+	{
+		checkSlow(NeighborIndices.IsValidIndex(CellIndex * CachedNumDirections + Direction));
+		return NeighborIndices[CellIndex * CachedNumDirections + Direction];
+	}
+
+	/** Return the direction that goes the opposite way of a valid direction, using the cached table. */
+	FORCEINLINE FWFCGridDirection GetCachedOppositeDirection(FWFCGridDirection Direction) const
+	{
+		return OppositeDirections[Direction];
+	}
+
+	/** Return every cell that is missing a neighbor in at least one direction, in cell index order. */
+	FORCEINLINE const TArray<FWFCCellIndex>& GetBoundaryCells() const { return BoundaryCells; }
+
+	/**
+	 * Return the boundary signature of each cell in GetBoundaryCells, which is a mask of the directions without a neighbor.
+	 * Cells with the same signature share the same boundary rules, so there are at most 2^NumDirections kinds of boundary cell.
+	 */
+	FORCEINLINE const TArray<uint32>& GetBoundaryCellMasks() const { return BoundaryCellMasks; }
+
 	/** Return a readable name for a direction for debugging purposes */
 	UFUNCTION(BlueprintPure)
 	virtual FString GetDirectionName(int32 Direction) const;
@@ -114,4 +142,26 @@ public:
 	/** Return the 3d vector for a direction, if applicable for this grid. */
 	UFUNCTION(BlueprintPure)
 	virtual FIntVector GetDirectionVector(int32 Direction) const;
+
+protected:
+	/** The number of directions, cached when building the neighbor table. */
+	int32 CachedNumDirections;
+
+	/** The index of the neighbor of each cell for each [CellIndex * NumDirections + Direction], or INDEX_NONE. */
+	TArray<FWFCCellIndex> NeighborIndices;
+
+	/** The opposite of each direction. */
+	TArray<FWFCGridDirection> OppositeDirections;
+
+	/** The cells that are missing at least one neighbor. */
+	TArray<FWFCCellIndex> BoundaryCells;
+
+	/** The mask of directions without a neighbor for each cell in BoundaryCells. */
+	TArray<uint32> BoundaryCellMasks;
+
+	/**
+	 * Build the neighbor, opposite direction, and boundary cell tables using GetCellIndexInDirection and GetOppositeDirection.
+	 * Called by NewGrid once the grid has been initialized and is ready to answer those.
+	 */
+	void CacheNeighborIndices();
 };
@@ -7,6 +7,8 @@
 #include "UObject/Object.h"
 #include "WFCModel.generated.h"
 
+struct FXxHash64Builder;
+
 
 /**
  * A model which contains all possible tiles and tile set info.
@@ -18,6 +20,8 @@ class WFC_API UWFCModel : public UObject
 	GENERATED_BODY()
 
 public:
+	UWFCModel();
+
 	/** Initialize this model with arbitrary tile data. */
 	UFUNCTION(BlueprintCallable)
 	void Initialize(const UObject* TileData);
@@ -26,6 +30,15 @@ public:
 	UFUNCTION(BlueprintCallable)
 	virtual void GenerateTiles();
 
+	/**
+	 * Generate tiles if they haven't been generated yet.
+	 * Used by generators so that one model can be shared by many generators without duplicating tiles.
+	 */
+	void EnsureTilesGenerated();
+
+	UFUNCTION(BlueprintPure)
+	bool HasGeneratedTiles() const { return bHasGeneratedTiles; }
+
 	UFUNCTION(BlueprintPure)
 	int32 GetNumTiles() const { return Tiles.Num(); }
 
@@ -64,12 +77,28 @@ public:
 		return Cast<T>(TileDataRef.Get());
 	}
 
-	/** Return the weight of a tile. */
+	/** Return the weight of a tile, which is never negative. */
 	FORCEINLINE float GetTileWeightUnchecked(FWFCTileId TileId) const { return TileWeights[TileId]; }
 
+	/** Return the total weight of all tiles. */
+	FORCEINLINE double GetTotalTileWeight() const { return TileWeightPrefixSums.IsEmpty() ? 0.0 : TileWeightPrefixSums.Last(); }
+
+	/**
+	 * Return the tile whose range of cumulative weight contains a value, as if all tile weights
+	 * were laid end to end in order of tile id. Tiles with no weight are never returned.
+	 * @param Weight A value in the range [0, GetTotalTileWeight()).
+	 */
+	FWFCTileId FindTileIdForCumulativeWeight(double Weight) const;
+
 	/** Return a debug string representing a tile id. */
 	virtual FString GetTileDebugString(FWFCTileId TileId) const;
 
+	/**
+	 * Add everything about the generated tiles that constraints may use to build their rules to a hash,
+	 * used to check whether a compiled model is still valid for this model.
+	 */
+	virtual void AppendContentHash(FXxHash64Builder& Builder, int32 NumDirections) const;
+
 protected:
 	/** Reference to the tile data that was used to generate tiles. Usually a WFCAsset. */
 	UPROPERTY(Transient)
@@ -78,6 +107,12 @@ protected:
 	/** All generated tiles. Array index is the same as the tile id. */
 	TArray<TSharedPtr<FWFCModelTile>> Tiles;
 
-	/** All tile weights, by tile id. */
+	/** All tile weights, by tile id, with negative weights clamped to 0. */
 	TArray<float> TileWeights;
+
+	/** The sum of weights of all tiles before each tile id, with one extra entry for the total. */
+	TArray<double> TileWeightPrefixSums;
+
+	/** True once tiles have been generated by EnsureTilesGenerated. */
+	bool bHasGeneratedTiles;
 };
@@ -0,0 +1,217 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WFCTileBitset.generated.h"
+
+
+/**
+ * A fixed-width set of tile ids, stored as 64-bit words with a cached count of set bits.
+ * Adding, removing, and checking a single tile is O(1), and whole-set operations
+ * such as intersecting or subtracting another set are performed one word at a time.
+ */
+USTRUCT()
+struct WFC_API FWFCTileBitset
+{
+	GENERATED_BODY()
+
+	static constexpr int32 BitsPerWord = 64;
+
+	FWFCTileBitset()
+		: NumBits(0),
+		  NumSet(0)
+	{
+	}
+
+	explicit FWFCTileBitset(int32 InNumBits, bool bValue = false)
+	{
+		Init(InNumBits, bValue);
+	}
+
+	/** Resize the set to hold tile ids 0..InNumBits-1, and set or clear every bit. */
+	void Init(int32 InNumBits, bool bValue);
+
+	/** Return the number of tile ids this set can hold. */
+	FORCEINLINE int32 GetNumBits() const { return NumBits; }
+
+	/** Return the number of tile ids in this set. */
+	FORCEINLINE int32 Num() const { return NumSet; }
+
+	FORCEINLINE bool IsEmpty() const { return NumSet == 0; }
+
+	FORCEINLINE bool Contains(int32 TileId) const
+	{
+		return TileId >= 0 && TileId < NumBits && (Words[TileId >> 6] & GetBitMask(TileId)) != 0;
+	}
+
+	/** @return True if the tile was not already in the set. */
+	FORCEINLINE bool Add(int32 TileId)
+	{
+		check(TileId >= 0 && TileId < NumBits);
+		uint64& Word = Words[TileId >> 6];
+		const uint64 Mask = GetBitMask(TileId);
+		if ((Word & Mask) == 0)
+		{
+			Word |= Mask;
+			++NumSet;
+			return true;
+		}
+		return false;
+	}
+
+	/** @return True if the tile was in the set. */
+	FORCEINLINE bool Remove(int32 TileId)
+	{
+		if (TileId < 0 || TileId >= NumBits)
+		{
+			return false;
+		}
+		uint64& Word = Words[TileId >> 6];
+		const uint64 Mask = GetBitMask(TileId);
+		if ((Word & Mask) != 0)
+		{
+			Word &= ~Mask;
+			--NumSet;
+			return true;
+		}
+		return false;
+	}
+
+	/** Clear every bit, keeping the current width. */
+	void Reset();
+
+	/** Set every bit, keeping the current width. */
+	void SetAll();
+
+	/**
+	 * Add every tile id from another set of the same width.
+	 * @return The number of tile ids that were added.
+	 */
+	int32 UnionWith(const FWFCTileBitset& Other);
+
+	/**
+	 * Remove any tile ids that are not also in another set of the same width.
+	 * @return The number of tile ids that were removed.
+	 */
+	int32 IntersectWith(const FWFCTileBitset& Other);
+
+	/**
+	 * Remove all tile ids that are in another set of the same width.
+	 * @return The number of tile ids that were removed.
+	 */
+	int32 Subtract(const FWFCTileBitset& Other);
+
+	/** Return true if any tile id is in both this and another set of the same width. */
+	bool Intersects(const FWFCTileBitset& Other) const;
+
+	/** Return the lowest tile id in the set, or INDEX_NONE if empty. */
+	int32 GetFirst() const;
+
+	/** Return the Nth lowest tile id in the set, or INDEX_NONE if out of range. */
+	int32 GetNth(int32 N) const;
+
+	/** Fill an array with every tile id in the set, in ascending order. */
+	void ToArray(TArray<int32>& OutTileIds) const;
+
+	TArray<int32> ToArray() const
+	{
+		TArray<int32> Result;
+		ToArray(Result);
+		return Result;
+	}
+
+	FORCEINLINE int32 GetNumWords() const { return Words.Num(); }
+
+	FORCEINLINE const uint64* GetWords() const { return Words.GetData(); }
+
+	/**
+	 * Return the raw words for direct modification.
+	 * RecountBits must be called after modifying the words to keep the cached count valid,
+	 * and bits beyond GetNumBits must remain cleared.
+	 */
+	FORCEINLINE uint64* GetMutableWords() { return Words.GetData(); }
+
+	/** Recalculate the cached count after modifying the words directly. */
+	void RecountBits();
+
+	static FORCEINLINE int32 GetNumWordsForBits(int32 InNumBits) { return (InNumBits + BitsPerWord - 1) / BitsPerWord; }
+
+	static FORCEINLINE uint64 GetBitMask(int32 Index) { return 1ull << (Index & (BitsPerWord - 1)); }
+
+	bool operator==(const FWFCTileBitset& Other) const
+	{
+		return NumBits == Other.NumBits && NumSet == Other.NumSet && Words == Other.Words;
+	}
+
+	bool operator!=(const FWFCTileBitset& Other) const
+	{
+		return !(operator==(Other));
+	}
+
+	/** Iterates the tile ids in the set, in ascending order. */
+	class FConstIterator
+	{
+	public:
+		FConstIterator(const uint64* InWords, int32 InNumWords, int32 InWordIndex)
+			: Words(InWords),
+			  NumWords(InNumWords),
+			  WordIndex(InWordIndex),
+			  Remaining(0)
+		{
+			SkipEmptyWords();
+		}
+
+		FORCEINLINE int32 operator*() const
+		{
+			return WordIndex * BitsPerWord + FMath::CountTrailingZeros64(Remaining);
+		}
+
+		FORCEINLINE FConstIterator& operator++()
+		{
+			// clear the lowest set bit
+			Remaining &= Remaining - 1;
+			SkipEmptyWords();
+			return *this;
+		}
+
+		FORCEINLINE bool operator!=(const FConstIterator& Other) const
+		{
+			return WordIndex != Other.WordIndex || Remaining != Other.Remaining;
+		}
+
+	private:
+		const uint64* Words;
+		int32 NumWords;
+		int32 WordIndex;
+		uint64 Remaining;
+
+		FORCEINLINE void SkipEmptyWords()
+		{
+			while (Remaining == 0 && ++WordIndex < NumWords)
+			{
+				Remaining = Words[WordIndex];
+			}
+		}
+	};
+
+	FORCEINLINE FConstIterator begin() const { return FConstIterator(Words.GetData(), Words.Num(), -1); }
+	// constructing an iterator always advances past the given word, so end starts on the last word
+	FORCEINLINE FConstIterator end() const { return FConstIterator(Words.GetData(), Words.Num(), Words.Num() - 1); }
+
+private:
+	/** The bits of the set, with bits beyond NumBits always cleared. */
+	UPROPERTY()
+	TArray<uint64> Words;
+
+	/** The number of tile ids this set can hold. */
+	UPROPERTY()
+	int32 NumBits;
+
+	/** The cached number of set bits. */
+	UPROPERTY()
+	int32 NumSet;
+
+	/** Clear any bits in the last word beyond NumBits. */
+	void ClearUnusedBits();
+};
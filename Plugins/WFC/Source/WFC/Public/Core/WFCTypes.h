@@ -3,6 +3,7 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "WFCTileBitset.h"
 #include "WFCTypes.generated.h"
 
 
@@ -40,6 +41,59 @@ enum class EWFCGeneratorStepPhase : uint8
 };
 
 
+/** The collapse status of a single cell, tracked by a WFCGenerator as candidates change. */
+UENUM()
+enum class EWFCCellStatus : uint8
+{
+	/** The cell has more than one candidate left. */
+	Open,
+	/** The cell has exactly one candidate left. */
+	Selected,
+	/** The cell has no candidates left. */
+	Contradiction,
+};
+
+
+/** How a generator component runs its generator. */
+UENUM(BlueprintType)
+enum class EWFCGeneratorRunMode : uint8
+{
+	/** Run the generator to completion on the game thread. */
+	Immediate,
+	/** Run the generator on a worker thread, forwarding its events to the game thread while it runs. */
+	Async,
+	/** Run the generator on the game thread over multiple frames, spending up to a fixed budget each frame. */
+	TimeSliced,
+	/** Solve seams between regions of a 2D grid first, then solve all regions at once on worker threads. */
+	Regions,
+};
+
+
+/** How an arc consistency constraint propagates banned tiles to neighboring cells. */
+UENUM(BlueprintType)
+enum class EWFCArcPropagationMode : uint8
+{
+	/**
+	 * Keep a count of the remaining supports of every tile in every cell and direction (AC4).
+	 * Each ban only visits the tiles it supported, but the counts take NumCells * NumDirections * NumTiles counters.
+	 */
+	SupportCounts,
+	/**
+	 * Check whole cells at once using a bitset of the allowed tiles for each tile and direction (bit-parallel AC3).
+	 * The allowed tiles of a changed cell's remaining candidates are combined one 64-bit word at a time and removed
+	 * from each neighbor, which needs no per-cell memory and is usually faster for rule sets where most tiles are
+	 * allowed next to each other.
+	 */
+	Bitsets,
+	/**
+	 * Remember the last tile found to support each tile in each cell and direction, and only search for a new support
+	 * once that tile is banned (AC3rm). Residues are only hints, so they are never restored when backtracking, and
+	 * they share a table limited by a memory budget once the grid is too large for one residue each.
+	 */
+	Residues,
+};
+
+
 /**
  * The granularity to use when stepping the generator forward.
  * Determines when to break after certain work is done.
@@ -78,15 +132,15 @@ struct FWFCCell
 	{
 	}
 
-	/** The array of tile candidates for this cell. */
+	/** The set of tile candidates for this cell. */
 	UPROPERTY()
-	TArray<int32> TileCandidates;
+	FWFCTileBitset TileCandidates;
 
 	/** The phase during which this cell was fully collapsed. */
 	UPROPERTY()
 	EWFCGeneratorStepPhase CollapsePhase;
 
-	FORCEINLINE bool HasNoCandidates() const { return TileCandidates.Num() == 0; }
+	FORCEINLINE bool HasNoCandidates() const { return TileCandidates.IsEmpty(); }
 
 	/** Return true if this cell has one valid tile selected for it */
 	FORCEINLINE bool HasSelection() const { return TileCandidates.Num() == 1; }
@@ -94,16 +148,19 @@ struct FWFCCell
 	FORCEINLINE bool HasSelectionOrNoCandidates() const { return TileCandidates.Num() <= 1; }
 
 	/** @return True if the candidates were changed */
-	bool AddCandidate(FWFCTileId TileId);
+	FORCEINLINE bool AddCandidate(FWFCTileId TileId) { return TileCandidates.Add(TileId); }
 
 	/** @return True if the candidates were changed */
-	bool RemoveCandidate(FWFCTileId TileId);
+	FORCEINLINE bool RemoveCandidate(FWFCTileId TileId) { return TileCandidates.Remove(TileId); }
 
 	/** Return the selected tile id, or INDEX_NONE if not selected */
-	FORCEINLINE FWFCTileId GetSelectedTileId() const { return TileCandidates.Num() == 1 ? TileCandidates[0] : INDEX_NONE; }
+	FORCEINLINE FWFCTileId GetSelectedTileId() const { return TileCandidates.Num() == 1 ? TileCandidates.GetFirst() : INDEX_NONE; }
 
 	/** Return true if any of the tile ids are a candidate for a cell. */
 	bool HasAnyMatchingCandidate(const TArray<FWFCTileId>& TileIds) const;
+
+	/** Return true if any of the tile ids in a set are a candidate for a cell. */
+	FORCEINLINE bool HasAnyMatchingCandidate(const FWFCTileBitset& TileIds) const { return TileCandidates.Intersects(TileIds); }
 };
 
 
@@ -4,10 +4,12 @@
 
 #include "CoreMinimal.h"
 #include "WFCTileSetConfig.h"
+#include "Core/WFCTypes.h"
 #include "Engine/DataAsset.h"
 #include "WFCAsset.generated.h"
 
 class UWFCCellSelector;
+class UWFCCompiledModel;
 class UWFCConstraint;
 class UWFCGenerator;
 class UWFCGeneratorSnapshot;
@@ -46,6 +48,38 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, DisplayName = "Model", Category = "Config")
 	TSubclassOf<UWFCModel> ModelClass;
 
+	/**
+	 * The maximum number of times a selection that led to a contradiction can be undone before generation fails.
+	 * Backtracking records every ban made after the first selection, so 0 disables it to save memory.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (ClampMin = "0"), Category = "Config")
+	int32 MaxBacktracks;
+
+	/**
+	 * The maximum number of times to start over with a new seed when a contradiction can't be resolved by backtracking.
+	 * Restarts restore the state from right before the first selection, so startup constraints are not run again.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (ClampMin = "0"), Category = "Config")
+	int32 MaxRestarts;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (InlineEditConditionToggle), Category = "Config")
+	bool bOverrideArcPropagationMode;
+
+	/**
+	 * How every arc consistency constraint, such as the adjacency constraint, propagates bans between cells.
+	 * Support counts need memory for every cell, tile, and direction, so large grids should use another mode.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (EditCondition = "bOverrideArcPropagationMode"), Category = "Config")
+	EWFCArcPropagationMode ArcPropagationMode;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (InlineEditConditionToggle), Category = "Config")
+	bool bOverrideArcResidueMemoryBudget;
+
+	/** The maximum memory in MB for the residual supports of each arc consistency constraint using the Residues mode. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Config",
+		Meta = (EditCondition = "bOverrideArcResidueMemoryBudget", ClampMin = "1"))
+	int32 ArcResidueMemoryBudgetMB;
+
 	/** The grid and configuration. */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Instanced, Category = "Config")
 	TObjectPtr<UWFCGridConfig> GridConfig;
@@ -83,6 +117,13 @@ public:
 	UPROPERTY(EditAnywhere, Instanced, Category = "Snapshot")
 	TObjectPtr<UWFCGeneratorSnapshot> StartupSnapshot;
 
+	/**
+	 * Rules built by constraints from the tiles, such as allowed adjacent tiles, which don't depend on the grid size.
+	 * Compiled whenever this asset is saved or cooked, and ignored by generators if the tiles have changed since.
+	 */
+	UPROPERTY(VisibleAnywhere, Instanced, Category = "Snapshot")
+	TObjectPtr<UWFCCompiledModel> CompiledModel;
+
 #if WITH_EDITOR
 	virtual void PreSave(FObjectPreSaveContext SaveContext) override;
 	virtual EDataValidationResult IsDataValid(FDataValidationContext& Context) override;
@@ -90,5 +131,13 @@ public:
 	/** Update the startup snapshot to cache the WFC state after deterministic constraints have run the first time. */
 	UFUNCTION(BlueprintCallable, CallInEditor)
 	virtual void UpdateSnapshot();
+
+	/** Update the compiled model to match the current tiles and constraints. */
+	UFUNCTION(BlueprintCallable, CallInEditor)
+	virtual void UpdateCompiledModel();
+
+protected:
+	/** Compile the current tiles and constraints into the compiled model, without marking the asset as modified. */
+	void RebuildCompiledModel();
 #endif
 };
@@ -52,6 +52,7 @@ public:
 	virtual void GenerateTiles() override;
 
 	virtual FString GetTileDebugString(FWFCTileId TileId) const override;
+	virtual void AppendContentHash(FXxHash64Builder& Builder, int32 NumDirections) const override;
 
 protected:
 	/** Map of all tile ids indexed by tile asset and tile def index. */
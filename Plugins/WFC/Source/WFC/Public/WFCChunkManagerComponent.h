@@ -0,0 +1,259 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/SceneComponent.h"
+#include "Core/WFCTypes.h"
+#include "Tasks/Task.h"
+#include "WFCChunkManagerComponent.generated.h"
+
+class UWFCAsset;
+class UWFCGenerator;
+class UWFCGeneratorSnapshot;
+class UWFCGrid2D;
+class UWFCGrid2DConfig;
+class UWFCModel;
+struct FWFCChunkGenerationState;
+
+
+UENUM(BlueprintType)
+enum class EWFCChunkState : uint8
+{
+	None,
+	/** The chunk is being generated on a worker thread. */
+	Generating,
+	/** The chunk was generated and has a tile for every cell. */
+	Generated,
+	/** The chunk could not be generated, and has no tiles. */
+	Failed,
+};
+
+
+/** A chunk of cells managed by a chunk manager. */
+struct FWFCChunk
+{
+	FWFCChunk()
+		: State(EWFCChunkState::None),
+		  NumFailures(0),
+		  RetryTime(0.0)
+	{
+	}
+
+	EWFCChunkState State;
+
+	/** The number of times generating the chunk has failed. */
+	int32 NumFailures;
+
+	/** The world time after which a failed chunk can be generated again. */
+	double RetryTime;
+
+	/** The selected tile for each cell of the chunk, by local cell location (X + Y * ChunkSize.X). */
+	TArray<FWFCTileId> TileIds;
+
+	/** State shared with the worker thread while generating, or null. */
+	TSharedPtr<FWFCChunkGenerationState> GenerationState;
+
+	/** The task generating the chunk. */
+	UE::Tasks::FTask Task;
+};
+
+
+/**
+ * A component that generates an unbounded 2D world as fixed-size chunks around streaming sources.
+ *
+ * Each chunk uses the grid of the WFC asset, with one extra cell of padding on every side. Padding cells that
+ * belong to already generated neighbor chunks are fixed to their tiles, so that the new chunk matches its seams.
+ * Chunks are generated on worker threads, never next to another generating chunk, and only the selected tiles are
+ * kept once a chunk is done. Chunks far from every streaming source are evicted, so memory stays bounded.
+ *
+ * Each chunk's seed is derived from its coordinates, but seams depend on which neighbors existed when it was
+ * generated, so results only repeat if chunks are generated in the same order. Chunks that fail are retried
+ * with a new seed after a delay, until they succeed or run out of retries.
+ *
+ * The world has no edges, so the asset's boundary constraint is not used by chunk generators.
+ */
+UCLASS(ClassGroup=(Procedural), meta=(BlueprintSpawnableComponent))
+class WFC_API UWFCChunkManagerComponent : public USceneComponent
+{
+	GENERATED_BODY()
+
+public:
+	UWFCChunkManagerComponent();
+
+	/** The asset used to generate every chunk. It must use a 2D grid, whose dimensions are the size of each chunk. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	TObjectPtr<UWFCAsset> WFCAsset;
+
+	/** The maximum number of steps to allow when generating a chunk. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 StepLimit;
+
+	/** The seed combined with the coordinates of each chunk to derive the seed for that chunk. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 Seed;
+
+	/** Chunks within this many chunks of a streaming source are generated. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (ClampMin = "0"))
+	int32 GenerationRadius;
+
+	/** Chunks further than this many chunks from every streaming source are evicted. Must be at least GenerationRadius. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (ClampMin = "0"))
+	int32 EvictionRadius;
+
+	/** The maximum number of times to generate a chunk again after it fails, each time with a new seed. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (ClampMin = "0"))
+	int32 MaxChunkRetries;
+
+	/** The time in seconds to wait before generating a failed chunk again, doubled after each failure. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (ClampMin = "0"))
+	float ChunkRetryDelay;
+
+	/** The maximum number of chunks to generate at once. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (ClampMin = "1"))
+	int32 MaxConcurrentChunks;
+
+	/** If true, the view location of each player is used as a streaming source. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bUsePlayerStreamingSources;
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	/** Add an actor whose location chunks are generated around. */
+	UFUNCTION(BlueprintCallable)
+	void AddStreamingSource(AActor* Actor);
+
+	UFUNCTION(BlueprintCallable)
+	void RemoveStreamingSource(AActor* Actor);
+
+	/** Evict every chunk, cancelling any that are being generated. */
+	UFUNCTION(BlueprintCallable)
+	void ResetChunks();
+
+	/** Return the number of cells in each chunk, not including padding. */
+	UFUNCTION(BlueprintPure)
+	FIntPoint GetChunkSize() const { return ChunkSize; }
+
+	/** Return the coordinates of the chunk containing a world location. */
+	UFUNCTION(BlueprintPure)
+	FIntPoint GetChunkCoordForLocation(FVector WorldLocation) const;
+
+	/** Return the coordinates of the chunk containing a cell, by cell coordinates across all chunks. */
+	UFUNCTION(BlueprintPure)
+	FIntPoint GetChunkCoordForCell(FIntPoint CellCoord) const;
+
+	UFUNCTION(BlueprintPure)
+	EWFCChunkState GetChunkState(FIntPoint ChunkCoord) const;
+
+	/** Return the selected tile ids of a generated chunk, by local cell location (X + Y * ChunkSize.X). */
+	UFUNCTION(BlueprintCallable, BlueprintPure = false)
+	void GetChunkTileIds(FIntPoint ChunkCoord, TArray<int32>& OutTileIds) const;
+
+	/** Return the selected tile id of a cell by cell coordinates across all chunks, or INDEX_NONE if not generated. */
+	UFUNCTION(BlueprintPure)
+	int32 GetTileIdForCell(FIntPoint CellCoord) const;
+
+	/** Return the world transform of a cell by cell coordinates across all chunks. */
+	UFUNCTION(BlueprintPure)
+	FTransform GetCellWorldTransform(FIntPoint CellCoord, int32 Rotation) const;
+
+	/** Return the model shared by every chunk, for retrieving tiles by id. */
+	UFUNCTION(BlueprintPure)
+	UWFCModel* GetModel() const { return Model; }
+
+	/** Return the number of chunks currently being generated. */
+	UFUNCTION(BlueprintPure)
+	int32 GetNumGeneratingChunks() const;
+
+	DECLARE_MULTICAST_DELEGATE_TwoParams(FChunkGeneratedDelegate, FIntPoint /*ChunkCoord*/, bool /*bSuccess*/);
+
+	/** Called when a chunk has finished generating. */
+	FChunkGeneratedDelegate OnChunkGeneratedEvent;
+
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FChunkGeneratedDynDelegate, FIntPoint, ChunkCoord, bool, bSuccess);
+
+	UPROPERTY(BlueprintAssignable)
+	FChunkGeneratedDynDelegate OnChunkGeneratedEvent_BP;
+
+	DECLARE_MULTICAST_DELEGATE_OneParam(FChunkEvictedDelegate, FIntPoint /*ChunkCoord*/);
+
+	/** Called before a chunk is evicted, while its tiles are still available. */
+	FChunkEvictedDelegate OnChunkEvictedEvent;
+
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FChunkEvictedDynDelegate, FIntPoint, ChunkCoord);
+
+	UPROPERTY(BlueprintAssignable)
+	FChunkEvictedDynDelegate OnChunkEvictedEvent_BP;
+
+protected:
+	/** The model shared by every chunk generator. */
+	UPROPERTY(Transient)
+	TObjectPtr<UWFCModel> Model;
+
+	/** The asset's grid config with one cell of padding on every side, used by every chunk generator. */
+	UPROPERTY(Transient)
+	TObjectPtr<UWFCGrid2DConfig> PaddedGridConfig;
+
+	/** A grid of one chunk, used to calculate cell transforms. */
+	UPROPERTY(Transient)
+	TObjectPtr<UWFCGrid2D> ChunkGrid;
+
+	/** A snapshot of a chunk after startup and before any seams are added, which every chunk starts from. */
+	UPROPERTY(Transient)
+	TObjectPtr<UWFCGeneratorSnapshot> StartupSnapshot;
+
+	UPROPERTY(Transient)
+	TArray<TWeakObjectPtr<AActor>> StreamingSources;
+
+	/** The number of cells in each chunk, not including padding. */
+	FIntPoint ChunkSize;
+
+	TMap<FIntPoint, FWFCChunk> Chunks;
+
+	/** Create the shared model, grid config, and startup snapshot. */
+	bool InitializeChunks();
+
+	/** Use the padded grid and the chunk constraints for a new chunk generator, before it is initialized. */
+	void ConfigureChunkGenerator(UWFCGenerator* Generator) const;
+
+	/** Return the chunk coordinates of every streaming source. */
+	void GetStreamingSourceChunkCoords(TArray<FIntPoint>& OutChunkCoords) const;
+
+	/** Evict chunks that are too far from every streaming source. */
+	void EvictDistantChunks(const TArray<FIntPoint>& SourceChunkCoords);
+
+	/** Evict a chunk, cancelling it if it is being generated. */
+	void EvictChunk(FIntPoint ChunkCoord);
+
+	/** Collect the results of chunks that have finished generating. */
+	void FinishGeneratedChunks();
+
+	/** Start generating the nearest missing chunks around streaming sources. */
+	void StartChunksNearSources(const TArray<FIntPoint>& SourceChunkCoords);
+
+	/**
+	 * Return true if a chunk can start generating, which requires that it is missing or a failed chunk that is ready to retry,
+	 * and that none of its neighbors are generating.
+	 */
+	bool CanStartChunk(FIntPoint ChunkCoord) const;
+
+	/** Return true if a chunk failed to generate, and is ready to be generated again. */
+	bool CanRetryChunk(const FWFCChunk& Chunk) const;
+
+	/** Create a generator for a chunk and start generating it on a worker thread. */
+	void StartChunk(FIntPoint ChunkCoord);
+
+	/** Fix the padding cells of a chunk generator to the tiles of already generated neighbor chunks. */
+	void AddSeamTiles(FIntPoint ChunkCoord, UWFCGenerator* Generator) const;
+
+	/** Return the seed for a chunk, which is different for each retry after a failure. */
+	int32 GetChunkSeed(FIntPoint ChunkCoord, int32 NumFailures = 0) const;
+
+	/** Return the eviction radius, which is never less than the generation radius. */
+	int32 GetEffectiveEvictionRadius() const { return FMath::Max(EvictionRadius, GenerationRadius); }
+
+	/** Return the distance between two chunks, in chunks along the furthest axis. */
+	static int32 GetChunkDistance(FIntPoint A, FIntPoint B);
+};
@@ -0,0 +1,39 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/Guid.h"
+
+
+/** Custom serialization version for changes to WFC snapshot data. */
+struct WFC_API FWFCCustomVersion
+{
+	enum Type
+	{
+		// Before any version changes were made
+		BeforeCustomVersionWasAdded = 0,
+
+		// Arc consistency support counts are stored as a single flat buffer of narrow counters
+		FlatArcSupportCounts,
+
+		// Compiled models were added to WFC assets
+		CompiledModel,
+
+		// Snapshots store cell candidates as flat bitset words, and arc consistency support counts as deltas from defaults
+		CompactSnapshots,
+
+		// Arc consistency snapshots only store the rows of support counts that were written
+		SparseArcSupportCounts,
+
+		// -----<new versions can be added above this line>-------------------------------------------------
+		VersionPlusOne,
+		LatestVersion = VersionPlusOne - 1
+	};
+
+	/** The GUID for this custom version number. */
+	const static FGuid GUID;
+
+private:
+	FWFCCustomVersion() = default;
+};
@@ -5,11 +5,13 @@
 #include "CoreMinimal.h"
 #include "Components/SceneComponent.h"
 #include "Core/WFCTypes.h"
+#include "Tasks/Task.h"
 #include "WFCGeneratorComponent.generated.h"
 
 class UWFCAsset;
 class UWFCGenerator;
 class UWFCGrid;
+struct FWFCGeneratorAsyncRunState;
 
 
 USTRUCT(BlueprintType)
@@ -82,10 +84,33 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	bool bUseStartupSnapshot;
 
+	/** If true, use a new random seed each time the generator is initialized. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bUseRandomSeed;
+
+	/** The seed to use for the generator. The same seed and asset will always produce the same result. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (EditCondition = "!bUseRandomSeed"))
+	int32 Seed;
+
 	/** If true, automatically run the generator on begin play. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	bool bAutoRun;
 
+	/** How to run the generator when calling Run. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	EWFCGeneratorRunMode RunMode;
+
+	/**
+	 * The time in milliseconds to spend running the generator each frame when time sliced.
+	 * At least one step is always run per frame, and some steps can't be divided, such as initial constraint setup.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (ClampMin = "0.01", EditCondition = "RunMode == EWFCGeneratorRunMode::TimeSliced"))
+	float FrameBudgetMs;
+
+	/** The number of cells in each region when solving regions, not including the seams between them. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (ClampMin = "1", EditCondition = "RunMode == EWFCGeneratorRunMode::Regions"))
+	FIntPoint RegionSize;
+
 	/** The granularity to use when calling Next. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	EWFCGeneratorStepGranularity StepGranularity;
@@ -98,6 +123,8 @@ public:
 	FWFCGeneratorDebugSettings DebugSettings;
 
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
 	/** Initialize the WFC model and generator */
 	UFUNCTION(BlueprintCallable)
@@ -111,10 +138,51 @@ public:
 	UFUNCTION(BlueprintCallable)
 	void ResetGenerator();
 
-	/** Run the generator and spawn all actors */
+	/** Run the generator and spawn all actors, using the current run mode. */
 	UFUNCTION(BlueprintCallable)
 	void Run();
 
+	/**
+	 * Run the generator on a worker thread. Cell selected and state changed events are broadcast on the game thread
+	 * during the following ticks, and the generator should not be accessed directly until it has finished.
+	 */
+	UFUNCTION(BlueprintCallable)
+	void RunAsync();
+
+	/**
+	 * Run the generator on the game thread over multiple frames, spending up to FrameBudgetMs each frame.
+	 * Constraints are stepped at a detailed granularity so that the generator can yield within propagation.
+	 */
+	UFUNCTION(BlueprintCallable)
+	void RunTimeSliced();
+
+	/**
+	 * Run the generator by solving the seams between regions of its 2D grid first, then solving all regions
+	 * at once on worker threads. Blocks until finished, and events are broadcast as cells are merged back in.
+	 */
+	UFUNCTION(BlueprintCallable)
+	void RunRegions();
+
+	/** Stop an async or time sliced run. Async runs stop as soon as the current step completes, and are waited for. */
+	UFUNCTION(BlueprintCallable)
+	void CancelRun();
+
+	/** Return true if the generator is currently running on a worker thread. */
+	UFUNCTION(BlueprintPure)
+	bool IsRunningAsync() const;
+
+	/** Return true if the generator is currently running over multiple frames. */
+	UFUNCTION(BlueprintPure)
+	bool IsRunningTimeSliced() const { return bIsRunningTimeSliced; }
+
+	/** Return the number of frames used by the current or last time sliced run. */
+	UFUNCTION(BlueprintPure)
+	int32 GetNumTimeSlicedFrames() const { return NumTimeSlicedFrames; }
+
+	/** Return the fraction of cells that have a tile selected, safe to call while running async. */
+	UFUNCTION(BlueprintPure)
+	float GetProgress() const;
+
 	/** Iterate the generator one step. */
 	UFUNCTION(BlueprintCallable)
 	void Next();
@@ -123,19 +191,24 @@ public:
 	UFUNCTION(BlueprintPure)
 	const UWFCGrid* GetGrid() const;
 
+	/** Return the seed used by the current generator, e.g. to reproduce a random seed result. */
+	UFUNCTION(BlueprintPure)
+	int32 GetGeneratorSeed() const;
+
 	/** Return the current state of the generator */
 	UFUNCTION(BlueprintPure)
 	EWFCGeneratorState GetState() const;
 
 	/**
 	 * Return a selected tile id by cell index.
+	 * While running async, this is only safe to call for the cell of a cell selected event.
 	 * @see Model for retrieving tile objects.
 	 */
 	UFUNCTION(BlueprintCallable, BlueprintPure = false)
 	void GetSelectedTileId(int32 CellIndex, bool& bSuccess, int32& TileId) const;
 
 	/**
-	 * Return the selected tile ids for every cell in the grid.
+	 * Return the selected tile ids for every cell in the grid, or nothing while running async.
 	 * @see Model for retrieving tile objects.
 	 */
 	UFUNCTION(BlueprintCallable, BlueprintPure = false)
@@ -150,6 +223,17 @@ public:
 	UPROPERTY(BlueprintAssignable)
 	FCellSelectedDynDelegate OnCellSelectedEvent_BP;
 
+	DECLARE_MULTICAST_DELEGATE_OneParam(FCellUnselectedDelegate, int32 /*CellIndex*/);
+
+	/** Called when a cell that was selected has been reopened or changed by backtracking or restarting the generator. */
+	FCellUnselectedDelegate OnCellUnselectedEvent;
+
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FCellUnselectedDynDelegate, int32, CellIndex);
+
+	/** Called when a cell that was selected has been reopened or changed by backtracking or restarting the generator. */
+	UPROPERTY(BlueprintAssignable)
+	FCellUnselectedDynDelegate OnCellUnselectedEvent_BP;
+
 	DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FStateChangedDynDelegate, EWFCGeneratorState, State);
 
 	/** Called when the generator state has changed */
@@ -173,6 +257,32 @@ protected:
 	UPROPERTY(Transient, BlueprintReadOnly)
 	TObjectPtr<UWFCGenerator> Generator = nullptr;
 
+	/** State shared with the worker thread during an async run, or null if not running. */
+	TSharedPtr<FWFCGeneratorAsyncRunState> AsyncRunState;
+
+	/** The task running the generator during an async run. */
+	UE::Tasks::FTask AsyncRunTask;
+
+	bool bIsRunningTimeSliced = false;
+
+	int32 NumTimeSlicedFrames = 0;
+
+	/** The number of steps run by the current time sliced run, limited by StepLimit. */
+	int32 NumTimeSlicedSteps = 0;
+
+	/** Run the generator for one frame of a time sliced run. */
+	void TickTimeSlicedRun();
+
+	/** Stop a time sliced run and stop ticking if nothing else needs it. */
+	void FinishTimeSlicedRun();
+
+	/** Broadcast events queued by an async run, and clean up once it has completed. */
+	void DispatchAsyncRunEvents();
+
+	/** Release everything held for an async run, after the task has completed. */
+	void FinishAsyncRun();
+
 	void OnCellSelected(int32 CellIndex);
+	void OnCellUnselected(int32 CellIndex);
 	void OnStateChanged(EWFCGeneratorState State);
 };
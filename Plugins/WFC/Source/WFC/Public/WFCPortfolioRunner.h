@@ -0,0 +1,64 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "WFCPortfolioRunner.generated.h"
+
+class UWFCAsset;
+class UWFCGenerator;
+class UWFCModel;
+
+
+/**
+ * Runs several generators for the same WFC asset at once with different seeds, and keeps the first one to succeed.
+ * All generators share one model, and start from one snapshot taken after startup, so the arc consistency
+ * adjacency table is also shared between them. Once a generator finishes, the others are cancelled.
+ */
+UCLASS(BlueprintType)
+class WFC_API UWFCPortfolioRunner : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * Create all generators and run their startup, must be called on the game thread.
+	 * @param NumGenerators The number of generators to run at once.
+	 * @param Seed The seed used to derive the seed of each generator.
+	 * @return True if every generator was created.
+	 */
+	UFUNCTION(BlueprintCallable)
+	bool Initialize(UWFCAsset* InWFCAsset, int32 NumGenerators, int32 Seed);
+
+	/**
+	 * Run all generators on worker threads, blocking until one finishes or all have stopped.
+	 * Must be called on the game thread.
+	 * @return The generator that finished first, or null if none finished.
+	 */
+	UFUNCTION(BlueprintCallable)
+	UWFCGenerator* Run(int32 StepLimit = 100000);
+
+	/** Return the generator that finished first during the last run. */
+	UFUNCTION(BlueprintPure)
+	UWFCGenerator* GetWinner() const { return Winner; }
+
+	/** Return the model shared by all generators. */
+	UFUNCTION(BlueprintPure)
+	UWFCModel* GetModel() const { return Model; }
+
+	const TArray<TObjectPtr<UWFCGenerator>>& GetGenerators() const { return Generators; }
+
+protected:
+	UPROPERTY(Transient)
+	TObjectPtr<UWFCAsset> WFCAsset;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UWFCModel> Model;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UWFCGenerator>> Generators;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UWFCGenerator> Winner;
+};
@@ -0,0 +1,101 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "WFCRegionSolver.generated.h"
+
+class UWFCGenerator;
+class UWFCGeneratorSnapshot;
+class UWFCGrid2D;
+class UWFCGrid2DConfig;
+
+
+/** A rectangle of cells in a region solver's grid, solved by its own generator. */
+struct FWFCSolverRegion
+{
+	FWFCSolverRegion()
+		: Min(FIntPoint::ZeroValue),
+		  Max(FIntPoint::ZeroValue),
+		  InteriorMin(FIntPoint::ZeroValue),
+		  InteriorMax(FIntPoint::ZeroValue),
+		  Generator(nullptr)
+	{
+	}
+
+	/** The first and last cell of the region's grid, which includes the surrounding seam cells. */
+	FIntPoint Min;
+	FIntPoint Max;
+
+	/** The first and last cell that is solved by the region. */
+	FIntPoint InteriorMin;
+	FIntPoint InteriorMax;
+
+	/** The generator for the region, referenced by the solver during a solve. */
+	UWFCGenerator* Generator;
+
+	FIntPoint GetSize() const { return Max - Min + FIntPoint(1, 1); }
+};
+
+
+/**
+ * Solves a large 2D grid by splitting it into regions that are solved at the same time on worker threads.
+ *
+ * The cells between regions are collapsed first by the main generator, forming seams one cell wide.
+ * Each region then gets its own generator, covering the region and its surrounding seam cells, and starts
+ * with the candidates of the main generator so that it matches the seams and any startup constraints.
+ * Regions are merged back into the main generator once solved, and any region that failed is solved
+ * afterwards by running the main generator normally.
+ *
+ * Boundary and fixed tile constraints are not used by region generators, since their effect is already
+ * part of the candidates from the main generator. Other constraints that aren't local, such as tile counts,
+ * only apply within each region.
+ */
+UCLASS(BlueprintType)
+class WFC_API UWFCRegionSolver : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UWFCRegionSolver();
+
+	/** The number of cells in each region, not including seams. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (ClampMin = "1"))
+	FIntPoint RegionSize;
+
+	/**
+	 * Solve an initialized generator with a 2D grid, blocking until done. Must be called on the game thread.
+	 * @return True if the generator finished.
+	 */
+	UFUNCTION(BlueprintCallable)
+	bool Solve(UWFCGenerator* Generator, int32 StepLimit = 100000);
+
+protected:
+	/** The region generators of the current solve. */
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UWFCGenerator>> RegionGenerators;
+
+	/** The grid configs for each size of region, referenced weakly by region generators. */
+	UPROPERTY(Transient)
+	TMap<FIntPoint, TObjectPtr<UWFCGrid2DConfig>> RegionGridConfigs;
+
+	/** Snapshots after startup for each size of region, so that region generators share their adjacency. */
+	UPROPERTY(Transient)
+	TMap<FIntPoint, TObjectPtr<UWFCGeneratorSnapshot>> RegionSnapshots;
+
+	/** Return true if a cell is on a seam between regions. */
+	bool IsSeamCell(FIntPoint CellLocation) const;
+
+	/** Split a grid of some dimensions into regions. */
+	void CreateRegions(FIntPoint Dimensions, TArray<FWFCSolverRegion>& OutRegions) const;
+
+	/** Collapse every seam cell of the main generator. */
+	void SolveSeams(UWFCGenerator* Generator, const UWFCGrid2D* Grid, int32 StepLimit) const;
+
+	/** Create and initialize the generator for a region, starting from the candidates of the main generator. */
+	UWFCGenerator* CreateRegionGenerator(UWFCGenerator* Generator, const UWFCGrid2D* Grid, const FWFCSolverRegion& Region);
+
+	/** Select the solved interior cells of a region in the main generator. */
+	void MergeRegion(UWFCGenerator* Generator, const UWFCGrid2D* Grid, const FWFCSolverRegion& Region) const;
+};
@@ -10,6 +10,8 @@
 
 class UWFCAsset;
 class UWFCGenerator;
+class UWFCModel;
+class UWFCPortfolioRunner;
 extern TAutoConsoleVariable<float> CVarWFCDebugStepInterval;
 
 
@@ -36,5 +38,21 @@ public:
 
 	/** Create and initialize a WFC generator from a WFC Asset. */
 	UFUNCTION(BlueprintCallable)
-	static UWFCGenerator* CreateWFCGenerator(UObject* Outer, UWFCAsset* WFCAsset);
+	static UWFCGenerator* CreateWFCGenerator(UObject* Outer, UWFCAsset* WFCAsset, int32 Seed = 0);
+
+	/**
+	 * Create and initialize a WFC generator from a WFC Asset, using an existing model.
+	 * The model can be shared by any number of generators, and is only generated once.
+	 */
+	UFUNCTION(BlueprintCallable)
+	static UWFCGenerator* CreateWFCGeneratorWithModel(UObject* Outer, UWFCAsset* WFCAsset, UWFCModel* Model, int32 Seed = 0);
+
+	/**
+	 * Create a runner that races several generators for a WFC Asset with different seeds,
+	 * and keeps the first one to finish successfully.
+	 * @param NumGenerators The number of generators to run at once.
+	 * @param Seed The seed used to derive the seed of each generator.
+	 */
+	UFUNCTION(BlueprintCallable)
+	static UWFCPortfolioRunner* CreateWFCPortfolioRunner(UObject* Outer, UWFCAsset* WFCAsset, int32 NumGenerators = 4, int32 Seed = 0);
 };
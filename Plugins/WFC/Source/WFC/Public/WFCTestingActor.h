@@ -72,6 +72,10 @@ public:
 	UFUNCTION(BlueprintCallable, CallInEditor, Category = "WFC")
 	virtual void LoadAllTileActorLevels();
 
+	/** Destroy the spawned tile instance actor for a cell, if there is one. */
+	UFUNCTION(BlueprintCallable, Category = "WFC")
+	virtual void DestroyActorForCell(int32 CellIndex);
+
 	/** Destroy all spawned tile instance actors. */
 	UFUNCTION(BlueprintCallable, CallInEditor, Category = "WFC")
 	virtual void DestroyAllSpawnedActors();
@@ -86,6 +90,9 @@ protected:
 	/** Called when the generator has selected a cell. */
 	void OnCellSelected(int32 CellIndex);
 
+	/** Called when the generator has undone the selection of a cell. */
+	void OnCellUnselected(int32 CellIndex);
+
 	/** Called when the generator has finished. */
 	void OnGeneratorFinished(EWFCGeneratorState State);
 };
@@ -0,0 +1,132 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+
+#include "WFCTestTypes.h"
+#include "Core/WFCCellSelector.h"
+#include "Core/WFCGenerator.h"
+#include "Core/Grids/WFCGrid2D.h"
+#include "Misc/AutomationTest.h"
+#include "UObject/Package.h"
+
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace WFCBacktrackingTests
+{
+	/**
+	 * Create a generator for a row of cells that can each be tile 0 or 1, where selecting tile 0 for cell 0 is a contradiction.
+	 * @param bPreferTileZero If true, tile 1 has no weight, so tile 0 is always selected first and the contradiction can't be avoided.
+	 */
+	UWFCGenerator* CreateGenerator(int32 NumCells, int32 MaxBacktracks, int32 MaxRestarts, int32 Seed,
+	                               bool bPreferTileZero, int32 NumContradictingAttempts = 0)
+	{
+		UWFCTestModel* Model = NewObject<UWFCTestModel>(GetTransientPackage());
+		if (bPreferTileZero)
+		{
+			Model->TestTileWeights = {1.f, 0.f};
+		}
+
+		UWFCGrid2DConfig* GridConfig = NewObject<UWFCGrid2DConfig>(GetTransientPackage());
+		GridConfig->Dimensions = FIntPoint(NumCells, 1);
+
+		FWFCGeneratorConfig Config;
+		Config.Model = Model;
+		Config.GridConfig = GridConfig;
+		Config.ConstraintClasses.Add(UWFCTestContradictionConstraint::StaticClass());
+		Config.CellSelectorClasses.Add(UWFCRandomCellSelector::StaticClass());
+		Config.Seed = Seed;
+		Config.MaxBacktracks = MaxBacktracks;
+		Config.MaxRestarts = MaxRestarts;
+
+		UWFCGenerator* Generator = NewObject<UWFCGenerator>(GetTransientPackage());
+		Generator->Configure(Config);
+		Generator->Initialize();
+
+		UWFCTestContradictionConstraint* Constraint = Generator->GetConstraint<UWFCTestContradictionConstraint>();
+		check(Constraint);
+		Constraint->NumContradictingAttempts = NumContradictingAttempts;
+
+		return Generator;
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FWFCBacktrackingRecoverTest, "WFC.Backtracking.Recover",
+                                 EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FWFCBacktrackingRecoverTest::RunTest(const FString& Parameters)
+{
+	// tile 0 is always selected first, so cell 0 contradicts once and must be backtracked to tile 1
+	UWFCGenerator* Generator = WFCBacktrackingTests::CreateGenerator(4, 4, 0, 0, true);
+	Generator->Run(100);
+
+	TestTrue(TEXT("Generator finished"), Generator->State == EWFCGeneratorState::Finished);
+	TestEqual(TEXT("Num backtracks"), Generator->GetNumBacktracks(), 1);
+	TestEqual(TEXT("Num restarts"), Generator->GetNumRestarts(), 0);
+	TestEqual(TEXT("Cell 0 tile"), Generator->GetCell(0).GetSelectedTileId(), 1);
+	for (int32 CellIndex = 1; CellIndex < Generator->GetNumCells(); ++CellIndex)
+	{
+		TestEqual(FString::Printf(TEXT("Cell %d tile"), CellIndex), Generator->GetCell(CellIndex).GetSelectedTileId(), 0);
+	}
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FWFCBacktrackingNoBacktracksTest, "WFC.Backtracking.NoBacktracks",
+                                 EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FWFCBacktrackingNoBacktracksTest::RunTest(const FString& Parameters)
+{
+	// without backtracks or restarts the same contradiction is an error
+	UWFCGenerator* Generator = WFCBacktrackingTests::CreateGenerator(4, 0, 0, 0, true);
+	Generator->Run(100);
+
+	TestTrue(TEXT("Generator failed"), Generator->State == EWFCGeneratorState::Error);
+	TestEqual(TEXT("Num backtracks"), Generator->GetNumBacktracks(), 0);
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FWFCBacktrackingRestartTest, "WFC.Backtracking.Restart",
+                                 EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FWFCBacktrackingRestartTest::RunTest(const FString& Parameters)
+{
+	// only the first attempt contradicts, and without backtracking it can only recover by restarting
+	UWFCGenerator* Generator = WFCBacktrackingTests::CreateGenerator(4, 0, 3, 0, true, 1);
+	Generator->Run(100);
+
+	TestTrue(TEXT("Generator finished"), Generator->State == EWFCGeneratorState::Finished);
+	TestEqual(TEXT("Num restarts"), Generator->GetNumRestarts(), 1);
+	TestNotEqual(TEXT("Attempt seed"), Generator->GetAttemptSeed(), Generator->GetSeed());
+	TestEqual(TEXT("Cell 0 tile"), Generator->GetCell(0).GetSelectedTileId(), 0);
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FWFCBacktrackingDeterministicRestartsTest, "WFC.Backtracking.DeterministicRestarts",
+                                 EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FWFCBacktrackingDeterministicRestartsTest::RunTest(const FString& Parameters)
+{
+	// every attempt can contradict, depending on the random tile selected for cell 0,
+	// so the number of restarts and the result both come from the seed, and must match between runs
+	constexpr int32 Seed = 1234;
+	UWFCGenerator* GeneratorA = WFCBacktrackingTests::CreateGenerator(16, 0, 8, Seed, false);
+	UWFCGenerator* GeneratorB = WFCBacktrackingTests::CreateGenerator(16, 0, 8, Seed, false);
+	GeneratorA->Run(1000);
+	GeneratorB->Run(1000);
+
+	TestTrue(TEXT("Generator state"), GeneratorA->State == GeneratorB->State);
+	TestEqual(TEXT("Num restarts"), GeneratorA->GetNumRestarts(), GeneratorB->GetNumRestarts());
+	TestEqual(TEXT("Attempt seed"), GeneratorA->GetAttemptSeed(), GeneratorB->GetAttemptSeed());
+
+	TArray<int32> TileIdsA;
+	TArray<int32> TileIdsB;
+	GeneratorA->GetSelectedTileIds(TileIdsA);
+	GeneratorB->GetSelectedTileIds(TileIdsB);
+	TestTrue(TEXT("Selected tiles"), TileIdsA == TileIdsB);
+	return true;
+}
+
+#endif
@@ -0,0 +1,71 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+
+#include "WFCTestTypes.h"
+#include "Core/WFCGenerator.h"
+#include "Core/Grids/WFCGrid2D.h"
+#include "Misc/AutomationTest.h"
+#include "UObject/Package.h"
+
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace WFCCountConstraintTests
+{
+	/** Create a generator for a row of cells that can each be tile 0 or 1, with tile 0 required at least twice. */
+	UWFCGenerator* CreateGenerator(int32 NumCells)
+	{
+		UWFCTestModel* Model = NewObject<UWFCTestModel>(GetTransientPackage());
+		UWFCGrid2DConfig* GridConfig = NewObject<UWFCGrid2DConfig>(GetTransientPackage());
+		GridConfig->Dimensions = FIntPoint(NumCells, 1);
+
+		FWFCGeneratorConfig Config;
+		Config.Model = Model;
+		Config.GridConfig = GridConfig;
+		Config.ConstraintClasses.Add(UWFCTestCountConstraint::StaticClass());
+
+		UWFCGenerator* Generator = NewObject<UWFCGenerator>(GetTransientPackage());
+		Generator->Configure(Config);
+		Generator->Initialize();
+
+		// count the cells that can hold each group, so that bans after this update the counts
+		Generator->Next(true);
+		return Generator;
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FWFCCountConstraintPropagatedBanTest, "WFC.CountConstraint.PropagatedBan",
+                                 EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FWFCCountConstraintPropagatedBanTest::RunTest(const FString& Parameters)
+{
+	// ban tile 0 from one cell the way propagation does, one tile at a time,
+	// which leaves exactly enough cells for the min count, so they must all be forced to use it.
+	UWFCGenerator* Generator = WFCCountConstraintTests::CreateGenerator(3);
+	Generator->Ban(0, 0);
+	Generator->Next(true);
+
+	TestEqual(TEXT("Cell 1 tile"), Generator->GetCell(1).GetSelectedTileId(), 0);
+	TestEqual(TEXT("Cell 2 tile"), Generator->GetCell(2).GetSelectedTileId(), 0);
+	TestTrue(TEXT("Generator finished"), Generator->State == EWFCGeneratorState::Finished);
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FWFCCountConstraintUnreachableMinCountTest, "WFC.CountConstraint.UnreachableMinCount",
+                                 EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FWFCCountConstraintUnreachableMinCountTest::RunTest(const FString& Parameters)
+{
+	// only one cell is left that can hold tile 0, so the min count can't be reached
+	UWFCGenerator* Generator = WFCCountConstraintTests::CreateGenerator(3);
+	Generator->Ban(0, 0);
+	Generator->Ban(1, 0);
+	Generator->Next(true);
+
+	TestTrue(TEXT("Generator failed"), Generator->State == EWFCGeneratorState::Error);
+	return true;
+}
+
+#endif
@@ -0,0 +1,64 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+
+#include "WFCTestTypes.h"
+
+#include "Core/WFCGenerator.h"
+
+
+UWFCTestModel::UWFCTestModel()
+	: NumTestTiles(2)
+{
+}
+
+void UWFCTestModel::GenerateTiles()
+{
+	for (int32 Idx = 0; Idx < NumTestTiles; ++Idx)
+	{
+		const TSharedPtr<FWFCModelTile> Tile = MakeShared<FWFCModelTile>();
+		if (TestTileWeights.IsValidIndex(Idx))
+		{
+			Tile->Weight = TestTileWeights[Idx];
+		}
+		AddTile(Tile);
+	}
+}
+
+
+UWFCTestCountConstraint::UWFCTestCountConstraint()
+	: TestMinCount(2)
+{
+}
+
+void UWFCTestCountConstraint::Initialize(UWFCGenerator* InGenerator)
+{
+	Super::Initialize(InGenerator);
+
+	AddTileGroupCountMapping({0}, TestMinCount, 0);
+}
+
+
+UWFCTestContradictionConstraint::UWFCTestContradictionConstraint()
+	: ContradictionCellIndex(0),
+	  ContradictionTileId(0),
+	  NumContradictingAttempts(0)
+{
+}
+
+void UWFCTestContradictionConstraint::NotifyCellChanged(FWFCCellIndex CellIndex, bool bHasSelection)
+{
+	if (!bHasSelection || CellIndex != ContradictionCellIndex)
+	{
+		return;
+	}
+
+	if (NumContradictingAttempts > 0 && Generator->GetNumRestarts() >= NumContradictingAttempts)
+	{
+		return;
+	}
+
+	if (Generator->GetCell(CellIndex).GetSelectedTileId() == ContradictionTileId)
+	{
+		Generator->NotifyContradiction();
+	}
+}
@@ -0,0 +1,78 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Core/WFCModel.h"
+#include "Core/Constraints/WFCCountConstraint.h"
+#include "WFCTestTypes.generated.h"
+
+
+/**
+ * A model of plain tiles with no data, used by automation tests.
+ */
+UCLASS(HideDropdown, NotBlueprintable)
+class UWFCTestModel : public UWFCModel
+{
+	GENERATED_BODY()
+
+public:
+	UWFCTestModel();
+
+	/** The number of tiles to generate. */
+	UPROPERTY()
+	int32 NumTestTiles;
+
+	/** The weight of each tile, tiles without one have the default weight. */
+	UPROPERTY()
+	TArray<float> TestTileWeights;
+
+	virtual void GenerateTiles() override;
+};
+
+
+/**
+ * A count constraint that requires tile 0 to be selected a minimum number of times, used by automation tests.
+ */
+UCLASS(HideDropdown, NotBlueprintable)
+class UWFCTestCountConstraint : public UWFCCountConstraint
+{
+	GENERATED_BODY()
+
+public:
+	UWFCTestCountConstraint();
+
+	/** The min count of tile 0. */
+	UPROPERTY()
+	int32 TestMinCount;
+
+	virtual void Initialize(UWFCGenerator* InGenerator) override;
+};
+
+
+/**
+ * Reports a contradiction when a tile is selected for a cell, like a rule that can only be checked after selection.
+ * Used by automation tests to force the generator to backtrack or restart.
+ */
+UCLASS(HideDropdown, NotBlueprintable)
+class UWFCTestContradictionConstraint : public UWFCConstraint
+{
+	GENERATED_BODY()
+
+public:
+	UWFCTestContradictionConstraint();
+
+	/** The cell that can't have ContradictionTileId. */
+	UPROPERTY()
+	int32 ContradictionCellIndex;
+
+	/** The tile that causes a contradiction when selected for ContradictionCellIndex. */
+	UPROPERTY()
+	int32 ContradictionTileId;
+
+	/** The number of attempts that report contradictions, so that a restart can succeed. When 0, every attempt does. */
+	UPROPERTY()
+	int32 NumContradictingAttempts;
+
+	virtual void NotifyCellChanged(FWFCCellIndex CellIndex, bool bHasSelection) override;
+};
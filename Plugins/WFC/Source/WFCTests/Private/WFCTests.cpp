@@ -0,0 +1,6 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+#include "Modules/ModuleManager.h"
+
+// automation tests and the types they use, kept out of the runtime module so that they aren't cooked
+IMPLEMENT_MODULE(FDefaultModuleImpl, WFCTests)
@@ -0,0 +1,21 @@
+﻿// Copyright Bohdon Sayre. All Rights Reserved.
+
+using UnrealBuildTool;
+
+public class WFCTests : ModuleRules
+{
+	public WFCTests(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PublicDependencyModuleNames.AddRange(new string[]
+		{
+			"Core",
+		});
+
+		PrivateDependencyModuleNames.AddRange(new string[]
+		{
+			"CoreUObject",
+			"Engine",
+			"WFC",
+		});
+	}
+}